@@ -3,6 +3,15 @@
 #include <GLFW/glfw3.h>
 #include <stb_image.h>
 #include <iostream>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <random>
+#include <cctype>
+#include <climits>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
 //GLM specific includes for martix stuff
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
@@ -10,19 +19,43 @@
 
 //header files
 #include "construct_mesh.h"
+#include "obj_loader.h"
+#include "vertex_animation.h"
+#include "frustum_culling.h"
+#include "occlusion_culling.h"
+#include "occlusion_queries.h"
+#include "hiz_culling.h"
+#include "scene_framebuffer.h"
+#include "render_queue.h"
+#include "job_system.h"
+#include "entity_store.h"
+#include "mesh_batch.h"
+#include "indirect_rendering.h"
+#include "instancing.h"
+#include "stream_buffer.h"
+#include "frame_pacing.h"
+#include "gpu_profiler.h"
+#include "shader_program.h"
+#include "gl_state.h"
+#include "texture_library.h"
+#include "texture_atlas.h"
+#include "benchmark.h"
 #include "camera.h"
+#include "camera_uniforms.h"
+#include "simulation.h"
+#include "input_recording.h"
+#include "flythrough.h"
 
 //VERTEX SHADER
 const char* vertexShaderSource = "#version 330 core\n"
 "layout (location = 0) in vec3 aPos;\n"
 "layout (location = 2) in vec2 aTexCord;\n"
 "out vec2 TexCoord;\n"
-"uniform mat4 model;\n"
-"uniform mat4 view;\n"
-"uniform mat4 projection;\n"
+CAMERA_UNIFORM_BLOCK_GLSL
+OBJECT_UNIFORM_BLOCK_GLSL
 "void main()\n"
 "{\n"
-"   gl_Position = projection * view * model * vec4(aPos, 1.0);\n"
+"   gl_Position = viewProjection * model * vec4(aPos, 1.0);\n"
 "   TexCoord = aTexCord;\n"
 "}\0";
 
@@ -37,8 +70,32 @@ const char* fragmentShaderSource = "#version 330 core\n"
 "   FragColor = texture(texture1, TexCoord);\n"
 "}\n\0";
 
+//MATERIAL FRAGMENT SHADER, the draw's material picks its layer of the scene's texture arrays
+const char* materialFragmentShaderSource = "#version 330 core\n"
+"out vec4 FragColor;\n"
+"in vec2 TexCoord;\n"
+OBJECT_UNIFORM_BLOCK_GLSL
+MATERIAL_SAMPLE_GLSL
+"void main()\n"
+"{\n"
+"   FragColor = sampleMaterial(material.x, TexCoord);\n"
+"}\n\0";
+
+//BINDLESS MATERIAL FRAGMENT SHADER
+const char* bindlessMaterialFragmentShaderSource = "#version 400 core\n"
+"#extension GL_ARB_bindless_texture : require\n"
+"out vec4 FragColor;\n"
+"in vec2 TexCoord;\n"
+OBJECT_UNIFORM_BLOCK_GLSL
+MATERIAL_SAMPLE_BINDLESS_GLSL
+"void main()\n"
+"{\n"
+"   FragColor = sampleMaterial(material.x, TexCoord);\n"
+"}\n\0";
+
 //Function Definitions
 unsigned int CompileShaders(const char* vertexShaderSource, const char* fragmentShaderSource);
+unsigned int CompileComputeShader(const char* computeShaderSource);
 unsigned int createVAO();
 unsigned int createVBO(const float* vertices, size_t size);
 unsigned int createEBO(const unsigned int* indices, size_t size);
@@ -48,10 +105,27 @@ unsigned int LoadTexture(const char* filename);
 #define SCREEN_WIDTH 960
 #define SCREEN_HEIGHT 640
 
+// Robot crowd, drawn with baked vertex animation textures in a single instanced draw
+#define CROWD_ROWS 16
+#define CROWD_COLUMNS 16
+#define CROWD_FRAMES 32
+
+// Which occlusion culling runs after frustum culling
+enum OcclusionMode { OCCLUSION_MODE_NONE, OCCLUSION_MODE_SOFTWARE, OCCLUSION_MODE_QUERIES, OCCLUSION_MODE_HIZ };
+
+// Robots hidden last frame that are drawn behind one occlusion query, a whole hidden row or a single robot of a visible row
+typedef struct HiddenCrowdBatch {
+    int queryNode;
+    unsigned int firstInstance, instanceCount; // into the frame's hidden crowd instances
+}HiddenCrowdBatch;
+
 // Define a global Camera instance
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
 
-// Mouse callback to update the Camera instance
+// Mouse movement since the last frame, consumed (or recorded) by the input stage of the render loop
+float pendingMouseX = 0.0f, pendingMouseY = 0.0f;
+
+// Mouse callback to accumulate camera movement for the next frame
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     static float lastX = 400, lastY = 300;
     static bool firstMouse = true;
@@ -67,7 +141,8 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     lastX = xpos;
     lastY = ypos;
 
-    camera.ProcessMouseMovement(xoffset, yoffset);
+    pendingMouseX += xoffset;
+    pendingMouseY += yoffset;
 }
 
 // The callback function that checks if the escape key was pressed, and closes window
@@ -77,16 +152,132 @@ void esc_key_callback(GLFWwindow* window, int key, int scancode, int action, int
     }
 }
 
-int main(void)
+// Parses the object count of --scattered and --gpu-driven, counts past UINT_MAX are clamped
+bool parse_object_count(const char* text, unsigned int& outCount) {
+    char* end = NULL;
+    errno = 0;
+    unsigned long long count = std::isdigit((unsigned char)text[0]) ? std::strtoull(text, &end, 10) : 0;
+    if (!end || *end != '\0') {
+        std::cout << "ERROR::ARGUMENTS::INVALID_OBJECT_COUNT " << text << ", expected a non-negative whole number" << std::endl;
+        return false;
+    }
+    outCount = errno == ERANGE || count > UINT_MAX ? UINT_MAX : (unsigned int)count;
+    return true;
+}
+
+int main(int argc, char** argv)
 {
-    GLFWwindow* window;
+    // Command line options
+    // --------------------
+    InputMode inputMode = INPUT_LIVE;
+    const char* inputLogPath = NULL;
+    const char* frameTimePath = NULL;
+    OcclusionMode occlusionMode = OCCLUSION_MODE_SOFTWARE;
+    bool gpuDriven = false;
+    bool gpuBenchmark = false;
+    unsigned int scatteredObjects = 0;
+    FramePacingSettings pacingSettings;
+    frame_pacing_preset("default", pacingSettings);
+    const char* gpuProfilePath = NULL;
+    bool profileDraws = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--benchmark") { // CPU benchmarks don't need a window
+            run_benchmarks();
+            return 0;
+        }
+        else if (argument == "--benchmark-gpu") { // draw call benchmarks, these need the window
+            gpuBenchmark = true;
+        }
+        else if (argument == "--record" && i + 1 < argc) { // --record <log>, save this session's input
+            inputMode = INPUT_RECORD;
+            inputLogPath = argv[++i];
+        }
+        else if (argument == "--replay" && i + 1 < argc) { // --replay <log>, play a recorded session back then exit
+            inputMode = INPUT_REPLAY;
+            inputLogPath = argv[++i];
+        }
+        else if (argument == "--flythrough") { // follow the scripted camera path then exit
+            inputMode = INPUT_FLYTHROUGH;
+        }
+        else if (argument == "--frametimes" && i + 1 < argc) { // --frametimes <csv>, write every frame's time on exit
+            frameTimePath = argv[++i];
+        }
+        else if (argument == "--occlusion" && i + 1 < argc) { // --occlusion none|software|queries|hiz
+            std::string mode = argv[++i];
+            if (mode == "none")
+                occlusionMode = OCCLUSION_MODE_NONE;
+            else if (mode == "software")
+                occlusionMode = OCCLUSION_MODE_SOFTWARE;
+            else if (mode == "queries")
+                occlusionMode = OCCLUSION_MODE_QUERIES;
+            else if (mode == "hiz")
+                occlusionMode = OCCLUSION_MODE_HIZ;
+            else {
+                std::cout << "ERROR::OCCLUSION::UNKNOWN_MODE " << mode << ", expected none, software, queries or hiz" << std::endl;
+                return -1;
+            }
+        }
+        else if (argument == "--gpu-driven") { // --gpu-driven [count], draw the scene objects (plus count scattered copies) with one indirect multi-draw
+            gpuDriven = true;
+            if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0]) && !parse_object_count(argv[++i], scatteredObjects))
+                return -1;
+        }
+        else if (argument == "--scattered" && i + 1 < argc) { // --scattered <count>, add count static copies of the scene objects
+            if (!parse_object_count(argv[++i], scatteredObjects))
+                return -1;
+        }
+        else if (argument == "--pacing" && i + 1 < argc) { // --pacing default|competitive|kiosk, options after it override single settings
+            if (!frame_pacing_preset(argv[++i], pacingSettings))
+                return -1;
+        }
+        else if (argument == "--vsync" && i + 1 < argc) { // --vsync off|on|adaptive
+            if (!parse_swap_mode(argv[++i], pacingSettings.swapMode))
+                return -1;
+        }
+        else if (argument == "--frames-in-flight" && i + 1 < argc) { // --frames-in-flight <1-3>, frames queued before the CPU waits on the GPU
+            if (!parse_frames_in_flight(argv[++i], pacingSettings.maxFramesInFlight))
+                return -1;
+        }
+        else if (argument == "--fps-limit" && i + 1 < argc) { // --fps-limit <fps>, 0 for none
+            if (!parse_fps_limit(argv[++i], pacingSettings.targetFps))
+                return -1;
+        }
+        else if (argument == "--gpu-profile" && i + 1 < argc) { // --gpu-profile <csv>, time every pass on the GPU and write the averages on exit
+            gpuProfilePath = argv[++i];
+        }
+        else if (argument == "--gpu-profile-draws") { // with --gpu-profile, also time every render queue draw (per mesh)
+            profileDraws = true;
+        }
+    }
+    InputRecorder inputRecorder;
+    if (!create_input_recorder(inputRecorder, inputMode, inputLogPath))
+        return -1;
+    CameraSpline flythroughSpline = default_flythrough_spline();
+    float flythroughTime = 0.0f;
+    FrameTimeLog frameTimeLog;
+
+    GLFWwindow* window = NULL;
 
     /* Initialize the library */
     if (!glfwInit())
         return -1;
  
     /* Create a windowed mode window and its OpenGL context */
-    window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "OPenGL", NULL, NULL);
+    // Hi-Z culling and GPU driven drawing run in compute shaders, some drivers only expose those through an explicitly
+    // versioned core context
+    if (occlusionMode == OCCLUSION_MODE_HIZ || gpuDriven) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "OPenGL", NULL, NULL);
+        if (!window) {
+            std::cout << "Failed to create a 4.5 core context, falling back to the default one" << std::endl;
+            glfwDefaultWindowHints();
+        }
+    }
+    if (!window)
+        window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "OPenGL", NULL, NULL);
     if (!window)
     {
         glfwTerminate();
@@ -95,18 +286,55 @@ int main(void)
 
     /* Make the window's context current */
     glfwMakeContextCurrent(window);
+    glewExperimental = GL_TRUE; // core contexts need this for GLEW to load everything
     if (glewInit() != GLEW_OK)
         std::cout << "error" << std::endl;
 
     std::cout << glGetString(GL_VERSION) << std::endl;
+    if (occlusionMode == OCCLUSION_MODE_HIZ && !HiZCuller::IsSupported()) {
+        std::cout << "Hi-Z culling needs OpenGL 4.3, using software occlusion culling instead" << std::endl;
+        occlusionMode = OCCLUSION_MODE_SOFTWARE;
+    }
+    if (gpuDriven && !IndirectRenderer::IsSupported()) {
+        std::cout << "GPU driven drawing needs OpenGL 4.3 and ARB_shader_draw_parameters, drawing through the render queue instead" << std::endl;
+        gpuDriven = false;
+    }
+    if (gpuDriven && occlusionMode == OCCLUSION_MODE_QUERIES) {
+        std::cout << "Occlusion queries need one draw per object, using software occlusion culling with GPU driven drawing (its results are passed to the cull shader)" << std::endl;
+        occlusionMode = OCCLUSION_MODE_SOFTWARE;
+    }
+
+    // per frame data (object constants, crowd instances) is written straight into a triple buffered ring, each frame's
+    // region has room for one ObjectConstants range per scattered copy at the driver's uniform offset alignment, which
+    // also covers their instance matrices. Counts that would take more than 256 MB a frame are cut down.
+    GLint uniformAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    size_t alignment = uniformAlignment > 0 ? (size_t)uniformAlignment : 1;
+    size_t copyBytes = (sizeof(ObjectConstants) + alignment - 1) / alignment * alignment;
+    const size_t baseFrameBytes = 1 << 20, maxFrameBytes = (size_t)256 << 20;
+    if (scatteredObjects > (maxFrameBytes - baseFrameBytes) / copyBytes) {
+        scatteredObjects = (unsigned int)((maxFrameBytes - baseFrameBytes) / copyBytes);
+        std::cout << "Too many scattered copies for the per frame stream buffer, using " << scatteredObjects << std::endl;
+    }
+    StreamBuffer* frameStream = new StreamBuffer((unsigned int)(baseFrameBytes + scatteredObjects * copyBytes));
 
     // build and compile our shader program
     // ------------------------------------
-    unsigned int shaderProgram = CompileShaders(vertexShaderSource, fragmentShaderSource);
+    // scene textures are sampled through bindless handles when the driver has them, texture arrays bound once otherwise
+    bool bindlessTextures = GLEW_ARB_bindless_texture;
+    unsigned int shaderProgram = bindlessTextures ? CompileShaders(vertexShaderSource, bindlessMaterialFragmentShaderSource) : 0;
+    if (shaderProgram == 0) {
+        bindlessTextures = false;
+        shaderProgram = CompileShaders(vertexShaderSource, materialFragmentShaderSource);
+    }
     if (shaderProgram == 0) {
         // Handle the error, perhaps by exiting the application
         return -1;
     }
+    ShaderProgram sceneShader(shaderProgram); // uniform locations are reflected once, setters skip unchanged values
+    sceneShader.Use();
+    for (int array = 0; array < TEXTURE_LIBRARY_MAX_ARRAYS; ++array)
+        sceneShader.SetInt("textureArrays[" + std::to_string(array) + "]", array);
 
     //Set up meshes
     // -------------
@@ -116,49 +344,305 @@ int main(void)
     unsigned int latitudeCount = 20; // Create the sphere variables, Increase for higher quality
     unsigned int longitudeCount = 20; 
     Mesh sphere_mesh = construct_sphere(latitudeCount, longitudeCount);
+    Mesh robot_mesh = load_obj("rsc/Texture_Images/robot.obj");
+
+    //TEXTURE ATLAS
+    // the star and sphere textures are packed offline into one atlas (cached between runs) and their uvs remapped
+    // into it, so both objects share a material and sort next to each other in the render queue. The sprite and mask
+    // images go in as well so anything drawn with them later finds its region, the 2400x1152 bullet decal stays out
+    // since it alone would quadruple the atlas
+    std::vector<std::string> atlasFiles = { "texture.yellow.png", "texture.ball.png",
+        "rsc/Texture_Images/sprite.airplane.png", "rsc/Texture_Images/mask.airplane.png",
+        "rsc/Texture_Images/mask.airplane_background.png", "rsc/Texture_Images/mask.polygons.png" };
+    TextureAtlas sceneAtlas;
+    // the cache is rebuilt when an image was added, edited or removed since it was written
+    bool atlasCached = load_texture_atlas(sceneAtlas, "scene.atlas") && texture_atlas_up_to_date(sceneAtlas, atlasFiles);
+    if (!atlasCached) {
+        sceneAtlas = TextureAtlas();
+        std::vector<AtlasImage> atlasImages;
+        load_atlas_images(atlasFiles, atlasImages, std::thread::hardware_concurrency());
+        // a missing image gets no region, its object keeps its own uvs and texture (see the materials below)
+        atlasImages.erase(std::remove_if(atlasImages.begin(), atlasImages.end(), [](const AtlasImage& image) { return image.pixels.empty(); }), atlasImages.end());
+        if (!atlasImages.empty() && pack_texture_atlas(atlasImages, 8, 4096, std::thread::hardware_concurrency(), sceneAtlas))
+            save_texture_atlas(sceneAtlas, "scene.atlas");
+    }
+    const AtlasRegion* starRegion = find_atlas_region(sceneAtlas, "texture.yellow.png");
+    const AtlasRegion* sphereRegion = find_atlas_region(sceneAtlas, "texture.ball.png");
+    if (starRegion)
+        remap_mesh_uvs(star_mesh, *starRegion);
+    if (sphereRegion)
+        remap_mesh_uvs(sphere_mesh, *sphereRegion);
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
     // Create VAO, VBO, and EBO's
-    //CUBE
-    unsigned int cubeVAO = createVAO();
-    unsigned int cubeVBO = createVBO(cube_mesh.vertices.data(), cube_mesh.vertices.size() * sizeof(float));
-    unsigned int cubeEBO = createEBO(cube_mesh.indices.data(), cube_mesh.indices.size() * sizeof(unsigned int));
+    //STATIC MESHES
+    // the scene objects share one vertex layout, so they are packed into a single VBO/EBO pair behind one VAO
+    // and each one is drawn as its own range of it
+    MeshBatch staticMeshes;
+    MeshRange cubeRange = append_mesh(staticMeshes, cube_mesh);
+    MeshRange diamondRange = append_mesh(staticMeshes, diamond_mesh);
+    MeshRange starRange = append_mesh(staticMeshes, star_mesh);
+    MeshRange sphereRange = append_mesh(staticMeshes, sphere_mesh);
+    unsigned int staticVAO = createVAO();
+    unsigned int staticVBO = createVBO(staticMeshes.vertices.data(), staticMeshes.vertices.size() * sizeof(float));
+    unsigned int staticEBO = createEBO(staticMeshes.indices.data(), staticMeshes.indices.size() * sizeof(unsigned int));
     setupVertexAttributes();
-    glBindVertexArray(0); // Unbind the VAO to prevent accidental changes to it.
-
-    //DIAMOND
-    unsigned int diamondVAO = createVAO();
-    unsigned int diamondVBO = createVBO(diamond_mesh.vertices.data(), diamond_mesh.vertices.size() * sizeof(float));
-    unsigned int diamondEBO = createEBO(diamond_mesh.indices.data(), diamond_mesh.indices.size() * sizeof(unsigned int));
-    setupVertexAttributes();
-    glBindVertexArray(0);
+    gl_bind_vertex_array(0); // Unbind the VAO to prevent accidental changes to it.
+
+    //ROBOT CROWD
+    // bake the robot's skinned sway into vertex animation textures, reusing the cached bake when it was made for this
+    // mesh, frame count and duration (a changed sway rig needs the robot.vat deleted)
+    const float crowdDuration = 2.0f;
+    VertexAnimation robotAnimation;
+    if (!load_vertex_animation(robotAnimation, "robot.vat") || robotAnimation.vertexCount != robot_mesh.vertices.size() / 5 ||
+        robotAnimation.frameCount != CROWD_FRAMES || robotAnimation.duration != crowdDuration) {
+        robotAnimation = bake_vertex_animation(robot_mesh, CROWD_FRAMES, crowdDuration, make_sway_skinning(robot_mesh, 12.0f, 2.0f));
+        save_vertex_animation(robotAnimation, "robot.vat");
+    }
+    unsigned int robotPositionTexture, robotNormalTexture;
+    upload_vertex_animation(robotAnimation, robotPositionTexture, robotNormalTexture);
 
-    //STAR
-    unsigned int starVAO = createVAO();
-    unsigned int starVBO = createVBO(star_mesh.vertices.data(), star_mesh.vertices.size() * sizeof(float));
-    unsigned int starEBO = createEBO(star_mesh.indices.data(), star_mesh.indices.size() * sizeof(unsigned int));
+    unsigned int crowdVAO = createVAO();
+    unsigned int crowdVBO = createVBO(robot_mesh.vertices.data(), robot_mesh.vertices.size() * sizeof(float));
+    unsigned int crowdEBO = createEBO(robot_mesh.indices.data(), robot_mesh.indices.size() * sizeof(unsigned int));
     setupVertexAttributes();
-    glBindVertexArray(0);
+    // per instance world offset + animation time offset so the crowd doesn't move in lockstep
+    std::vector<glm::vec4> crowdInstances;
+    for (int row = 0; row < CROWD_ROWS; ++row) {
+        for (int column = 0; column < CROWD_COLUMNS; ++column) {
+            float x = (column - CROWD_COLUMNS * 0.5f) * 0.6f;
+            float z = -3.0f - row * 0.6f;
+            float timeOffset = std::fmod(row * 0.37f + column * 0.61f, robotAnimation.duration);
+            crowdInstances.push_back(glm::vec4(x, -1.0f, z, timeOffset));
+        }
+    }
+    // the visible instances are streamed every frame, the attribute is re-pointed at that frame's copy before drawing
+    gl_bind_buffer(GL_ARRAY_BUFFER, frameStream->GetBuffer());
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    gl_bind_vertex_array(0);
+
+    // Culling bounds
+    // --------------
+    glm::vec3 cubeBoundsCenter, cubeBoundsExtent, diamondBoundsCenter, diamondBoundsExtent;
+    glm::vec3 starBoundsCenter, starBoundsExtent, sphereBoundsCenter, sphereBoundsExtent;
+    compute_mesh_bounds(cube_mesh, cubeBoundsCenter, cubeBoundsExtent);
+    compute_mesh_bounds(diamond_mesh, diamondBoundsCenter, diamondBoundsExtent);
+    compute_mesh_bounds(star_mesh, starBoundsCenter, starBoundsExtent);
+    compute_mesh_bounds(sphere_mesh, sphereBoundsCenter, sphereBoundsExtent);
+    glm::vec3 objectBoundsCenters[OBJECT_COUNT] = { cubeBoundsCenter, diamondBoundsCenter, starBoundsCenter, sphereBoundsCenter };
+    glm::vec3 objectBoundsExtents[OBJECT_COUNT] = { cubeBoundsExtent, diamondBoundsExtent, starBoundsExtent, sphereBoundsExtent };
+
+    // the robots never move so their bounds are only built once, padded out to cover the baked sway
+    glm::vec3 robotBoundsCenter, robotBoundsExtent;
+    compute_mesh_bounds(robot_mesh, robotBoundsCenter, robotBoundsExtent);
+    robotBoundsExtent *= 1.25f;
+    CullingBounds crowdBounds;
+    resize_culling_bounds(crowdBounds, (unsigned int)crowdInstances.size());
+    for (unsigned int i = 0; i < crowdInstances.size(); ++i) {
+        glm::mat4 robotModel = glm::translate(glm::mat4(1.0f), glm::vec3(crowdInstances[i]));
+        robotModel = glm::scale(robotModel, glm::vec3(0.1f));
+        set_culling_bounds(crowdBounds, i, robotModel, robotBoundsCenter, robotBoundsExtent);
+    }
+    std::vector<unsigned int> visibleRobots;
+    std::vector<glm::vec4> visibleCrowdInstances;
+    std::vector<glm::vec4> hiddenCrowdInstances; // with occlusion queries, robots hidden last frame, grouped by batch
+    std::vector<HiddenCrowdBatch> hiddenCrowdBatches;
+    std::vector<char> robotOccluded; // per visible robot, written by the occlusion test jobs
+
+    // Job system
+    // ----------
+    // per frame culling and command recording is split into jobs across every core, the render loop's thread helps out
+    JobSystem jobs(std::thread::hardware_concurrency());
+
+    // Software occlusion culling
+    // --------------------------
+    // the solid objects stand in as occluders, the sphere through a coarser mesh that sits inside the real one
+    OccluderMesh cubeOccluder = make_occluder_mesh(cube_mesh);
+    OccluderMesh diamondOccluder = make_occluder_mesh(diamond_mesh);
+    OccluderMesh sphereOccluder = make_occluder_mesh(construct_sphere(8, 8));
+    OcclusionCuller occlusionCuller(std::thread::hardware_concurrency());
+
+    // Hardware occlusion queries
+    // --------------------------
+    // scene objects are root nodes, the crowd is grouped by row so a fully hidden row costs a single query
+    unsigned int boundsProgram = CompileShaders(boundsVertexShaderSource, boundsFragmentShaderSource);
+    if (boundsProgram == 0) {
+        return -1;
+    }
+    OcclusionQueryCuller occlusionQueries(boundsProgram);
+    int objectQueryNodes[OBJECT_COUNT];
+    for (int object = 0; object < OBJECT_COUNT; ++object)
+        objectQueryNodes[object] = occlusionQueries.AddNode(-1, false);
+    int crowdRowQueryNodes[CROWD_ROWS];
+    glm::vec3 crowdRowCenters[CROWD_ROWS], crowdRowExtents[CROWD_ROWS];
+    std::vector<int> robotQueryNodes(crowdInstances.size());
+    for (int row = 0; row < CROWD_ROWS; ++row) {
+        crowdRowQueryNodes[row] = occlusionQueries.AddNode(-1, true);
+        glm::vec3 rowMin(1e30f), rowMax(-1e30f);
+        for (int column = 0; column < CROWD_COLUMNS; ++column) {
+            unsigned int robot = row * CROWD_COLUMNS + column;
+            robotQueryNodes[robot] = occlusionQueries.AddNode(crowdRowQueryNodes[row], true); // one instanced draw, boxes only
+            rowMin = glm::min(rowMin, culling_bounds_center(crowdBounds, robot) - culling_bounds_extent(crowdBounds, robot));
+            rowMax = glm::max(rowMax, culling_bounds_center(crowdBounds, robot) + culling_bounds_extent(crowdBounds, robot));
+        }
+        crowdRowCenters[row] = (rowMin + rowMax) * 0.5f;
+        crowdRowExtents[row] = (rowMax - rowMin) * 0.5f;
+    }
 
-    //SPHERE
-    unsigned int sphereVAO = createVAO();
-    unsigned int sphereVBO = createVBO(sphere_mesh.vertices.data(), sphere_mesh.vertices.size() * sizeof(float));
-    unsigned int sphereEBO = createEBO(sphere_mesh.indices.data(), sphere_mesh.indices.size() * sizeof(unsigned int));
-    setupVertexAttributes();
-    glBindVertexArray(0);
+    // GPU Hi-Z culling
+    // ----------------
+    // the scene goes to an offscreen target so its depth can be reduced into the pyramid, the crowd is culled on the GPU
+    // and drawn straight from the culled instance buffer through a second VAO
+    SceneFramebuffer sceneTarget = {};
+    HiZCuller* hizCuller = NULL;
+    unsigned int hizPyramidProgram = 0, hizCullProgram = 0, crowdHiZVAO = 0;
+    if (occlusionMode == OCCLUSION_MODE_HIZ) {
+        sceneTarget = create_scene_framebuffer(SCREEN_WIDTH, SCREEN_HEIGHT);
+        hizPyramidProgram = CompileComputeShader(hizPyramidComputeShaderSource);
+        hizCullProgram = CompileComputeShader(hizCullComputeShaderSource);
+        if (sceneTarget.framebuffer == 0 || hizPyramidProgram == 0 || hizCullProgram == 0) {
+            return -1;
+        }
+        hizCuller = new HiZCuller(SCREEN_WIDTH, SCREEN_HEIGHT, hizPyramidProgram, hizCullProgram);
+        std::vector<glm::vec3> robotCenters, robotExtents;
+        for (unsigned int i = 0; i < crowdInstances.size(); ++i) {
+            robotCenters.push_back(culling_bounds_center(crowdBounds, i));
+            robotExtents.push_back(culling_bounds_extent(crowdBounds, i));
+        }
+        hizCuller->SetInstances(crowdInstances, robotCenters, robotExtents, robot_mesh.num_of_indices);
+
+        crowdHiZVAO = createVAO();
+        gl_bind_buffer(GL_ARRAY_BUFFER, crowdVBO);
+        setupVertexAttributes();
+        gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, crowdEBO);
+        gl_bind_buffer(GL_ARRAY_BUFFER, hizCuller->GetCulledInstanceBuffer());
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glEnableVertexAttribArray(3);
+        glVertexAttribDivisor(3, 1);
+        gl_bind_vertex_array(0);
+    }
 
     //etc...
     
     // load and create textures 
     // ------------------------
-    unsigned int cubeTexture = LoadTexture("texture.crate.jpg");
-    unsigned int diamondTexture = LoadTexture("texture.d2.jpeg");
-    unsigned int starTexture = LoadTexture("texture.yellow.png");
-    unsigned int sphereTexture = LoadTexture("texture.ball.png");
+    // the scene objects' textures go into texture arrays grouped by size, each object only keeps its material index
+    TextureLibrary* textureLibrary = new TextureLibrary();
+    unsigned int cubeMaterial = textureLibrary->AddTexture("texture.crate.jpg");
+    unsigned int diamondMaterial = textureLibrary->AddTexture("texture.d2.jpeg");
+    // an object only samples the atlas if its own image made it in, otherwise it loads its file as before (and gets the
+    // missing texture fallback if that fails too)
+    unsigned int atlasMaterial = 0;
+    if (starRegion || sphereRegion)
+        atlasMaterial = textureLibrary->AddImage("scene.atlas", sceneAtlas.width, sceneAtlas.height, sceneAtlas.pixels, sceneAtlas.mipLevels);
+    unsigned int starMaterial = starRegion ? atlasMaterial : textureLibrary->AddTexture("texture.yellow.png");
+    unsigned int sphereMaterial = sphereRegion ? atlasMaterial : textureLibrary->AddTexture("texture.ball.png");
+    if (!textureLibrary->Build(bindlessTextures)) {
+        return -1;
+    }
+    unsigned int robotTexture = LoadTexture("rsc/Texture_Images/robot_diffuse.jpg");
+
+    // per object draw data, indexed by SceneObject
+    MeshRange objectRanges[OBJECT_COUNT] = { cubeRange, diamondRange, starRange, sphereRange };
+    unsigned int objectMaterials[OBJECT_COUNT] = { cubeMaterial, diamondMaterial, starMaterial, sphereMaterial };
+
+    // Scene entities
+    // --------------
+    // every drawn object is an entity, its mesh component indexes objectRanges. The simulated objects are parented as
+    // scene_object_parent says, the scattered copies are static, scaled down root copies of the objects, created one
+    // object after the other so each object's copies sit in consecutive slots
+    EntityStore entities = create_entity_store();
+    reserve_entities(entities, OBJECT_COUNT + scatteredObjects);
+    Entity objectEntities[OBJECT_COUNT];
+    for (int object = 0; object < OBJECT_COUNT; ++object)
+        objectEntities[object] = create_entity(entities, object, objectMaterials[object], objectBoundsCenters[object], objectBoundsExtents[object]);
+    std::mt19937 scatterRandom(1234);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    for (unsigned int i = 0; i < scatteredObjects; ++i) {
+        unsigned int object = (unsigned int)((unsigned long long)i * OBJECT_COUNT / scatteredObjects);
+        unsigned int slot = entity_slot(entities, create_entity(entities, object, objectMaterials[object], objectBoundsCenters[object], objectBoundsExtents[object]));
+        set_entity_transform(entities, slot, glm::vec3(position(scatterRandom), position(scatterRandom), position(scatterRandom)), glm::vec3(0.0f), glm::vec3(0.2f));
+    }
+    for (int object = 0; object < OBJECT_COUNT; ++object) {
+        if (scene_object_parent(object) >= 0)
+            set_entity_parent(entities, objectEntities[object], objectEntities[scene_object_parent(object)]);
+    }
+    // nothing is created or destroyed after this so the slots stay put
+    unsigned int objectSlots[OBJECT_COUNT];
+    std::vector<int> slotObjects(entities.count, -1); // SceneObject of each slot, -1 for the scattered copies
+    for (int object = 0; object < OBJECT_COUNT; ++object) {
+        objectSlots[object] = entity_slot(entities, objectEntities[object]);
+        slotObjects[objectSlots[object]] = object;
+    }
+    update_entity_transforms_parallel(jobs, entities);
+    std::vector<unsigned int> visibleEntities;
+    std::vector<char> entityVisible; // per slot, after occlusion culling
+
+    // GPU driven drawing
+    // ------------------
+    // every scene object is a draw in the indirect renderer, the scattered copies are static and only there to show the
+    // submission cost doesn't grow with the object count
+    IndirectRenderer* indirectRenderer = NULL;
+    unsigned int indirectProgram = 0, indirectCullProgram = 0;
+    unsigned int objectDraws[OBJECT_COUNT];
+    // the per draw material isn't dynamically uniform, without GL_NV_gpu_shader5 the bindless arrays are bound to
+    // units as well and the indirect program picks them with the constant index switch
+    bool indirectBindless = bindlessTextures && GLEW_NV_gpu_shader5;
+    if (gpuDriven) {
+        indirectProgram = CompileShaders(indirectVertexShaderSource, indirectBindless ? indirectBindlessFragmentShaderSource : indirectFragmentShaderSource);
+        indirectCullProgram = CompileComputeShader(indirectCullComputeShaderSource);
+        if (indirectProgram == 0 || indirectCullProgram == 0) {
+            return -1;
+        }
+        ShaderProgram indirectShader(indirectProgram);
+        indirectShader.Use();
+        for (int array = 0; array < TEXTURE_LIBRARY_MAX_ARRAYS; ++array)
+            indirectShader.SetInt("textureArrays[" + std::to_string(array) + "]", array);
+        bind_camera_uniform_block(indirectProgram);
+        bind_material_uniform_block(indirectProgram);
+
+        indirectRenderer = new IndirectRenderer(indirectCullProgram);
+        unsigned int indirectMeshes[OBJECT_COUNT];
+        for (int object = 0; object < OBJECT_COUNT; ++object)
+            indirectMeshes[object] = indirectRenderer->AddMesh(objectRanges[object], objectBoundsCenters[object], objectBoundsExtents[object]);
+        for (unsigned int slot = 0; slot < entities.count; ++slot) {
+            unsigned int draw = indirectRenderer->AddDraw(indirectMeshes[entities.meshes[slot]], entities.materials[slot], entities.worldMatrices[slot]);
+            if (slotObjects[slot] >= 0)
+                objectDraws[slotObjects[slot]] = draw;
+        }
+    }
+
+    // Scattered copies
+    // ----------------
+    // without the indirect renderer the visible copies of each mesh are one instanced draw, their model matrices are
+    // composed straight into the stream buffer as instance attributes and the material comes from a single
+    // ObjectConstants range
+    unsigned int scatteredProgram = 0, scatteredVAO = 0;
+    std::vector<unsigned int> scatteredSlots[OBJECT_COUNT]; // this frame's visible copies by mesh, in slot order
+    if (!indirectRenderer && scatteredObjects > 0) {
+        scatteredProgram = CompileShaders(instancedVertexShaderSource, bindlessTextures ? bindlessMaterialFragmentShaderSource : materialFragmentShaderSource);
+        if (scatteredProgram == 0) {
+            return -1;
+        }
+        ShaderProgram scatteredShader(scatteredProgram);
+        scatteredShader.Use();
+        for (int array = 0; array < TEXTURE_LIBRARY_MAX_ARRAYS; ++array)
+            scatteredShader.SetInt("textureArrays[" + std::to_string(array) + "]", array);
+        bind_object_uniform_block(scatteredProgram);
+        bind_material_uniform_block(scatteredProgram);
+        bind_camera_uniform_block(scatteredProgram);
+        scatteredVAO = createVAO();
+        gl_bind_buffer(GL_ARRAY_BUFFER, staticVBO);
+        setupVertexAttributes();
+        gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, staticEBO);
+        gl_bind_vertex_array(0);
+    }
     
     // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl_bind_buffer(GL_ARRAY_BUFFER, 0);
 
     {
         // remember: do NOT unbind the EBO while a VAO is active as the bound element buffer object IS stored in the VAO; keep the EBO bound.
@@ -173,7 +657,7 @@ int main(void)
     }
 
     //Enable depth test for 3D rendering
-    glEnable(GL_DEPTH_TEST);
+    gl_enable(GL_DEPTH_TEST);
 
     // Matrix Transformstion Variables
     // -------------------------------
@@ -181,32 +665,91 @@ int main(void)
     glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
     glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
     float cameraSpeed = 0.05f; // Adjust as needed
-    //cube
-    float cubeRotationX = 0.5f;
-    float cubeRotationY = 0.5f;
-    glm::vec3 cubeScale = glm::vec3(0.5f,0.5f, 0.5f);
-    //diamoind
-    float diamondRotationX = 0.0f;
-    float diamondRotationY = 0.0f;
-    glm::vec3 diamondScale = glm::vec3(0.5f, 0.5f, 0.5f);
-    //star
-    float starRotationY = 0.1f;
-    glm::vec3 starScale = glm::vec3(0.5f, 0.5f, 0.5f);
-    //sphere
-    float sphereRotationX = 0.1f;
-    float sphereRotationY = 0.1f;
-    glm::vec3 sphereScale = glm::vec3(0.35f, 0.35f, 0.35f);
-    //Animation varibales for sphere
-    float waveAmplitude = 0.5f; // Height of the wave
-    float waveFrequency = 1.0f; // How often the wave repeats
-    float waveSpeed = 1.5f; // How fast the wave moves
-    float wavePhase = 0.0f; // Phase shift of the wave 
+    //scene objects, advanced by the fixed timestep simulation and interpolated for rendering
+    SceneState currentState = initial_scene_state();
+    SceneState previousState = currentState;
+    FixedTimestep simulationTimestep = create_fixed_timestep(SIMULATION_RATE, 8);
 
     // get model location
-    glUseProgram(shaderProgram); // Use the shader program
-    unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model"); // get model location from vert shader
-    unsigned int viewLoc = glGetUniformLocation(shaderProgram, "view");
-    unsigned int projectionLoc = glGetUniformLocation(shaderProgram, "projection");
+    gl_use_program(shaderProgram); // Use the shader program
+    bind_object_uniform_block(shaderProgram); // the model matrix comes from the stream buffer, one range per draw
+    bind_material_uniform_block(shaderProgram);
+    bind_camera_uniform_block(shaderProgram); // view/projection come from the shared camera uniform buffer
+
+    // vertex animation playback program, the animation layout never changes so set it once
+    unsigned int vatProgram = CompileShaders(vatVertexShaderSource, vatFragmentShaderSource);
+    if (vatProgram == 0) {
+        return -1;
+    }
+    ShaderProgram vatShader(vatProgram);
+    vatShader.Use();
+    vatShader.SetInt("texture1", 0);
+    vatShader.SetInt("vatPositions", 1);
+    vatShader.SetInt("vatNormals", 2);
+    vatShader.SetFloat("duration", robotAnimation.duration);
+    vatShader.SetFloat("scale", 0.1f);
+    vatShader.SetInt("frameCount", robotAnimation.frameCount);
+    vatShader.SetInt("textureWidth", robotAnimation.textureWidth);
+    vatShader.SetInt("rowsPerFrame", robotAnimation.rowsPerFrame);
+    bind_camera_uniform_block(vatProgram);
+    gl_use_program(shaderProgram);
+
+    // Camera projection only has to be set up once, the camera caches its matrices until something changes
+    camera.SetProjection(45.0f, (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 100.0f);
+    RenderQueue renderQueue(0.1f, 100.0f);
+    renderQueue.SetJobSystem(&jobs); // only used once the queue is big enough to split
+    CameraUniformBuffer cameraUniforms = create_camera_uniform_buffer();
+
+    // GPU benchmarks
+    // --------------
+    // per copy draws against instanced draws for the constructed meshes and the loaded robot, then exit
+    if (gpuBenchmark) {
+        unsigned int instancedProgram = CompileShaders(instancedVertexShaderSource, fragmentShaderSource);
+        unsigned int perDrawProgram = CompileShaders(perDrawVertexShaderSource, fragmentShaderSource);
+        if (instancedProgram == 0 || perDrawProgram == 0) {
+            return -1;
+        }
+        ShaderProgram instancedShader(instancedProgram), perDrawShader(perDrawProgram);
+        int modelLoc = perDrawShader.GetUniformLocation("model");
+        gl_use_program(instancedProgram);
+        instancedShader.SetInt("texture1", 0);
+        bind_camera_uniform_block(instancedProgram);
+        gl_use_program(perDrawProgram);
+        perDrawShader.SetInt("texture1", 0);
+        bind_camera_uniform_block(perDrawProgram);
+        update_camera_uniform_buffer(cameraUniforms, camera);
+        gl_active_texture(GL_TEXTURE0);
+        gl_bind_texture(GL_TEXTURE_2D, robotTexture);
+
+        InstanceBuffer benchmarkInstances = create_instance_buffer(1000000);
+        unsigned int staticInstancedVAO = createVAO();
+        gl_bind_buffer(GL_ARRAY_BUFFER, staticVBO);
+        setupVertexAttributes();
+        gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, staticEBO);
+        attach_instance_buffer(benchmarkInstances);
+        unsigned int robotInstancedVAO = createVAO();
+        gl_bind_buffer(GL_ARRAY_BUFFER, crowdVBO);
+        setupVertexAttributes();
+        gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, crowdEBO);
+        attach_instance_buffer(benchmarkInstances);
+        gl_bind_vertex_array(0);
+
+        MeshRange robotRange = { 0, robot_mesh.num_of_indices, 0 };
+        benchmark_instanced_drawing("cube", cubeRange, perDrawProgram, modelLoc, staticVAO, instancedProgram, staticInstancedVAO, benchmarkInstances);
+        benchmark_instanced_drawing("star", starRange, perDrawProgram, modelLoc, staticVAO, instancedProgram, staticInstancedVAO, benchmarkInstances);
+        benchmark_instanced_drawing("sphere", sphereRange, perDrawProgram, modelLoc, staticVAO, instancedProgram, staticInstancedVAO, benchmarkInstances);
+        benchmark_instanced_drawing("robot", robotRange, perDrawProgram, modelLoc, crowdVAO, instancedProgram, robotInstancedVAO, benchmarkInstances);
+
+        gl_delete_vertex_arrays(1, &staticInstancedVAO);
+        gl_delete_vertex_arrays(1, &robotInstancedVAO);
+        delete_instance_buffer(benchmarkInstances);
+        gl_delete_program(instancedProgram);
+        gl_delete_program(perDrawProgram);
+        delete frameStream;
+        delete textureLibrary;
+        glfwTerminate();
+        return 0;
+    }
 
     // Set the mouse callback
     // ----------------------
@@ -219,168 +762,461 @@ int main(void)
     //Delta Time Variables
     float lastFrame = 0.0f; // Time of last frame
     float deltaTime = 0.0f; // Time difference between current and last frame
+    SceneInput sceneInput;
+    float sceneTime = 0.0f; // sum of every frame's delta time, drives animation so replays stay deterministic
+
+    // vsync, frames in flight, frame rate limit and the latency estimates
+    FramePacer* framePacer = new FramePacer(window, pacingSettings);
+    // per pass GPU timings, does nothing unless --gpu-profile was given
+    GpuProfiler* gpuProfiler = new GpuProfiler(gpuProfilePath != NULL);
+    profileDraws = profileDraws && gpuProfiler->IsEnabled();
+    const char* objectNames[OBJECT_COUNT] = { "cube", "diamond", "star", "sphere" }; // draw scope names by mesh
 
     // render loop
     // -----------------------------------------------------------------------------------------------
     while (!glfwWindowShouldClose(window))
     {
+        // wait for the limiter and a free frame slot first, so the input below is as fresh as possible when the frame
+        // is built from it
+        framePacer->BeginFrame();
+        if (frameTimePath) {
+            for (const FrameLatency& latency : framePacer->GetFinishedFrames()) {
+                if (frameTimeLog.latencies.size() <= latency.frame)
+                    frameTimeLog.latencies.resize(latency.frame + 1, -1.0f);
+                frameTimeLog.latencies[latency.frame] = latency.milliseconds;
+            }
+        }
+        // glfw: poll IO events (keys pressed/released, mouse moved etc.)
+        glfwPollEvents();
+
         // input
         // -----
-        // CAMERA
+        // INPUT & CAMERA
         {
             // Calculate delta time
             float currentFrame = glfwGetTime();
-            deltaTime = currentFrame - lastFrame;
+            float frameTime = currentFrame - lastFrame;
             lastFrame = currentFrame;
 
-            camera.ProcessKeyboard(window, deltaTime);
+            // this frame's input, live or replayed, the rest of the frame never polls GLFW directly
+            InputFrame inputFrame;
+            if (!next_input_frame(inputRecorder, window, frameTime, pendingMouseX, pendingMouseY, inputFrame))
+                break; // replay finished
+            pendingMouseX = 0.0f;
+            pendingMouseY = 0.0f;
+            deltaTime = inputFrame.deltaTime;
+            sceneTime += deltaTime;
+            sceneInput = sample_scene_input(inputFrame);
+            if (frameTimePath) {
+                frameTimeLog.deltaTimes.push_back(deltaTime);
+                frameTimeLog.frameTimes.push_back(frameTime);
+            }
+
+            if (inputMode == INPUT_FLYTHROUGH) {
+                flythroughTime += deltaTime;
+                if (!apply_flythrough(flythroughSpline, flythroughTime, camera))
+                    break; // reached the end of the path
+            }
+            else {
+                camera.ProcessKeyboard(input_camera_directions(inputFrame), deltaTime);
+                camera.ProcessMouseMovement(inputFrame.mouseX, inputFrame.mouseY);
+            }
         }
-        // CUBE
-        {
-            // --- Rotations
-            if (glfwGetKey(window, GLFW_KEY_KP_8) == GLFW_PRESS)
-                cubeRotationX += 1.0f; // Increase rotation angle around the X-axis
-            if (glfwGetKey(window, GLFW_KEY_KP_5) == GLFW_PRESS)
-                cubeRotationX -= 1.0f; // Decrease rotation angle around the X-axis
-            if (glfwGetKey(window, GLFW_KEY_KP_6) == GLFW_PRESS)
-                cubeRotationY += 1.0f; // Increase rotation angle around the Y-axis
-            if (glfwGetKey(window, GLFW_KEY_KP_4) == GLFW_PRESS)
-                cubeRotationY -= 1.0f; // Decrease rotation angle around the Y-axis
-            // --- Scale
-            if (glfwGetKey(window, GLFW_KEY_KP_ADD) == GLFW_PRESS)
-                cubeScale += glm::vec3(0.01f); // Use smaller increments if 0.1 is too large
-            if (glfwGetKey(window, GLFW_KEY_KP_SUBTRACT) == GLFW_PRESS)
-                cubeScale -= glm::vec3(0.01f); // Don't allow the scale to go negative!
-        }
-        //DIAMOND
-        {
-            // --- Rotations
-            if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-                diamondRotationX += 1.0f; // Increase rotation angle around the X-axis
-            if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-                diamondRotationX -= 1.0f; // Decrease rotation angle around the X-axis
-            if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-                diamondRotationY += 1.0f; // Increase rotation angle around the Y-axis
-            if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-                diamondRotationY -= 1.0f; // Decrease rotation angle around the Y-axis
-        }
-        //SPHERE
+        // SIMULATION
         {
-            // --- Rotations
-            if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS)
-                sphereRotationX += 3.0f; // Increase rotation angle around the X-axis
-            if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
-                sphereRotationX -= 3.0f; // Decrease rotation angle around the X-axis
-            if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
-                sphereRotationY += 3.0f; // Increase rotation angle around the Y-axis
-            if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS)
-                sphereRotationY -= 3.0f; // Decrease rotation angle around the Y-axis
+            // object controls are sampled once per frame, then the simulation catches up in fixed steps
+            unsigned int steps = advance_fixed_timestep(simulationTimestep, deltaTime);
+            for (unsigned int step = 0; step < steps; ++step) {
+                previousState = currentState;
+                simulate_scene(currentState, sceneInput, (float)simulationTimestep.step);
+            }
         }
+        // blend the last two simulated states by how far we are into the next step
+        SceneState renderState = interpolate_scene(previousState, currentState, fixed_timestep_alpha(simulationTimestep));
+
+        // this frame's region of the stream buffer, only waits if the GPU is three frames behind
+        frameStream->BeginFrame();
+        gl_state_reset_stats(); // per frame counts of the binds and state changes that reached the driver
+        gpuProfiler->BeginFrame();
 
         //clear buffers
+        gpuProfiler->BeginScope("clear");
+        if (occlusionMode == OCCLUSION_MODE_HIZ)
+            bind_scene_framebuffer(sceneTarget);
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear color and depth buffers
+        gpuProfiler->EndScope();
 
         // draw our first triangle
-        glUseProgram(shaderProgram);
+        gl_use_program(shaderProgram);
         
-        // Activate the texture unit and bind the texture
-        glActiveTexture(GL_TEXTURE0); // Activate the first texture unit
-        glUniform1i(glGetUniformLocation(shaderProgram, "texture1"), 0);
+        // Materials: the texture arrays (unless they are bindless) and the material table are bound once for every draw
+        textureLibrary->Bind();
+        if (indirectRenderer && !indirectBindless && textureLibrary->IsBindless())
+            textureLibrary->BindArrays();
 
         // Camera Matrix setup
         // -------------------
-        // Create view matrix, set it to camera instance
-        glm::mat4 view = camera.GetViewMatrix();
-
-        // Create projection matrix
-        glm::mat4 projection = glm::mat4(1.0f);
-        projection = glm::perspective(glm::radians(45.0f), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 100.0f);
+        // Publish the camera matrices to every shader through the shared uniform block (skipped if the camera didn't change)
+        update_camera_uniform_buffer(cameraUniforms, camera);
+
+        // Object Transforms
+        // -----------------
+        // the simulated objects' blended transforms go into their entities, then only the world matrices and bounds of
+        // those and their children are rebuilt. The update only visits each level's dirty range, so the static
+        // scattered copies are skipped as long as they sit outside it
+        for (int object = 0; object < OBJECT_COUNT; ++object)
+            set_entity_transform(entities, objectSlots[object], renderState.positions[object], renderState.rotations[object], renderState.scales[object]);
+        update_entity_transforms_parallel(jobs, entities);
+
+        // Frustum Culling
+        // ---------------
+        Frustum frustum = extract_frustum_planes(camera.GetViewProjectionMatrix());
+        visibleEntities.clear();
+        cull_aabbs_parallel(jobs, frustum, entities.worldBounds, visibleEntities);
+        visibleRobots.clear();
+        if (occlusionMode != OCCLUSION_MODE_HIZ) // the GPU frustum culls the crowd itself
+            cull_spheres_parallel(jobs, frustum, crowdBounds, visibleRobots);
+
+        entityVisible.assign(entities.count, 0);
+        visibleCrowdInstances.clear();
+        hiddenCrowdInstances.clear();
+        hiddenCrowdBatches.clear();
+
+        // Occlusion Culling
+        // -----------------
+        if (occlusionMode == OCCLUSION_MODE_SOFTWARE) {
+            // rasterize the occluders on the CPU, then drop anything whose bounds are completely behind them
+            occlusionCuller.BeginFrame(camera.GetViewProjectionMatrix());
+            occlusionCuller.AddOccluder(cubeOccluder, entities.worldMatrices[objectSlots[OBJECT_CUBE]]);
+            occlusionCuller.AddOccluder(diamondOccluder, entities.worldMatrices[objectSlots[OBJECT_DIAMOND]]);
+            occlusionCuller.AddOccluder(sphereOccluder, entities.worldMatrices[objectSlots[OBJECT_SPHERE]]);
+            occlusionCuller.RasterizeOccluders();
+
+            // the tests only read the finished depth buffer so they run as jobs
+            jobs.ParallelFor((unsigned int)visibleEntities.size(), 64, [&](unsigned int begin, unsigned int end) {
+                for (unsigned int i = begin; i < end; ++i) {
+                    unsigned int slot = visibleEntities[i];
+                    entityVisible[slot] = occlusionCuller.IsVisible(culling_bounds_center(entities.worldBounds, slot), culling_bounds_extent(entities.worldBounds, slot));
+                }
+            });
+            // only the robots that survive both culling passes get written to the crowd's instance buffer
+            robotOccluded.assign(visibleRobots.size(), 0);
+            jobs.ParallelFor((unsigned int)visibleRobots.size(), 64, [&](unsigned int begin, unsigned int end) {
+                for (unsigned int i = begin; i < end; ++i) {
+                    unsigned int index = visibleRobots[i];
+                    robotOccluded[i] = !occlusionCuller.IsVisible(culling_bounds_center(crowdBounds, index), culling_bounds_extent(crowdBounds, index));
+                }
+            });
+            for (size_t i = 0; i < visibleRobots.size(); ++i) {
+                if (!robotOccluded[i])
+                    visibleCrowdInstances.push_back(crowdInstances[visibleRobots[i]]);
+            }
+        }
+        else if (occlusionMode == OCCLUSION_MODE_QUERIES) {
+            // last frame's (or older) query results decide what is drawn up front, nothing waits on the GPU
+            // only the simulated objects have queries, the scattered copies are just frustum culled
+            occlusionQueries.BeginFrame(camera.Position);
+            for (unsigned int slot : visibleEntities) {
+                if (slotObjects[slot] >= 0)
+                    occlusionQueries.SetBounds(objectQueryNodes[slotObjects[slot]], culling_bounds_center(entities.worldBounds, slot), culling_bounds_extent(entities.worldBounds, slot));
+            }
+            for (int row = 0; row < CROWD_ROWS; ++row)
+                occlusionQueries.SetBounds(crowdRowQueryNodes[row], crowdRowCenters[row], crowdRowExtents[row]);
+            for (unsigned int index : visibleRobots)
+                occlusionQueries.SetBounds(robotQueryNodes[index], culling_bounds_center(crowdBounds, index), culling_bounds_extent(crowdBounds, index));
+
+            for (unsigned int slot : visibleEntities)
+                entityVisible[slot] = slotObjects[slot] < 0 || occlusionQueries.WasVisible(objectQueryNodes[slotObjects[slot]]);
+            // robots hidden last frame are drawn conditionally after the bounds queries, a closed row behind its own query
+            // in one draw, a hidden robot of an open row behind the robot's
+            for (unsigned int index : visibleRobots) {
+                if (occlusionQueries.WasVisible(robotQueryNodes[index])) {
+                    visibleCrowdInstances.push_back(crowdInstances[index]);
+                    continue;
+                }
+                int rowNode = crowdRowQueryNodes[index / CROWD_COLUMNS];
+                int queryNode = occlusionQueries.WasVisible(rowNode) ? robotQueryNodes[index] : rowNode;
+                if (hiddenCrowdBatches.empty() || hiddenCrowdBatches.back().queryNode != queryNode)
+                    hiddenCrowdBatches.push_back(HiddenCrowdBatch{ queryNode, (unsigned int)hiddenCrowdInstances.size(), 0 });
+                hiddenCrowdInstances.push_back(crowdInstances[index]);
+                ++hiddenCrowdBatches.back().instanceCount;
+            }
+        }
+        else {
+            // with Hi-Z only the crowd is occlusion culled, on the GPU while it is drawn
+            for (unsigned int slot : visibleEntities)
+                entityVisible[slot] = 1;
+            for (unsigned int index : visibleRobots)
+                visibleCrowdInstances.push_back(crowdInstances[index]);
+        }
 
-        // Pass the view and projection matrices to the shader
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+        // Late Latch
+        // ----------
+        // nothing has been drawn yet, so poll once more and point this frame's view at wherever the mouse has moved
+        // since the input was sampled (replays and the flythrough don't follow the mouse)
+        if (inputMode == INPUT_LIVE || inputMode == INPUT_RECORD) {
+            glfwPollEvents();
+            late_latch_camera_uniforms(cameraUniforms, camera, pendingMouseX, pendingMouseY);
+        }
 
         // Render & Apply Matrix
         // ---------------------
-        // Cube
-        glBindVertexArray(cubeVAO); // Bind the cube's VAO
-        glBindTexture(GL_TEXTURE_2D, cubeTexture); // Bind the cube's texture
-        // Set the cube's transformations
-        glm::mat4 cubeModel = glm::mat4(1.0f);
-        cubeModel = glm::translate(cubeModel, glm::vec3(0.0f,-0.55f,0.0f)); // Position the cube (static for now)
-        cubeModel = glm::rotate(cubeModel, glm::radians(cubeRotationX), glm::vec3(1.0f, 0.0f, 0.0f)); // set rotation
-        cubeModel = glm::rotate(cubeModel, glm::radians(cubeRotationY), glm::vec3(0.0f, 1.0f, 0.0f));
-        cubeModel = glm::scale(cubeModel, cubeScale); // Apply scaling
-        // Set the uniform for the cube model matrix
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(cubeModel)); // Set the cube model matrix uniform
-        glDrawElements(GL_TRIANGLES, cube_mesh.num_of_indices, GL_UNSIGNED_INT, 0); // Draw the cube
-
-        // Diamond
-        glBindVertexArray(diamondVAO); // Bind the diamond's VAO
-        glBindTexture(GL_TEXTURE_2D, diamondTexture); // Bind the diamond's texture
-        // Set the diamond's transformations
-        glm::mat4 pyramidModel = glm::mat4(1.0f); // model matrix
-        pyramidModel = glm::translate(pyramidModel, glm::vec3(-1.0f, 0.0f, 0.5f)); // Position the diamond
-        pyramidModel = glm::rotate(pyramidModel, glm::radians(diamondRotationX), glm::vec3(1.0f, 0.0f, 0.0f));// rotation
-        pyramidModel = glm::rotate(pyramidModel, glm::radians(diamondRotationY -= 0.75f), glm::vec3(0.0f, 1.0f, 0.0f));
-        pyramidModel = glm::scale(pyramidModel, diamondScale); // Scale
-        //Set the model matrix for each object right before you draw it.
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(pyramidModel));
-        glDrawElements(GL_TRIANGLES, diamond_mesh.num_of_indices, GL_UNSIGNED_INT, 0); // Draw the diamond
-
-        // Star
-        glBindVertexArray(starVAO); // Bind the diamond's VAO
-        glBindTexture(GL_TEXTURE_2D, starTexture); // Bind the diamond's texture
-        // Set the diamond's transformations
-        glm::mat4 starModel = glm::mat4(1.0f); // model matrix
-        starModel = glm::translate(starModel, glm::vec3(1.0f, 0.0f, 0.5f)); // Position the diamond
-        //starModel = glm::rotate(starModel, glm::radians(starRotationX), glm::vec3(1.0f, 0.0f, 0.0f));// rotation
-        starModel = glm::rotate(starModel, glm::radians(starRotationY += 0.75f), glm::vec3(0.0f, 1.0f, 0.0f));
-        starModel = glm::scale(starModel, starScale); // Scale
-        //Set the model matrix for each object right before you draw it.
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(starModel));
-        glDrawElements(GL_TRIANGLES, star_mesh.num_of_indices, GL_UNSIGNED_INT, 0); // Draw the diamond
-        
-        // Sphere
-        glBindTexture(GL_TEXTURE_2D, sphereTexture); // Bind the sphere's texture
-        glBindVertexArray(sphereVAO); // Bind the sphere's VAO
-        //animate
-        wavePhase += waveSpeed * deltaTime; // Update the wave phase over time
-        float sineWave = waveAmplitude * fabs(sin(waveFrequency * wavePhase)); // Calculate the sine wave value for the current phase
-        // Set the sphere's transformations
-        glm::mat4 sphereModel = glm::mat4(1.0f); // model matrix
-        sphereModel = glm::translate(sphereModel, glm::vec3(0.0f, sineWave, 0.0f)); // Apply animations
-        sphereModel = glm::rotate(sphereModel, glm::radians(sphereRotationX += 0.75f), glm::vec3(1.0f, 0.0f, 0.0f));// rotation
-        sphereModel = glm::rotate(sphereModel, glm::radians(sphereRotationY += 0.75f), glm::vec3(0.0f, 1.0f, 0.0f));
-        sphereModel = glm::scale(sphereModel, sphereScale); // Scale
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(sphereModel));
-        glDrawElements(GL_TRIANGLES, sphere_mesh.num_of_indices, GL_UNSIGNED_INT, 0); // Draw the sphere
+        // Cube, Diamond, Star, Sphere and the scattered copies
+        auto drawEntity = [&](unsigned int slot) {
+            gl_bind_vertex_array(staticVAO); // Bind the shared VAO
+            //Set the model matrix and material for each object right before you draw it.
+            push_object_constants(*frameStream, entities.worldMatrices[slot], entities.materials[slot]);
+            draw_mesh_range(objectRanges[entities.meshes[slot]]);
+        };
+        RenderQueueStats queueStats = { 0, 0, 0 };
+        if (indirectRenderer) {
+            // the GPU frustum culls every draw and writes the commands, the CPU only refreshes the moving transforms
+            for (int object = 0; object < OBJECT_COUNT; ++object)
+                indirectRenderer->SetTransform(objectDraws[object], entities.worldMatrices[objectSlots[object]]);
+            // draws were added in slot order so the draw is the slot, only frustum visible slots were tested and the
+            // rest keep their last flag, which does not matter since the GPU frustum culls them anyway
+            if (occlusionMode == OCCLUSION_MODE_SOFTWARE) {
+                for (unsigned int slot : visibleEntities)
+                    indirectRenderer->SetOccluded(slot, !entityVisible[slot]);
+            }
+            gpuProfiler->BeginScope("indirect cull");
+            indirectRenderer->Cull(frustum);
+            gpuProfiler->EndScope();
+            gpuProfiler->BeginScope("objects");
+            gl_use_program(indirectProgram);
+            gl_bind_vertex_array(staticVAO);
+            indirectRenderer->Draw();
+            gpuProfiler->EndScope();
+        }
+        else {
+            // visible objects go through the render queue, sorted by state then front to back so redundant binds are skipped
+            // the draw id is the entity's slot, the scattered copies are batched by mesh and drawn instanced after it
+            renderQueue.Clear();
+            for (int object = 0; object < OBJECT_COUNT; ++object)
+                scatteredSlots[object].clear();
+            glm::mat4 view = camera.GetViewMatrix();
+            for (unsigned int slot : visibleEntities) {
+                if (!entityVisible[slot])
+                    continue;
+                if (slotObjects[slot] < 0) {
+                    scatteredSlots[entities.meshes[slot]].push_back(slot);
+                    continue;
+                }
+                float viewDepth = -(view * glm::vec4(culling_bounds_center(entities.worldBounds, slot), 1.0f)).z;
+                renderQueue.Submit(RENDER_PASS_OPAQUE, shaderProgram, staticVAO, entities.materials[slot], objectRanges[entities.meshes[slot]], entities.worldMatrices[slot], viewDepth, (int)slot);
+            }
+            renderQueue.Sort();
+            gpuProfiler->BeginScope("objects");
+            // the occlusion queries and the per draw scopes both hook the queue's draws
+            bool queryDraws = occlusionMode == OCCLUSION_MODE_QUERIES;
+            if (queryDraws || profileDraws) {
+                queueStats = renderQueue.Execute(*frameStream,
+                    [&](int slot) {
+                        if (profileDraws)
+                            gpuProfiler->BeginScope(objectNames[entities.meshes[slot]]);
+                        if (queryDraws && slotObjects[slot] >= 0)
+                            occlusionQueries.BeginDraw(objectQueryNodes[slotObjects[slot]]);
+                    },
+                    [&](int slot) {
+                        if (queryDraws && slotObjects[slot] >= 0)
+                            occlusionQueries.EndDraw(objectQueryNodes[slotObjects[slot]]);
+                        if (profileDraws)
+                            gpuProfiler->EndScope();
+                    });
+            }
+            else {
+                queueStats = renderQueue.Execute(*frameStream);
+            }
+            gpuProfiler->EndScope();
+
+            if (scatteredProgram)
+                gpuProfiler->BeginScope("scattered copies");
+            for (int object = 0; object < OBJECT_COUNT; ++object) {
+                const std::vector<unsigned int>& slots = scatteredSlots[object];
+                unsigned int instanceOffset;
+                float* instanceModels = slots.empty() ? NULL : (float*)frameStream->Allocate((unsigned int)(slots.size() * sizeof(glm::mat4)), sizeof(glm::vec4), instanceOffset);
+                if (!instanceModels)
+                    continue;
+                // the copies are roots so their world matrix is their local one, each run of consecutive visible slots
+                // is composed by the TRS kernel right into the mapped instance data
+                for (size_t first = 0, last; first < slots.size(); first = last) {
+                    last = first + 1;
+                    while (last < slots.size() && slots[last] == slots[last - 1] + 1)
+                        ++last;
+                    compose_trs_matrices(entities.locals, slots[first], slots[last - 1] + 1, instanceModels + first * 16, 16);
+                }
+                frameStream->Flush();
+                gl_use_program(scatteredProgram);
+                push_object_constants(*frameStream, glm::mat4(1.0f), objectMaterials[object]); // only the material is read
+                gl_bind_vertex_array(scatteredVAO);
+                attach_instance_range(frameStream->GetBuffer(), instanceOffset);
+                draw_mesh_instanced(objectRanges[object], (unsigned int)slots.size());
+            }
+            if (scatteredProgram)
+                gpuProfiler->EndScope();
+        }
+        if (frameTimePath)
+            frameTimeLog.stateChangesSaved.push_back(queueStats.stateChangesSaved);
+
+        // Robot crowd
+        // the whole crowd is one instanced draw, all skinning was done offline by the baker
+        if (occlusionMode == OCCLUSION_MODE_HIZ) {
+            // phase 0 draws what last frame's pyramid lets through, then the pyramid is rebuilt from this frame's depth and
+            // phase 1 draws whatever phase 0 rejected that turned out to be visible after all
+            gpuProfiler->BeginScope("crowd phase 0");
+            hizCuller->CullPhase(0);
+            gl_use_program(vatProgram);
+            vatShader.SetFloat("time", sceneTime);
+            gl_active_texture(GL_TEXTURE1);
+            gl_bind_texture(GL_TEXTURE_2D, robotPositionTexture);
+            gl_active_texture(GL_TEXTURE2);
+            gl_bind_texture(GL_TEXTURE_2D, robotNormalTexture);
+            gl_active_texture(GL_TEXTURE0);
+            gl_bind_texture(GL_TEXTURE_2D, robotTexture);
+            gl_bind_vertex_array(crowdHiZVAO);
+            hizCuller->DrawPhase(0);
+            gpuProfiler->EndScope();
+
+            gpuProfiler->BeginScope("hi-z pyramid");
+            hizCuller->BuildPyramid(sceneTarget.depthTexture);
+            gpuProfiler->EndScope();
+            gpuProfiler->BeginScope("crowd phase 1");
+            hizCuller->CullPhase(1);
+            gl_use_program(vatProgram);
+            gl_active_texture(GL_TEXTURE0);
+            gl_bind_texture(GL_TEXTURE_2D, robotTexture);
+            gl_bind_vertex_array(crowdHiZVAO);
+            hizCuller->DrawPhase(1);
+            gpuProfiler->EndScope();
+        }
+        else if (!visibleCrowdInstances.empty()) {
+            gpuProfiler->BeginScope("crowd");
+            gl_use_program(vatProgram);
+            vatShader.SetFloat("time", sceneTime);
+            gl_active_texture(GL_TEXTURE1);
+            gl_bind_texture(GL_TEXTURE_2D, robotPositionTexture);
+            gl_active_texture(GL_TEXTURE2);
+            gl_bind_texture(GL_TEXTURE_2D, robotNormalTexture);
+            gl_active_texture(GL_TEXTURE0);
+            gl_bind_texture(GL_TEXTURE_2D, robotTexture);
+            unsigned int instanceOffset;
+            if (frameStream->Write(glm::value_ptr(visibleCrowdInstances[0]), (unsigned int)(visibleCrowdInstances.size() * sizeof(glm::vec4)), sizeof(glm::vec4), instanceOffset)) {
+                frameStream->Flush();
+                gl_bind_vertex_array(crowdVAO);
+                gl_bind_buffer(GL_ARRAY_BUFFER, frameStream->GetBuffer());
+                glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)(size_t)instanceOffset);
+                glDrawElementsInstanced(GL_TRIANGLES, robot_mesh.num_of_indices, GL_UNSIGNED_INT, 0, (GLsizei)visibleCrowdInstances.size());
+            }
+            gpuProfiler->EndScope();
+        }
+
+        // Hidden objects
+        // now the visible geometry is in the depth buffer, query the boxes of everything hidden last frame and draw those
+        // objects conditionally, the GPU skips them if their query found nothing and the CPU never waits to find out
+        if (occlusionMode == OCCLUSION_MODE_QUERIES) {
+            gpuProfiler->BeginScope("hidden objects");
+            occlusionQueries.IssueBoundsQueries();
+            gl_use_program(shaderProgram);
+            for (unsigned int slot : visibleEntities) {
+                if (slotObjects[slot] < 0 || entityVisible[slot] || !occlusionQueries.BeginConditionalDraw(objectQueryNodes[slotObjects[slot]]))
+                    continue;
+                drawEntity(slot);
+                occlusionQueries.EndConditionalDraw();
+            }
+            unsigned int hiddenOffset;
+            if (!hiddenCrowdInstances.empty() && frameStream->Write(glm::value_ptr(hiddenCrowdInstances[0]), (unsigned int)(hiddenCrowdInstances.size() * sizeof(glm::vec4)), sizeof(glm::vec4), hiddenOffset)) {
+                frameStream->Flush();
+                gl_use_program(vatProgram);
+                vatShader.SetFloat("time", sceneTime);
+                gl_active_texture(GL_TEXTURE1);
+                gl_bind_texture(GL_TEXTURE_2D, robotPositionTexture);
+                gl_active_texture(GL_TEXTURE2);
+                gl_bind_texture(GL_TEXTURE_2D, robotNormalTexture);
+                gl_active_texture(GL_TEXTURE0);
+                gl_bind_texture(GL_TEXTURE_2D, robotTexture);
+                gl_bind_vertex_array(crowdVAO);
+                gl_bind_buffer(GL_ARRAY_BUFFER, frameStream->GetBuffer());
+                for (const HiddenCrowdBatch& batch : hiddenCrowdBatches) {
+                    if (!occlusionQueries.BeginConditionalDraw(batch.queryNode))
+                        continue;
+                    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)(size_t)(hiddenOffset + batch.firstInstance * sizeof(glm::vec4)));
+                    glDrawElementsInstanced(GL_TRIANGLES, robot_mesh.num_of_indices, GL_UNSIGNED_INT, 0, (GLsizei)batch.instanceCount);
+                    occlusionQueries.EndConditionalDraw();
+                }
+            }
+            occlusionQueries.EndFrame();
+            gpuProfiler->EndScope();
+        }
 
         // Unbind the VAO to prevent accidental changes to it
-        glBindVertexArray(0);
+        gl_bind_vertex_array(0);
+
+        if (occlusionMode == OCCLUSION_MODE_HIZ) {
+            gpuProfiler->BeginScope("blit");
+            blit_scene_framebuffer_to_screen(sceneTarget);
+            gpuProfiler->EndScope();
+        }
+        gpuProfiler->EndFrame();
+
+        // fence this frame's stream region so it isn't overwritten while the GPU still reads it
+        frameStream->EndFrame();
+        if (frameTimePath) {
+            GLStateStats glStats = gl_state_stats();
+            frameTimeLog.glCallsIssued.push_back(glStats.issued);
+            frameTimeLog.glCallsFiltered.push_back(glStats.filtered);
+        }
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
+        // glfw: swap buffers, then fence the frame so the pacer knows when the GPU is done with it
+        // -------------------------------------------------------------------------------------
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        framePacer->EndFrame();
     }
 
     // de-allocate all resources once they've outlived their purpose
     // -------------------------------------------------------------
-    glDeleteVertexArrays(1, &cubeVAO); // ---- Cube
-    glDeleteBuffers(1, &cubeVBO);
-    glDeleteBuffers(1, &cubeEBO);
-    glDeleteVertexArrays(1, &diamondVAO); // ---- Diamond
-    glDeleteBuffers(1, &diamondVBO);
-    glDeleteBuffers(1, &diamondEBO);
-    glDeleteVertexArrays(1, &starVAO); // ---- Star
-    glDeleteBuffers(1, &starVBO);
-    glDeleteBuffers(1, &starEBO);
-    glDeleteVertexArrays(1, &sphereVAO); // ---- Sphere
-    glDeleteBuffers(1, &sphereVBO);
-    glDeleteBuffers(1, &sphereEBO);
-    glDeleteProgram(shaderProgram); // ---- Shader Program
+    gl_delete_vertex_arrays(1, &staticVAO); // ---- Cube, Diamond, Star, Sphere
+    gl_delete_buffers(1, &staticVBO);
+    gl_delete_buffers(1, &staticEBO);
+    gl_delete_vertex_arrays(1, &crowdVAO); // ---- Robot crowd
+    gl_delete_buffers(1, &crowdVBO);
+    gl_delete_buffers(1, &crowdEBO);
+    gl_delete_textures(1, &robotPositionTexture);
+    gl_delete_textures(1, &robotNormalTexture);
+    gl_delete_program(vatProgram);
+    gl_delete_program(boundsProgram);
+    if (scatteredProgram) { // ---- Scattered copies
+        gl_delete_vertex_arrays(1, &scatteredVAO);
+        gl_delete_program(scatteredProgram);
+    }
+    if (indirectRenderer) { // ---- GPU driven drawing
+        delete indirectRenderer;
+        gl_delete_program(indirectProgram);
+        gl_delete_program(indirectCullProgram);
+    }
+    if (hizCuller) { // ---- Hi-Z culling
+        delete hizCuller;
+        gl_delete_vertex_arrays(1, &crowdHiZVAO);
+        gl_delete_program(hizPyramidProgram);
+        gl_delete_program(hizCullProgram);
+        delete_scene_framebuffer(sceneTarget);
+    }
+    delete_camera_uniform_buffer(cameraUniforms);
+    delete frameStream;
+    delete textureLibrary;
+    gl_delete_program(shaderProgram); // ---- Shader Program
+    std::cout << "Estimated input to photon latency: " << framePacer->GetAverageLatency() << " ms average" << std::endl;
+    delete framePacer;
+    if (gpuProfilePath) {
+        gpuProfiler->PrintReport();
+        gpuProfiler->WriteReport(gpuProfilePath);
+    }
+    delete gpuProfiler;
+
+    // write out anything recorded this session
+    finish_input_recorder(inputRecorder);
+    if (frameTimePath)
+        write_frame_time_log(frameTimeLog, frameTimePath);
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -435,11 +1271,43 @@ unsigned int CompileShaders(const char* vertexShaderSource, const char* fragment
     return shaderProgram; // return the shader program ID
 }
 
+//Function to Compile a Compute Shader into its own program
+unsigned int CompileComputeShader(const char* computeShaderSource) {
+    unsigned int computeShader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(computeShader, 1, &computeShaderSource, NULL);
+    glCompileShader(computeShader);
+    // check for shader compile errors
+    int success;
+    char infoLog[512];
+    glGetShaderiv(computeShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(computeShader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+        return 0; // return 0 to indicate failure
+    }
+
+    // link shader
+    unsigned int shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, computeShader);
+    glLinkProgram(shaderProgram);
+    // check for linking errors
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        return 0; // return 0 to indicate failure
+    }
+
+    glDeleteShader(computeShader);
+
+    return shaderProgram; // return the shader program ID
+}
+
 // Function to create VAOs
 unsigned int createVAO() {
     unsigned int VAO;
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    gl_bind_vertex_array(VAO);
     return VAO;
 }
 
@@ -447,7 +1315,7 @@ unsigned int createVAO() {
 unsigned int createVBO(const float* vertices, size_t size) {
     unsigned int VBO;
     glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    gl_bind_buffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
     return VBO;
 }
@@ -456,7 +1324,7 @@ unsigned int createVBO(const float* vertices, size_t size) {
 unsigned int createEBO(const unsigned int* indices, size_t size) {
     unsigned int EBO;
     glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW);
     return EBO;
 }
@@ -493,7 +1361,7 @@ unsigned int LoadTexture(const char* filename) {
     // Generate a texture ID and load texture data
     unsigned int textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    gl_bind_texture(GL_TEXTURE_2D, textureID);
 
     // Set texture wrapping parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
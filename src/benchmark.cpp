@@ -0,0 +1,330 @@
+#include <GL/glew.h>
+#include "benchmark.h"
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+
+#include <thread>
+
+#include "frustum_culling.h"
+#include "occlusion_culling.h"
+#include "job_system.h"
+#include "transform_batch.h"
+#include "render_queue.h"
+#include "construct_mesh.h"
+#include "camera_uniforms.h"
+#include "gl_state.h"
+
+//PER DRAW VERTEX SHADER
+const char* perDrawVertexShaderSource = "#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"layout (location = 2) in vec2 aTexCord;\n"
+"out vec2 TexCoord;\n"
+CAMERA_UNIFORM_BLOCK_GLSL
+"uniform mat4 model;\n"
+"void main()\n"
+"{\n"
+"   gl_Position = viewProjection * model * vec4(aPos, 1.0);\n"
+"   TexCoord = aTexCord;\n"
+"}\0";
+
+// milliseconds elapsed since start
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void run_benchmarks() {
+    benchmark_frustum_culling(100000, 200);
+    benchmark_occlusion_culling(500, 10000, 50);
+    benchmark_job_system(100000, 20);
+    benchmark_trs_matrices(100000, 50);
+    benchmark_render_queue_recording(20000, 50);
+}
+
+void benchmark_frustum_culling(unsigned int objectCount, unsigned int iterations) {
+    // scatter small boxes through a 200 unit cube around a camera at the origin
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+    CullingBounds bounds;
+    resize_culling_bounds(bounds, objectCount);
+    for (unsigned int i = 0; i < objectCount; ++i) {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random)));
+        set_culling_bounds(bounds, i, model, glm::vec3(0.0f), glm::vec3(size(random)));
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 960.0f / 640.0f, 0.1f, 100.0f);
+    Frustum frustum = extract_frustum_planes(projection * view);
+
+    std::vector<unsigned int> visible;
+    visible.reserve(objectCount);
+    unsigned int aabbVisible = 0, sphereVisible = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        visible.clear();
+        aabbVisible = cull_aabbs(frustum, bounds, visible);
+    }
+    double aabbTime = elapsed_ms(start) / iterations;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        visible.clear();
+        sphereVisible = cull_spheres(frustum, bounds, visible);
+    }
+    double sphereTime = elapsed_ms(start) / iterations;
+
+    std::cout << "Frustum culling, " << objectCount << " objects" << std::endl;
+    std::cout << "  AABB:   " << aabbTime << " ms (" << aabbVisible << " visible)" << std::endl;
+    std::cout << "  Sphere: " << sphereTime << " ms (" << sphereVisible << " visible)" << std::endl;
+}
+
+void benchmark_occlusion_culling(unsigned int occluderCount, unsigned int objectCount, unsigned int iterations) {
+    // a field of crates in front of the camera hiding a field of small boxes further back
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> spread(-15.0f, 15.0f);
+    std::uniform_real_distribution<float> nearDepth(-12.0f, -4.0f);
+    std::uniform_real_distribution<float> farDepth(-60.0f, -15.0f);
+
+    OccluderMesh crate = make_occluder_mesh(construct_cube());
+    std::vector<glm::mat4> occluders;
+    for (unsigned int i = 0; i < occluderCount; ++i) {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(spread(random), spread(random) * 0.3f, nearDepth(random)));
+        occluders.push_back(glm::scale(model, glm::vec3(2.0f)));
+    }
+    std::vector<glm::vec3> centers;
+    for (unsigned int i = 0; i < objectCount; ++i)
+        centers.push_back(glm::vec3(spread(random) * 2.0f, spread(random) * 0.6f, farDepth(random)));
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 960.0f / 640.0f, 0.1f, 100.0f);
+    OcclusionCuller culler(std::thread::hardware_concurrency());
+
+    double rasterTime = 0.0, testTime = 0.0;
+    unsigned int visible = 0;
+    for (unsigned int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        culler.BeginFrame(projection * view);
+        for (const glm::mat4& model : occluders)
+            culler.AddOccluder(crate, model);
+        culler.RasterizeOccluders();
+        rasterTime += elapsed_ms(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        visible = 0;
+        for (const glm::vec3& center : centers)
+            visible += culler.IsVisible(center, glm::vec3(0.5f)) ? 1 : 0;
+        testTime += elapsed_ms(start);
+    }
+
+    std::cout << "Occlusion culling, " << occluderCount << " occluders (" << culler.GetOccluderTriangleCount() << " triangles), "
+        << objectCount << " objects" << std::endl;
+    std::cout << "  Rasterize: " << rasterTime / iterations << " ms" << std::endl;
+    std::cout << "  Test:      " << testTime / iterations << " ms (" << visible << " visible)" << std::endl;
+}
+
+void benchmark_job_system(unsigned int jobCount, unsigned int iterations) {
+    JobSystem jobs(std::thread::hardware_concurrency());
+    std::vector<float> values(jobCount, 1.0f);
+
+    // empty jobs, the whole cost is queueing, stealing and counting them down
+    double runTime = 0.0;
+    for (unsigned int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        JobCounter counter(0);
+        for (unsigned int job = 0; job < jobCount; ++job)
+            jobs.Run([]() {}, counter);
+        jobs.Wait(counter);
+        runTime += elapsed_ms(start);
+    }
+
+    // a tiny bit of work per element, once inline and then as parallel-for at a few grain sizes
+    auto work = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int element = begin; element < end; ++element)
+            values[element] = std::sqrt(values[element] * 1.0001f + 1.0f);
+    };
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i)
+        work(0, jobCount);
+    double serialTime = elapsed_ms(start) / iterations;
+    const unsigned int grainSizes[] = { 1, 64, 4096 };
+    double grainTimes[3];
+    for (int grain = 0; grain < 3; ++grain) {
+        start = std::chrono::high_resolution_clock::now();
+        for (unsigned int i = 0; i < iterations; ++i)
+            jobs.ParallelFor(jobCount, grainSizes[grain], work);
+        grainTimes[grain] = elapsed_ms(start) / iterations;
+    }
+
+    // frustum culling the same scattered boxes inline and as jobs
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    CullingBounds bounds;
+    resize_culling_bounds(bounds, jobCount * 10);
+    for (unsigned int i = 0; i < bounds.count; ++i)
+        set_culling_bounds(bounds, i, glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random))), glm::vec3(0.0f), glm::vec3(1.0f));
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 960.0f / 640.0f, 0.1f, 100.0f);
+    Frustum frustum = extract_frustum_planes(projection * view);
+    std::vector<unsigned int> visible;
+    start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        visible.clear();
+        cull_aabbs(frustum, bounds, visible);
+    }
+    double cullTime = elapsed_ms(start) / iterations;
+    start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        visible.clear();
+        cull_aabbs_parallel(jobs, frustum, bounds, visible);
+    }
+    double parallelCullTime = elapsed_ms(start) / iterations;
+
+    std::cout << "Job system, " << jobs.GetThreadCount() << " threads, " << jobCount << " jobs" << std::endl;
+    std::cout << "  Empty jobs:   " << runTime / iterations << " ms (" << runTime * 1000000.0 / ((double)iterations * jobCount) << " ns per job)" << std::endl;
+    std::cout << "  Inline loop:  " << serialTime << " ms" << std::endl;
+    for (int grain = 0; grain < 3; ++grain)
+        std::cout << "  Grain " << grainSizes[grain] << ": " << grainTimes[grain] << " ms" << std::endl;
+    std::cout << "  Cull " << bounds.count << " AABBs inline: " << cullTime << " ms, as jobs: " << parallelCullTime << " ms (" << visible.size() << " visible)" << std::endl;
+}
+
+void benchmark_trs_matrices(unsigned int objectCount, unsigned int iterations) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+    std::vector<glm::vec3> positions(objectCount), rotations(objectCount), scales(objectCount);
+    TRSBatch batch;
+    resize_trs_batch(batch, objectCount);
+    for (unsigned int i = 0; i < objectCount; ++i) {
+        positions[i] = glm::vec3(position(random), position(random), position(random));
+        rotations[i] = glm::vec3(angle(random), angle(random), angle(random));
+        scales[i] = glm::vec3(size(random), size(random), size(random));
+        set_trs(batch, i, positions[i], euler_degrees_to_quat(rotations[i]), scales[i]);
+    }
+
+    // the translate -> rotate -> rotate -> rotate -> scale chain the scene used per object
+    std::vector<glm::mat4> chained(objectCount);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        for (unsigned int object = 0; object < objectCount; ++object) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[object]);
+            model = glm::rotate(model, glm::radians(rotations[object].x), glm::vec3(1.0f, 0.0f, 0.0f));
+            model = glm::rotate(model, glm::radians(rotations[object].y), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::rotate(model, glm::radians(rotations[object].z), glm::vec3(0.0f, 0.0f, 1.0f));
+            chained[object] = glm::scale(model, scales[object]);
+        }
+    }
+    double chainTime = elapsed_ms(start) / iterations;
+
+    // the kernel, into a plain float array like a mapped instance buffer would be
+    std::vector<float> composed(objectCount * 16);
+    start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i)
+        compose_trs_matrices(batch, 0, objectCount, composed.data(), 16);
+    double kernelTime = elapsed_ms(start) / iterations;
+
+    float maxError = 0.0f;
+    for (unsigned int object = 0; object < objectCount; ++object) {
+        const float* chainedElements = glm::value_ptr(chained[object]);
+        for (int element = 0; element < 16; ++element)
+            maxError = std::max(maxError, std::fabs(chainedElements[element] - composed[object * 16 + element]));
+    }
+
+    std::cout << "TRS to matrix, " << objectCount << " objects" << std::endl;
+    std::cout << "  glm chain: " << chainTime << " ms" << std::endl;
+    std::cout << "  Kernel:    " << kernelTime << " ms (" << chainTime / kernelTime << "x, max difference " << maxError << ")" << std::endl;
+}
+
+void benchmark_render_queue_recording(unsigned int itemCount, unsigned int iterations) {
+    // a sorted queue spread over a few programs, VAOs and materials so there are binds to record and to skip
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<unsigned int> program(1, 4), vao(1, 8), material(0, 63);
+    std::uniform_real_distribution<float> depth(0.1f, 100.0f);
+    RenderQueue queue(0.1f, 100.0f);
+    for (unsigned int i = 0; i < itemCount; ++i) {
+        MeshRange range = { (i % 1000) * 36, 36, 0 };
+        queue.Submit(RENDER_PASS_OPAQUE, program(random), vao(random), material(random), range, glm::mat4(1.0f), depth(random), (int)i);
+    }
+    queue.Sort();
+    const unsigned int stride = 256; // the widest common uniform offset alignment
+    std::vector<unsigned char> serialConstants(itemCount * stride), parallelConstants(itemCount * stride);
+
+    // everything in one buffer on this thread against one part per worker as jobs
+    JobSystem jobs(std::thread::hardware_concurrency());
+    std::vector<CommandBuffer> serialBuffers(1), parallelBuffers(jobs.GetThreadCount());
+    RenderQueueStats serialStats = {}, parallelStats = {};
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i)
+        serialStats = queue.Record(serialBuffers, serialConstants.data(), 1, 0, stride, true, true, NULL);
+    double serialTime = elapsed_ms(start) / iterations;
+    start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i)
+        parallelStats = queue.Record(parallelBuffers, parallelConstants.data(), 1, 0, stride, true, true, &jobs);
+    double parallelTime = elapsed_ms(start) / iterations;
+
+    // the parts replayed in order have to be the serial stream byte for byte
+    std::vector<unsigned char> joined;
+    for (const CommandBuffer& buffer : parallelBuffers)
+        joined.insert(joined.end(), buffer.GetData().begin(), buffer.GetData().end());
+    bool sameCommands = joined == serialBuffers[0].GetData();
+    bool sameConstants = parallelConstants == serialConstants;
+
+    std::cout << "Render queue recording, " << itemCount << " draws (" << serialStats.stateChanges << " binds)" << std::endl;
+    std::cout << "  Serial:  " << serialTime << " ms" << std::endl;
+    std::cout << "  " << parallelBuffers.size() << " jobs:  " << parallelTime << " ms (" << serialTime / parallelTime << "x)" << std::endl;
+    std::cout << "  Command streams " << (sameCommands ? "match" : "DIFFER") << " (" << serialBuffers[0].GetData().size() << " bytes), constants "
+        << (sameConstants ? "match" : "DIFFER") << ", binds " << serialStats.stateChanges << " / " << parallelStats.stateChanges << std::endl;
+}
+
+void benchmark_instanced_drawing(const char* meshName, const MeshRange& range, unsigned int program, int modelLocation, unsigned int vao,
+    unsigned int instancedProgram, unsigned int instancedVAO, InstanceBuffer& instances) {
+    const unsigned int counts[] = { 10000, 100000, 1000000 };
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> spread(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> depth(-100.0f, -5.0f);
+
+    std::cout << "Instanced drawing, " << meshName << " (" << range.indexCount / 3 << " triangles)" << std::endl;
+    for (unsigned int count : counts) {
+        std::vector<glm::mat4> models(count);
+        for (glm::mat4& model : models)
+            model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(spread(random), spread(random), depth(random))), glm::vec3(0.2f));
+        // the per draw path gets fewer frames, a million draw calls per frame is slow enough to time in one go
+        unsigned int drawFrames = count >= 1000000 ? 1 : 3, instancedFrames = 10;
+
+        gl_use_program(program);
+        gl_bind_vertex_array(vao);
+        glFinish();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int frame = 0; frame < drawFrames; ++frame) {
+            for (const glm::mat4& model : models) {
+                glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(model));
+                draw_mesh_range(range);
+            }
+        }
+        glFinish();
+        double drawTime = elapsed_ms(start) / drawFrames;
+
+        // the instanced frames re-upload every matrix, the cost of a crowd whose transforms all change
+        gl_use_program(instancedProgram);
+        gl_bind_vertex_array(instancedVAO);
+        glFinish();
+        start = std::chrono::high_resolution_clock::now();
+        for (unsigned int frame = 0; frame < instancedFrames; ++frame) {
+            upload_instances(instances, models.data(), count);
+            draw_mesh_instanced(range, count);
+        }
+        glFinish();
+        double instancedTime = elapsed_ms(start) / instancedFrames;
+
+        std::cout << "  " << count << " copies: per draw " << drawTime << " ms, instanced " << instancedTime << " ms" << std::endl;
+    }
+    gl_bind_vertex_array(0);
+}
@@ -0,0 +1,26 @@
+#ifndef BENCHMARK
+#define BENCHMARK
+
+#include "mesh_batch.h"
+#include "instancing.h"
+
+// CPU side micro benchmarks, run with the --benchmark command line argument (no window or GL context needed)
+void run_benchmarks();
+
+void benchmark_frustum_culling(unsigned int objectCount, unsigned int iterations);
+void benchmark_occlusion_culling(unsigned int occluderCount, unsigned int objectCount, unsigned int iterations);
+// Scheduling overhead of the job system: empty jobs, fine grained parallel-for and job based frustum culling
+void benchmark_job_system(unsigned int jobCount, unsigned int iterations);
+// Model matrices from position, rotation and scale, the chained glm calls against compose_trs_matrices
+void benchmark_trs_matrices(unsigned int objectCount, unsigned int iterations);
+// The render queue recorded into one command buffer on this thread and in parts as jobs, checks both give the same stream
+void benchmark_render_queue_recording(unsigned int itemCount, unsigned int iterations);
+
+// GPU benchmarks, need a current GL context with the camera uniform buffer up to date (run with --benchmark-gpu)
+// One uniform + draw call per copy against one instanced draw, at 10k, 100k and 1M copies of the mesh
+void benchmark_instanced_drawing(const char* meshName, const MeshRange& range, unsigned int program, int modelLocation, unsigned int vao,
+    unsigned int instancedProgram, unsigned int instancedVAO, InstanceBuffer& instances);
+// Vertex shader for the per copy baseline, the model matrix is a plain uniform set before every draw
+extern const char* perDrawVertexShaderSource;
+
+#endif // !BENCHMARK
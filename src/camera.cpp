@@ -2,28 +2,89 @@
 
 //Constructor with vectors
 Camera::Camera(glm::vec3 startPosition, glm::vec3 startUp, float startYaw, float startPitch)
-    : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(2.5f), MouseSensitivity(0.1f), Yaw(startYaw), Pitch(startPitch) {
+    : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(2.5f), MouseSensitivity(0.1f), Yaw(startYaw), Pitch(startPitch),
+      fov(45.0f), aspect(1.0f), nearClip(0.1f), farClip(100.0f), viewDirty(true), projectionDirty(true), matrixVersion(0) {
     Position = startPosition;
     WorldUp = startUp;
     updateCameraVectors();
 }
 
 // Returns the view matrix calculated using Euler Angles and the LookAt Matrix
-glm::mat4 Camera::GetViewMatrix() {
-    return glm::lookAt(Position, Position + Front, Up);
+const glm::mat4& Camera::GetViewMatrix() {
+    updateMatrices();
+    return view;
+}
+
+const glm::mat4& Camera::GetProjectionMatrix() {
+    updateMatrices();
+    return projection;
+}
+
+const glm::mat4& Camera::GetViewProjectionMatrix() {
+    updateMatrices();
+    return viewProjection;
+}
+
+const glm::mat4& Camera::GetInverseViewMatrix() {
+    updateMatrices();
+    return inverseView;
+}
+
+const glm::mat4& Camera::GetInverseProjectionMatrix() {
+    updateMatrices();
+    return inverseProjection;
+}
+
+const glm::mat4& Camera::GetInverseViewProjectionMatrix() {
+    updateMatrices();
+    return inverseViewProjection;
+}
+
+// Sets the perspective projection, only marks it dirty if something changed
+void Camera::SetProjection(float fovDegrees, float aspectRatio, float nearPlane, float farPlane) {
+    if (fovDegrees == fov && aspectRatio == aspect && nearPlane == nearClip && farPlane == farClip)
+        return;
+    fov = fovDegrees;
+    aspect = aspectRatio;
+    nearClip = nearPlane;
+    farClip = farPlane;
+    projectionDirty = true;
+}
+
+// Forces the view matrices to be rebuilt, for when the public attributes were edited directly
+void Camera::MarkDirty() {
+    updateCameraVectors();
 }
 
 // Processes input received from any keyboard-like input system
 void Camera::ProcessKeyboard(GLFWwindow* window, float deltaTime) {
-    float velocity = MovementSpeed * deltaTime;
+    unsigned int directions = 0;
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        Position += Front * velocity;
+        directions |= CAMERA_FORWARD;
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        Position -= Front * velocity;
+        directions |= CAMERA_BACKWARD;
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        Position -= Right * velocity;
+        directions |= CAMERA_LEFT;
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        directions |= CAMERA_RIGHT;
+    ProcessKeyboard(directions, deltaTime);
+}
+
+// Moves the camera along every direction flag that is set
+void Camera::ProcessKeyboard(unsigned int directions, float deltaTime) {
+    float velocity = MovementSpeed * deltaTime;
+    glm::vec3 startPosition = Position;
+    if (directions & CAMERA_FORWARD)
+        Position += Front * velocity;
+    if (directions & CAMERA_BACKWARD)
+        Position -= Front * velocity;
+    if (directions & CAMERA_LEFT)
+        Position -= Right * velocity;
+    if (directions & CAMERA_RIGHT)
         Position += Right * velocity;
+
+    if (Position != startPosition)
+        viewDirty = true;
 }
 
 // Processes input received from a mouse input system
@@ -31,6 +92,9 @@ void Camera::ProcessMouseMovement(float xOffset, float yOffset) {
     xOffset *= MouseSensitivity;
     yOffset *= MouseSensitivity;
 
+    float startYaw = Yaw;
+    float startPitch = Pitch;
+
     Yaw += xOffset;
     Pitch += yOffset;
 
@@ -39,16 +103,55 @@ void Camera::ProcessMouseMovement(float xOffset, float yOffset) {
     if (Pitch < -89.0f)
         Pitch = -89.0f;
 
-    updateCameraVectors();
+    // nothing to rebuild if the pitch clamp swallowed the whole movement
+    if (Yaw != startYaw || Pitch != startPitch)
+        updateCameraVectors();
+}
+
+// Look direction of the given Euler angles
+static glm::vec3 front_from_angles(float yaw, float pitch) {
+    glm::vec3 front;
+    front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
+    front.y = sin(glm::radians(pitch));
+    front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
+    return glm::normalize(front);
+}
+
+// Same angles and clamp as ProcessMouseMovement, but only builds the matrix
+glm::mat4 Camera::GetLatchedViewMatrix(float xOffset, float yOffset) const {
+    float yaw = Yaw + xOffset * MouseSensitivity;
+    float pitch = glm::clamp(Pitch + yOffset * MouseSensitivity, -89.0f, 89.0f);
+    glm::vec3 front = front_from_angles(yaw, pitch);
+    glm::vec3 right = glm::normalize(glm::cross(front, WorldUp));
+    glm::vec3 up = glm::normalize(glm::cross(right, front));
+    return glm::lookAt(Position, Position + front, up);
 }
 
 // Update Front, Right and Up Vectors using the updated Euler angles
 void Camera::updateCameraVectors() {
-    glm::vec3 front;
-    front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-    front.y = sin(glm::radians(Pitch));
-    front.z = sin(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-    Front = glm::normalize(front);
+    Front = front_from_angles(Yaw, Pitch);
     Right = glm::normalize(glm::cross(Front, WorldUp));
     Up = glm::normalize(glm::cross(Right, Front));
-}
\ No newline at end of file
+    viewDirty = true;
+}
+
+// Rebuild the cached matrices that depend on whatever changed since the last call
+void Camera::updateMatrices() {
+    if (!viewDirty && !projectionDirty)
+        return;
+
+    if (viewDirty) {
+        view = glm::lookAt(Position, Position + Front, Up);
+        inverseView = glm::inverse(view);
+    }
+    if (projectionDirty) {
+        projection = glm::perspective(glm::radians(fov), aspect, nearClip, farClip);
+        inverseProjection = glm::inverse(projection);
+    }
+    viewProjection = projection * view;
+    inverseViewProjection = inverseView * inverseProjection;
+
+    viewDirty = false;
+    projectionDirty = false;
+    ++matrixVersion;
+}
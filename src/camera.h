@@ -5,6 +5,14 @@
 #include <gtc/matrix_transform.hpp>
 #include <GLFW/glfw3.h> // for keyboard input
 
+// Movement directions, combined as bit flags for ProcessKeyboard
+enum Camera_Movement {
+	CAMERA_FORWARD = 1 << 0,
+	CAMERA_BACKWARD = 1 << 1,
+	CAMERA_LEFT = 1 << 2,
+	CAMERA_RIGHT = 1 << 3
+};
+
 class Camera {
 public:
 	// Constructor, with vectors
@@ -12,6 +20,7 @@ public:
 
 
 	// Camera Attributes
+	// (call MarkDirty() after writing any of these directly so the cached matrices get rebuilt)
 	glm::vec3 Position;
 	glm::vec3 Front;
 	glm::vec3 Up;
@@ -23,12 +32,40 @@ public:
 	float MouseSensitivity;
 
 	//Functions
-	glm::mat4 GetViewMatrix(); // Returns the view matrix calculated using Euler Angles and the LookAt Matrix
+	const glm::mat4& GetViewMatrix(); // Returns the view matrix calculated using Euler Angles and the LookAt Matrix
+	const glm::mat4& GetProjectionMatrix();
+	const glm::mat4& GetViewProjectionMatrix(); // projection * view
+	const glm::mat4& GetInverseViewMatrix();
+	const glm::mat4& GetInverseProjectionMatrix();
+	const glm::mat4& GetInverseViewProjectionMatrix();
+	unsigned int GetMatrixVersion() const { return matrixVersion; } // bumped every time any cached matrix changes
+	void SetProjection(float fovDegrees, float aspectRatio, float nearPlane, float farPlane);
+	void MarkDirty();
 	void ProcessKeyboard(GLFWwindow* window, float deltaTime); // Processes input received from any keyboard-like input system
+	void ProcessKeyboard(unsigned int directions, float deltaTime); // Same, from already sampled Camera_Movement flags (used for input replay)
 	void ProcessMouseMovement(float xOffset, float yOffset); // Processes input received from a mouse input system
+	glm::mat4 GetLatchedViewMatrix(float xOffset, float yOffset) const; // The view matrix ProcessMouseMovement(xOffset, yOffset) would give, without moving the camera
 
 private:
 	void updateCameraVectors();
+	void updateMatrices(); // rebuilds whichever cached matrices are dirty
+
+	// Projection parameters
+	float fov;
+	float aspect;
+	float nearClip;
+	float farClip;
+
+	// Cached matrices, only recomputed when the camera actually changes
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::mat4 inverseView;
+	glm::mat4 inverseProjection;
+	glm::mat4 inverseViewProjection;
+	bool viewDirty;
+	bool projectionDirty;
+	unsigned int matrixVersion;
 };
 
 #endif // !CAMERA
@@ -0,0 +1,120 @@
+#include <GL/glew.h> // must come before camera.h pulls in GLFW's gl.h
+#include "camera_uniforms.h"
+#include "gl_state.h"
+
+#include <iostream>
+#include <cstring>
+#include <gtc/type_ptr.hpp>
+
+// std140 layout of the CameraMatrices block
+typedef struct CameraUniformData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::mat4 inverseView;
+    glm::mat4 inverseProjection;
+    glm::mat4 inverseViewProjection;
+    glm::vec4 cameraPosition;
+}CameraUniformData;
+
+CameraUniformBuffer create_camera_uniform_buffer() {
+    CameraUniformBuffer uniforms;
+    uniforms.uploadedVersion = 0;
+    uniforms.region = 0;
+    uniforms.mapped = NULL;
+    uniforms.latched = false;
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniforms.regionSize = (sizeof(CameraUniformData) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &uniforms.buffer);
+    gl_bind_buffer(GL_UNIFORM_BUFFER, uniforms.buffer);
+    if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, (GLsizeiptr)uniforms.regionSize * CAMERA_UNIFORM_FRAMES, NULL, flags);
+        uniforms.mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, (GLsizeiptr)uniforms.regionSize * CAMERA_UNIFORM_FRAMES, flags);
+        if (!uniforms.mapped) {
+            std::cout << "Failed to map the camera uniform buffer, falling back to buffer updates" << std::endl;
+            gl_delete_buffers(1, &uniforms.buffer);
+            glGenBuffers(1, &uniforms.buffer);
+            gl_bind_buffer(GL_UNIFORM_BUFFER, uniforms.buffer);
+        }
+    }
+    if (!uniforms.mapped)
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraUniformData), NULL, GL_DYNAMIC_DRAW);
+    gl_bind_buffer(GL_UNIFORM_BUFFER, 0);
+    gl_bind_buffer_base(GL_UNIFORM_BUFFER, CAMERA_UNIFORM_BINDING, uniforms.buffer);
+    return uniforms;
+}
+
+// the camera's current matrices with view swapped in for its own view
+static void fill_camera_uniform_data(CameraUniformData& data, Camera& camera, const glm::mat4& view) {
+    data.view = view;
+    data.projection = camera.GetProjectionMatrix();
+    data.viewProjection = data.projection * view;
+    data.inverseView = glm::inverse(view);
+    data.inverseProjection = camera.GetInverseProjectionMatrix();
+    data.inverseViewProjection = data.inverseView * data.inverseProjection;
+    data.cameraPosition = glm::vec4(camera.Position, 1.0f);
+}
+
+// into the region bound for this frame
+static void write_camera_uniform_data(CameraUniformBuffer& uniforms, const CameraUniformData& data) {
+    if (uniforms.mapped) {
+        std::memcpy(uniforms.mapped + uniforms.region * uniforms.regionSize, &data, sizeof(CameraUniformData));
+        return;
+    }
+    gl_bind_buffer(GL_UNIFORM_BUFFER, uniforms.buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraUniformData), &data);
+    gl_bind_buffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void update_camera_uniform_buffer(CameraUniformBuffer& uniforms, Camera& camera) {
+    // the matrix getters rebuild anything dirty, so read one before checking the version
+    CameraUniformData data;
+    data.view = camera.GetViewMatrix();
+    if (uniforms.mapped) {
+        // a fresh copy every frame, the one the GPU may still be reading is never written
+        uniforms.region = (uniforms.region + 1) % CAMERA_UNIFORM_FRAMES;
+        gl_bind_buffer_range(GL_UNIFORM_BUFFER, CAMERA_UNIFORM_BINDING, uniforms.buffer, (long long)uniforms.region * uniforms.regionSize, sizeof(CameraUniformData));
+    }
+    else if (camera.GetMatrixVersion() == uniforms.uploadedVersion && !uniforms.latched)
+        return;
+
+    data.projection = camera.GetProjectionMatrix();
+    data.viewProjection = camera.GetViewProjectionMatrix();
+    data.inverseView = camera.GetInverseViewMatrix();
+    data.inverseProjection = camera.GetInverseProjectionMatrix();
+    data.inverseViewProjection = camera.GetInverseViewProjectionMatrix();
+    data.cameraPosition = glm::vec4(camera.Position, 1.0f);
+
+    write_camera_uniform_data(uniforms, data);
+    uniforms.uploadedVersion = camera.GetMatrixVersion();
+    uniforms.latched = false;
+}
+
+void late_latch_camera_uniforms(CameraUniformBuffer& uniforms, Camera& camera, float mouseX, float mouseY) {
+    if (mouseX == 0.0f && mouseY == 0.0f)
+        return;
+    CameraUniformData data;
+    fill_camera_uniform_data(data, camera, camera.GetLatchedViewMatrix(mouseX, mouseY));
+    write_camera_uniform_data(uniforms, data);
+    uniforms.latched = true;
+}
+
+void bind_camera_uniform_block(unsigned int shaderProgram) {
+    unsigned int blockIndex = glGetUniformBlockIndex(shaderProgram, "CameraMatrices");
+    if (blockIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(shaderProgram, blockIndex, CAMERA_UNIFORM_BINDING);
+}
+
+void delete_camera_uniform_buffer(CameraUniformBuffer& uniforms) {
+    if (uniforms.mapped) {
+        gl_bind_buffer(GL_UNIFORM_BUFFER, uniforms.buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        gl_bind_buffer(GL_UNIFORM_BUFFER, 0);
+        uniforms.mapped = NULL;
+    }
+    gl_delete_buffers(1, &uniforms.buffer);
+    uniforms.buffer = 0;
+}
@@ -0,0 +1,48 @@
+#ifndef CAMERA_UNIFORMS
+#define CAMERA_UNIFORMS
+
+#include "camera.h"
+#include "stream_buffer.h"
+
+#define CAMERA_UNIFORM_BINDING 0 // uniform buffer binding point shared by every shader program
+
+// GLSL declaration of the shared camera block, paste into a shader source string after the #version line
+#define CAMERA_UNIFORM_BLOCK_GLSL \
+"layout (std140) uniform CameraMatrices\n" \
+"{\n" \
+"   mat4 view;\n" \
+"   mat4 projection;\n" \
+"   mat4 viewProjection;\n" \
+"   mat4 inverseView;\n" \
+"   mat4 inverseProjection;\n" \
+"   mat4 inverseViewProjection;\n" \
+"   vec4 cameraPosition;\n" \
+"};\n"
+
+#define CAMERA_UNIFORM_FRAMES STREAM_BUFFER_FRAMES // persistently mapped copies, fenced along with the stream buffer
+
+// Uniform buffer holding the camera matrices
+// With GL 4.4 / ARB_buffer_storage it is persistently mapped with one copy of the block per frame in flight, every
+// frame writes and binds the next copy so this frame's matrices can still be rewritten (late latched) right up to the
+// first draw without touching what earlier frames are reading. Otherwise it is a single block re-uploaded only when
+// the camera's matrices changed.
+typedef struct CameraUniformBuffer {
+    unsigned int buffer;
+    unsigned int uploadedVersion; // camera matrix version currently in the buffer, 0 = nothing uploaded yet
+    unsigned int regionSize; // one block rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    unsigned int region; // copy bound for this frame
+    unsigned char* mapped; // whole buffer, persistent only
+    bool latched; // the buffer holds late latched matrices, the next update rewrites it even if the camera didn't change
+}CameraUniformBuffer;
+
+CameraUniformBuffer create_camera_uniform_buffer();
+void update_camera_uniform_buffer(CameraUniformBuffer& uniforms, Camera& camera); // call once per frame
+// Rewrites this frame's matrices with the view the camera will have once the mouse movement that arrived since its
+// update is applied, call after update_camera_uniform_buffer and before the frame's first draw. Only the shaders see
+// the latched view, the camera is left alone and gets the movement through the next frame's input as usual, so CPU
+// culling still uses the unlatched frustum and recorded input replays the same.
+void late_latch_camera_uniforms(CameraUniformBuffer& uniforms, Camera& camera, float mouseX, float mouseY);
+void bind_camera_uniform_block(unsigned int shaderProgram); // points a program's CameraMatrices block at the shared binding
+void delete_camera_uniform_buffer(CameraUniformBuffer& uniforms);
+
+#endif // !CAMERA_UNIFORMS
@@ -0,0 +1,202 @@
+#include <GL/glew.h>
+#include <cstring>
+#include <gtc/type_ptr.hpp>
+#include "command_buffer.h"
+#include "gl_state.h"
+#include "instancing.h"
+
+typedef struct CommandHeader {
+    unsigned short type;
+    unsigned short size; // of the arguments that follow
+}CommandHeader;
+
+typedef struct BindTextureArgs { unsigned int unit, target, texture; }BindTextureArgs;
+typedef struct BindBufferRangeArgs { unsigned int target, index, buffer, offset, size; }BindBufferRangeArgs;
+typedef struct UniformIntArgs { int location; int value; }UniformIntArgs;
+typedef struct UniformUIntArgs { int location; unsigned int value; }UniformUIntArgs;
+typedef struct UniformFloatArgs { int location; float value; }UniformFloatArgs;
+typedef struct UniformVec4Args { int location; float value[4]; }UniformVec4Args;
+typedef struct UniformMat4Args { int location; float value[16]; }UniformMat4Args;
+typedef struct DrawElementsArgs { MeshRange range; unsigned int instanceCount; }DrawElementsArgs;
+typedef struct CallbackArgs { unsigned int callback; int id; }CallbackArgs;
+
+CommandBuffer::CommandBuffer() : commandCount(0) {
+}
+
+void CommandBuffer::Reset() {
+    data.clear();
+    commandCount = 0;
+}
+
+void* CommandBuffer::Record(CommandType type, unsigned int size) {
+    // arguments are 4 byte types only, so keeping every command a multiple of 4 keeps them all aligned
+    size_t offset = data.size();
+    data.resize(offset + sizeof(CommandHeader) + size);
+    CommandHeader header = { (unsigned short)type, (unsigned short)size };
+    std::memcpy(&data[offset], &header, sizeof(header));
+    ++commandCount;
+    return &data[offset + sizeof(CommandHeader)];
+}
+
+void CommandBuffer::UseProgram(unsigned int program) {
+    std::memcpy(Record(COMMAND_USE_PROGRAM, sizeof(program)), &program, sizeof(program));
+}
+
+void CommandBuffer::BindVertexArray(unsigned int vao) {
+    std::memcpy(Record(COMMAND_BIND_VERTEX_ARRAY, sizeof(vao)), &vao, sizeof(vao));
+}
+
+void CommandBuffer::BindTexture(unsigned int unit, unsigned int target, unsigned int texture) {
+    BindTextureArgs args = { unit, target, texture };
+    std::memcpy(Record(COMMAND_BIND_TEXTURE, sizeof(args)), &args, sizeof(args));
+}
+
+void CommandBuffer::BindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, unsigned int offset, unsigned int size) {
+    BindBufferRangeArgs args = { target, index, buffer, offset, size };
+    std::memcpy(Record(COMMAND_BIND_BUFFER_RANGE, sizeof(args)), &args, sizeof(args));
+}
+
+void CommandBuffer::SetUniform(int location, int value) {
+    UniformIntArgs args = { location, value };
+    std::memcpy(Record(COMMAND_SET_UNIFORM_INT, sizeof(args)), &args, sizeof(args));
+}
+
+void CommandBuffer::SetUniform(int location, unsigned int value) {
+    UniformUIntArgs args = { location, value };
+    std::memcpy(Record(COMMAND_SET_UNIFORM_UINT, sizeof(args)), &args, sizeof(args));
+}
+
+void CommandBuffer::SetUniform(int location, float value) {
+    UniformFloatArgs args = { location, value };
+    std::memcpy(Record(COMMAND_SET_UNIFORM_FLOAT, sizeof(args)), &args, sizeof(args));
+}
+
+void CommandBuffer::SetUniform(int location, const glm::vec4& value) {
+    UniformVec4Args args;
+    args.location = location;
+    std::memcpy(args.value, glm::value_ptr(value), sizeof(args.value));
+    std::memcpy(Record(COMMAND_SET_UNIFORM_VEC4, sizeof(args)), &args, sizeof(args));
+}
+
+void CommandBuffer::SetUniform(int location, const glm::mat4& value) {
+    UniformMat4Args args;
+    args.location = location;
+    std::memcpy(args.value, glm::value_ptr(value), sizeof(args.value));
+    std::memcpy(Record(COMMAND_SET_UNIFORM_MAT4, sizeof(args)), &args, sizeof(args));
+}
+
+void CommandBuffer::DrawElements(const MeshRange& range) {
+    DrawElementsArgs args = { range, 1 };
+    std::memcpy(Record(COMMAND_DRAW_ELEMENTS, sizeof(args)), &args, sizeof(args));
+}
+
+void CommandBuffer::DrawElementsInstanced(const MeshRange& range, unsigned int instanceCount) {
+    DrawElementsArgs args = { range, instanceCount };
+    std::memcpy(Record(COMMAND_DRAW_ELEMENTS_INSTANCED, sizeof(args)), &args, sizeof(args));
+}
+
+void CommandBuffer::Callback(unsigned int callback, int id) {
+    CallbackArgs args = { callback, id };
+    std::memcpy(Record(COMMAND_CALLBACK, sizeof(args)), &args, sizeof(args));
+}
+
+void CommandBuffer::Execute(const std::vector<CommandCallback>& callbacks) const {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        CommandHeader header;
+        std::memcpy(&header, &data[offset], sizeof(header));
+        const unsigned char* args = &data[offset + sizeof(CommandHeader)];
+        offset += sizeof(CommandHeader) + header.size;
+
+        switch (header.type) {
+        case COMMAND_USE_PROGRAM: {
+            unsigned int program;
+            std::memcpy(&program, args, sizeof(program));
+            gl_use_program(program);
+            break;
+        }
+        case COMMAND_BIND_VERTEX_ARRAY: {
+            unsigned int vao;
+            std::memcpy(&vao, args, sizeof(vao));
+            gl_bind_vertex_array(vao);
+            break;
+        }
+        case COMMAND_BIND_TEXTURE: {
+            BindTextureArgs bind;
+            std::memcpy(&bind, args, sizeof(bind));
+            gl_active_texture(GL_TEXTURE0 + bind.unit);
+            gl_bind_texture(bind.target, bind.texture);
+            break;
+        }
+        case COMMAND_BIND_BUFFER_RANGE: {
+            BindBufferRangeArgs bind;
+            std::memcpy(&bind, args, sizeof(bind));
+            gl_bind_buffer_range(bind.target, bind.index, bind.buffer, bind.offset, bind.size);
+            break;
+        }
+        case COMMAND_SET_UNIFORM_INT: {
+            UniformIntArgs uniform;
+            std::memcpy(&uniform, args, sizeof(uniform));
+            glUniform1i(uniform.location, uniform.value);
+            break;
+        }
+        case COMMAND_SET_UNIFORM_UINT: {
+            UniformUIntArgs uniform;
+            std::memcpy(&uniform, args, sizeof(uniform));
+            glUniform1ui(uniform.location, uniform.value);
+            break;
+        }
+        case COMMAND_SET_UNIFORM_FLOAT: {
+            UniformFloatArgs uniform;
+            std::memcpy(&uniform, args, sizeof(uniform));
+            glUniform1f(uniform.location, uniform.value);
+            break;
+        }
+        case COMMAND_SET_UNIFORM_VEC4: {
+            UniformVec4Args uniform;
+            std::memcpy(&uniform, args, sizeof(uniform));
+            glUniform4fv(uniform.location, 1, uniform.value);
+            break;
+        }
+        case COMMAND_SET_UNIFORM_MAT4: {
+            UniformMat4Args uniform;
+            std::memcpy(&uniform, args, sizeof(uniform));
+            glUniformMatrix4fv(uniform.location, 1, GL_FALSE, uniform.value);
+            break;
+        }
+        case COMMAND_DRAW_ELEMENTS: {
+            DrawElementsArgs draw;
+            std::memcpy(&draw, args, sizeof(draw));
+            draw_mesh_range(draw.range);
+            break;
+        }
+        case COMMAND_DRAW_ELEMENTS_INSTANCED: {
+            DrawElementsArgs draw;
+            std::memcpy(&draw, args, sizeof(draw));
+            draw_mesh_instanced(draw.range, draw.instanceCount);
+            break;
+        }
+        case COMMAND_CALLBACK: {
+            CallbackArgs callback;
+            std::memcpy(&callback, args, sizeof(callback));
+            if (callback.callback < callbacks.size() && callbacks[callback.callback])
+                callbacks[callback.callback](callback.id);
+            break;
+        }
+        }
+    }
+}
+
+void record_command_buffers(std::vector<CommandBuffer>& buffers, size_t itemCount, const std::function<void(CommandBuffer& buffer, size_t begin, size_t end)>& record, JobSystem* jobs) {
+    size_t bufferCount = buffers.size();
+    auto recordParts = [&](unsigned int first, unsigned int last) {
+        for (size_t part = first; part < last; ++part) {
+            buffers[part].Reset();
+            record(buffers[part], itemCount * part / bufferCount, itemCount * (part + 1) / bufferCount);
+        }
+    };
+    if (jobs)
+        jobs->ParallelFor((unsigned int)bufferCount, 1, recordParts);
+    else
+        recordParts(0, (unsigned int)bufferCount);
+}
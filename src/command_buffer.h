@@ -0,0 +1,67 @@
+#ifndef COMMAND_BUFFER
+#define COMMAND_BUFFER
+
+#include <vector>
+#include <functional>
+#include <glm.hpp>
+#include "mesh_batch.h"
+#include "job_system.h"
+
+// Callbacks a command buffer can call back into while it is replayed, e.g. to begin/end an occlusion query
+typedef std::function<void(int id)> CommandCallback;
+
+typedef enum CommandType {
+    COMMAND_USE_PROGRAM,
+    COMMAND_BIND_VERTEX_ARRAY,
+    COMMAND_BIND_TEXTURE,
+    COMMAND_BIND_BUFFER_RANGE,
+    COMMAND_SET_UNIFORM_INT,
+    COMMAND_SET_UNIFORM_UINT,
+    COMMAND_SET_UNIFORM_FLOAT,
+    COMMAND_SET_UNIFORM_VEC4,
+    COMMAND_SET_UNIFORM_MAT4,
+    COMMAND_DRAW_ELEMENTS,
+    COMMAND_DRAW_ELEMENTS_INSTANCED,
+    COMMAND_CALLBACK
+}CommandType;
+
+// GL calls recorded into a flat byte stream, each command a small header followed by its arguments
+// Recording makes no GL calls, so any thread can fill a buffer while the context thread replays others. Buffers are
+// reused between frames, Reset keeps their memory.
+class CommandBuffer {
+public:
+	CommandBuffer();
+
+	void Reset();
+	bool IsEmpty() const { return data.empty(); }
+	unsigned int GetCommandCount() const { return commandCount; }
+	const std::vector<unsigned char>& GetData() const { return data; } // the recorded stream, for comparing recordings
+
+	void UseProgram(unsigned int program);
+	void BindVertexArray(unsigned int vao);
+	void BindTexture(unsigned int unit, unsigned int target, unsigned int texture); // unit is 0 based
+	void BindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, unsigned int offset, unsigned int size);
+	void SetUniform(int location, int value);
+	void SetUniform(int location, unsigned int value);
+	void SetUniform(int location, float value);
+	void SetUniform(int location, const glm::vec4& value);
+	void SetUniform(int location, const glm::mat4& value);
+	void DrawElements(const MeshRange& range);
+	void DrawElementsInstanced(const MeshRange& range, unsigned int instanceCount);
+	void Callback(unsigned int callback, int id); // calls callbacks[callback](id) during Execute
+
+	// replays the commands in order through the GL state cache, context thread only
+	void Execute(const std::vector<CommandCallback>& callbacks = std::vector<CommandCallback>()) const;
+
+private:
+	void* Record(CommandType type, unsigned int size); // space for the arguments right after the header
+
+	std::vector<unsigned char> data;
+	unsigned int commandCount;
+};
+
+// Splits [0, itemCount) into one contiguous part per buffer and records them as parallel jobs (one after the other
+// without a job system). Replaying the buffers in order afterwards gives the same result as recording everything into one.
+void record_command_buffers(std::vector<CommandBuffer>& buffers, size_t itemCount, const std::function<void(CommandBuffer& buffer, size_t begin, size_t end)>& record, JobSystem* jobs = NULL);
+
+#endif // !COMMAND_BUFFER
@@ -0,0 +1,356 @@
+#include "entity_store.h"
+
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+
+#define ENTITY_INDEX_MASK ((1u << ENTITY_INDEX_BITS) - 1)
+
+// reorders the pools from order[newSlot] = oldSlot
+template <typename T>
+static void permute_pool(std::vector<T>& pool, const std::vector<unsigned int>& order) {
+    std::vector<T> sorted(pool.size());
+    for (size_t slot = 0; slot < order.size(); ++slot)
+        sorted[slot] = pool[order[slot]];
+    pool.swap(sorted);
+}
+
+// moves the last element into slot and drops the last one
+template <typename T>
+static void remove_swap(std::vector<T>& pool, unsigned int slot) {
+    pool[slot] = pool.back();
+    pool.pop_back();
+}
+
+// the same for every array of the local transforms
+static void reserve_trs(TRSBatch& batch, unsigned int count) {
+    std::vector<float>* arrays[] = { &batch.positionX, &batch.positionY, &batch.positionZ, &batch.rotationX, &batch.rotationY,
+        &batch.rotationZ, &batch.rotationW, &batch.scaleX, &batch.scaleY, &batch.scaleZ };
+    for (std::vector<float>* array : arrays)
+        array->reserve(count);
+}
+
+static void permute_trs(TRSBatch& batch, const std::vector<unsigned int>& order) {
+    std::vector<float>* arrays[] = { &batch.positionX, &batch.positionY, &batch.positionZ, &batch.rotationX, &batch.rotationY,
+        &batch.rotationZ, &batch.rotationW, &batch.scaleX, &batch.scaleY, &batch.scaleZ };
+    for (std::vector<float>* array : arrays)
+        permute_pool(*array, order);
+}
+
+static void remove_swap_trs(TRSBatch& batch, unsigned int slot) {
+    std::vector<float>* arrays[] = { &batch.positionX, &batch.positionY, &batch.positionZ, &batch.rotationX, &batch.rotationY,
+        &batch.rotationZ, &batch.rotationW, &batch.scaleX, &batch.scaleY, &batch.scaleZ };
+    for (std::vector<float>* array : arrays)
+        remove_swap(*array, slot);
+    --batch.count;
+}
+
+EntityStore create_entity_store() {
+    EntityStore store;
+    store.count = 0;
+    store.levelStarts.push_back(0);
+    store.firstChildren.push_back(0);
+    store.dirtyBegins.push_back(ENTITY_NONE);
+    store.dirtyEnds.push_back(0);
+    store.anyDirty = false;
+    resize_trs_batch(store.locals, 0);
+    resize_culling_bounds(store.worldBounds, 0);
+    return store;
+}
+
+void reserve_entities(EntityStore& store, unsigned int count) {
+    reserve_trs(store.locals, count);
+    store.meshes.reserve(count);
+    store.materials.reserve(count);
+    store.boundsCenters.reserve(count);
+    store.boundsExtents.reserve(count);
+    store.parents.reserve(count);
+    store.dirty.reserve(count);
+    store.worldMatrices.reserve(count);
+    store.slotEntities.reserve(count);
+    store.handleSlots.reserve(count);
+    store.handleGenerations.reserve(count);
+}
+
+// puts the slots back in breadth first order after the hierarchy changed: the roots, then the children of the first
+// root, of the second and so on, then their children in the same way. Children of one parent keep their relative order
+// and the children of any run of slots end up in one run on the next level.
+static void sort_entity_hierarchy(EntityStore& store) {
+    // children of each slot in slot order, as ranges of one array
+    std::vector<unsigned int> childStarts(store.count + 1, 0), children(store.count);
+    for (unsigned int slot = 0; slot < store.count; ++slot) {
+        if (store.parents[slot] != ENTITY_NONE)
+            ++childStarts[store.parents[slot] + 1];
+    }
+    for (unsigned int slot = 0; slot < store.count; ++slot)
+        childStarts[slot + 1] += childStarts[slot];
+    std::vector<unsigned int> next(childStarts.begin(), childStarts.end() - 1);
+    std::vector<unsigned int> order, newSlots(store.count);
+    order.reserve(store.count);
+    for (unsigned int slot = 0; slot < store.count; ++slot) {
+        if (store.parents[slot] != ENTITY_NONE)
+            children[next[store.parents[slot]]++] = slot;
+        else
+            order.push_back(slot);
+    }
+
+    // order doubles as the queue, a new level starts at the first child of the previous level's first slot
+    store.levelStarts.assign(1, 0);
+    store.firstChildren.assign(store.count + 1, store.count);
+    unsigned int levelEnd = (unsigned int)order.size();
+    for (unsigned int slot = 0; slot < order.size(); ++slot) {
+        if (slot == levelEnd) {
+            store.levelStarts.push_back(slot);
+            levelEnd = (unsigned int)order.size();
+        }
+        store.firstChildren[slot] = (unsigned int)order.size();
+        unsigned int oldSlot = order[slot];
+        order.insert(order.end(), children.begin() + childStarts[oldSlot], children.begin() + childStarts[oldSlot + 1]);
+    }
+    for (unsigned int slot = 0; slot < store.count; ++slot)
+        newSlots[order[slot]] = slot;
+
+    permute_trs(store.locals, order);
+    permute_pool(store.meshes, order);
+    permute_pool(store.materials, order);
+    permute_pool(store.boundsCenters, order);
+    permute_pool(store.boundsExtents, order);
+    permute_pool(store.parents, order);
+    permute_pool(store.worldMatrices, order);
+    permute_pool(store.slotEntities, order);
+    for (unsigned int slot = 0; slot < store.count; ++slot) {
+        if (store.parents[slot] != ENTITY_NONE)
+            store.parents[slot] = newSlots[store.parents[slot]];
+        store.handleSlots[store.slotEntities[slot] & ENTITY_INDEX_MASK] = slot;
+    }
+    // the world bounds are rebuilt rather than moved along
+    store.dirty.assign(store.count, 1);
+    store.dirtyBegins.assign(store.levelStarts.begin(), store.levelStarts.end());
+    store.dirtyEnds.assign(store.levelStarts.begin() + 1, store.levelStarts.end());
+    store.dirtyEnds.push_back(store.count);
+    store.anyDirty = true;
+}
+
+Entity create_entity(EntityStore& store, unsigned int mesh, unsigned int material, const glm::vec3& boundsCenter, const glm::vec3& boundsExtent) {
+    uint32_t handle;
+    if (!store.freeHandles.empty()) {
+        handle = store.freeHandles.back();
+        store.freeHandles.pop_back();
+    }
+    else {
+        handle = (uint32_t)store.handleSlots.size();
+        store.handleSlots.push_back(0);
+        store.handleGenerations.push_back(0);
+    }
+    Entity entity = (store.handleGenerations[handle] << ENTITY_INDEX_BITS) | handle;
+
+    unsigned int slot = store.count++;
+    store.handleSlots[handle] = slot;
+    resize_trs_batch(store.locals, store.count); // identity
+    store.meshes.push_back(mesh);
+    store.materials.push_back(material);
+    store.boundsCenters.push_back(boundsCenter);
+    store.boundsExtents.push_back(boundsExtent);
+    store.parents.push_back(ENTITY_NONE);
+    store.dirty.push_back(0);
+    store.worldMatrices.push_back(glm::mat4(1.0f));
+    store.slotEntities.push_back(entity);
+    resize_culling_bounds(store.worldBounds, store.count);
+    // a new root belongs in front of the children
+    if (store.levelStarts.size() > 1)
+        sort_entity_hierarchy(store);
+    else
+        mark_entity_dirty(store, slot);
+    return entity;
+}
+
+void destroy_entity(EntityStore& store, Entity entity) {
+    if (!entity_alive(store, entity))
+        return;
+    uint32_t handle = entity & ENTITY_INDEX_MASK;
+    unsigned int slot = store.handleSlots[handle];
+    unsigned int last = store.count - 1;
+    bool hierarchy = store.levelStarts.size() > 1;
+
+    if (hierarchy) {
+        // children come after their parent
+        for (unsigned int child = slot + 1; child < store.count; ++child) {
+            if (store.parents[child] == slot) {
+                store.parents[child] = ENTITY_NONE;
+                store.dirty[child] = 1;
+            }
+        }
+    }
+    remove_swap_trs(store.locals, slot);
+    remove_swap(store.meshes, slot);
+    remove_swap(store.materials, slot);
+    remove_swap(store.boundsCenters, slot);
+    remove_swap(store.boundsExtents, slot);
+    remove_swap(store.parents, slot);
+    remove_swap(store.dirty, slot);
+    remove_swap(store.worldMatrices, slot);
+    remove_swap(store.slotEntities, slot);
+    if (slot != last) {
+        store.handleSlots[store.slotEntities[slot] & ENTITY_INDEX_MASK] = slot;
+        if (!hierarchy)
+            mark_entity_dirty(store, slot);
+        else {
+            for (unsigned int child = 0; child < last; ++child) {
+                if (store.parents[child] == last)
+                    store.parents[child] = slot;
+            }
+        }
+    }
+    --store.count;
+    resize_culling_bounds(store.worldBounds, store.count);
+    if (hierarchy)
+        sort_entity_hierarchy(store);
+
+    // wraps after 256 reuses of one handle with the default 24 index bits
+    store.handleGenerations[handle] = (store.handleGenerations[handle] + 1) & (0xFFFFFFFFu >> ENTITY_INDEX_BITS);
+    store.freeHandles.push_back(handle);
+}
+
+bool entity_alive(const EntityStore& store, Entity entity) {
+    uint32_t handle = entity & ENTITY_INDEX_MASK;
+    return entity != ENTITY_NONE && handle < store.handleGenerations.size() && (entity >> ENTITY_INDEX_BITS) == store.handleGenerations[handle];
+}
+
+unsigned int entity_slot(const EntityStore& store, Entity entity) {
+    return store.handleSlots[entity & ENTITY_INDEX_MASK];
+}
+
+bool set_entity_parent(EntityStore& store, Entity child, Entity parent) {
+    if (!entity_alive(store, child) || (parent != ENTITY_NONE && !entity_alive(store, parent))) {
+        std::cout << "ERROR::ENTITY_STORE::DEAD_ENTITY" << std::endl;
+        return false;
+    }
+    unsigned int childSlot = entity_slot(store, child);
+    unsigned int parentSlot = ENTITY_NONE;
+    if (parent != ENTITY_NONE) {
+        parentSlot = entity_slot(store, parent);
+        for (unsigned int ancestor = parentSlot; ancestor != ENTITY_NONE; ancestor = store.parents[ancestor]) {
+            if (ancestor == childSlot) {
+                std::cout << "ERROR::ENTITY_STORE::PARENT_CYCLE" << std::endl;
+                return false;
+            }
+        }
+    }
+    store.parents[childSlot] = parentSlot;
+    sort_entity_hierarchy(store);
+    return true;
+}
+
+void set_entity_transform(EntityStore& store, unsigned int slot, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    set_trs(store.locals, slot, position, rotation, scale);
+    mark_entity_dirty(store, slot);
+}
+
+void set_entity_transform(EntityStore& store, unsigned int slot, const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale) {
+    set_entity_transform(store, slot, position, euler_degrees_to_quat(rotation), scale);
+}
+
+void mark_entity_dirty(EntityStore& store, unsigned int slot) {
+    store.dirty[slot] = 1;
+    store.anyDirty = true;
+    // there are only ever a few levels, a binary search finds the slot's one
+    size_t level = std::upper_bound(store.levelStarts.begin(), store.levelStarts.end(), slot) - store.levelStarts.begin() - 1;
+    store.dirtyBegins[level] = std::min(store.dirtyBegins[level], slot);
+    store.dirtyEnds[level] = std::max(store.dirtyEnds[level], slot + 1);
+}
+
+static bool entity_needs_update(const EntityStore& store, unsigned int slot) {
+    unsigned int parent = store.parents[slot];
+    return store.dirty[slot] || (parent != ENTITY_NONE && store.dirty[parent]);
+}
+
+// slots in [begin, end) all lie on one level, their parents' world matrices are final already
+// Every run of consecutive slots with something to rebuild has its local matrices composed straight into its world
+// matrices, children are then moved into their parent's space in place
+static unsigned int update_entity_range(EntityStore& store, unsigned int begin, unsigned int end) {
+    unsigned int updated = 0;
+    unsigned int slot = begin;
+    while (slot < end) {
+        if (!entity_needs_update(store, slot)) {
+            ++slot;
+            continue;
+        }
+        unsigned int runEnd = slot + 1;
+        while (runEnd < end && entity_needs_update(store, runEnd))
+            ++runEnd;
+        compose_trs_matrices(store.locals, slot, runEnd, &store.worldMatrices[slot][0][0], 16);
+        for (; slot < runEnd; ++slot) {
+            unsigned int parent = store.parents[slot];
+            if (parent != ENTITY_NONE)
+                store.worldMatrices[slot] = store.worldMatrices[parent] * store.worldMatrices[slot];
+            set_culling_bounds(store.worldBounds, slot, store.worldMatrices[slot], store.boundsCenters[slot], store.boundsExtents[slot]);
+            store.dirty[slot] = 1; // passes the change on to the children
+            ++updated;
+        }
+    }
+    return updated;
+}
+
+static unsigned int level_end(const EntityStore& store, size_t level) {
+    return level + 1 < store.levelStarts.size() ? store.levelStarts[level + 1] : store.count;
+}
+
+// the part of a level that has to be looked at: whatever was marked on it plus the children of the range the level
+// above rebuilt, which breadth first order keeps in one run
+static void dirty_level_range(const EntityStore& store, size_t level, unsigned int parentBegin, unsigned int parentEnd, unsigned int& outBegin, unsigned int& outEnd) {
+    unsigned int begin = store.dirtyBegins[level];
+    unsigned int end = std::min(store.dirtyEnds[level], level_end(store, level)); // destroying can leave it past the end
+    if (level > 0 && parentBegin < parentEnd && store.firstChildren[parentBegin] < store.firstChildren[parentEnd]) {
+        begin = std::min(begin, store.firstChildren[parentBegin]);
+        end = std::max(end, store.firstChildren[parentEnd]);
+    }
+    outBegin = begin;
+    outEnd = end;
+}
+
+// the ranges now hold what was looked at, only those flags can be set
+static void clear_dirty_levels(EntityStore& store) {
+    for (size_t level = 0; level < store.levelStarts.size(); ++level) {
+        if (store.dirtyBegins[level] < store.dirtyEnds[level])
+            std::fill(store.dirty.begin() + store.dirtyBegins[level], store.dirty.begin() + store.dirtyEnds[level], 0);
+        store.dirtyBegins[level] = ENTITY_NONE;
+        store.dirtyEnds[level] = 0;
+    }
+    store.anyDirty = false;
+}
+
+unsigned int update_entity_transforms(EntityStore& store) {
+    if (!store.anyDirty)
+        return 0;
+    unsigned int updated = 0;
+    unsigned int begin = 0, end = 0;
+    for (size_t level = 0; level < store.levelStarts.size(); ++level) {
+        dirty_level_range(store, level, begin, end, begin, end);
+        if (begin < end)
+            updated += update_entity_range(store, begin, end);
+        store.dirtyBegins[level] = begin;
+        store.dirtyEnds[level] = end;
+    }
+    clear_dirty_levels(store);
+    return updated;
+}
+
+unsigned int update_entity_transforms_parallel(JobSystem& jobs, EntityStore& store) {
+    if (!store.anyDirty)
+        return 0;
+    std::atomic<unsigned int> updated(0);
+    unsigned int begin = 0, end = 0;
+    for (size_t level = 0; level < store.levelStarts.size(); ++level) {
+        dirty_level_range(store, level, begin, end, begin, end);
+        if (begin < end) {
+            unsigned int rangeStart = begin;
+            jobs.ParallelFor(end - begin, ENTITY_JOB_SIZE, [&store, &updated, rangeStart](unsigned int first, unsigned int last) {
+                updated += update_entity_range(store, rangeStart + first, rangeStart + last);
+            });
+        }
+        store.dirtyBegins[level] = begin;
+        store.dirtyEnds[level] = end;
+    }
+    clear_dirty_levels(store);
+    return updated;
+}
@@ -0,0 +1,76 @@
+#ifndef ENTITY_STORE
+#define ENTITY_STORE
+
+#include <vector>
+#include <cstdint>
+#include <glm.hpp>
+#include "frustum_culling.h"
+#include "job_system.h"
+#include "transform_batch.h"
+
+// Handle to an entity, the low ENTITY_INDEX_BITS pick a handle slot and the rest count how often that slot was reused,
+// so a handle to a destroyed entity never resolves to whatever took its place
+typedef uint32_t Entity;
+#define ENTITY_INDEX_BITS 24
+#define ENTITY_NONE 0xFFFFFFFFu
+
+// Scene entities as structure of arrays component pools
+// Every pool is dense, slot i of each one belongs to the same entity. The slots are kept in breadth first order of the
+// transform hierarchy, all roots first, then their children, then those children's children and so on, so a parent
+// always comes before its children and rebuilding the world matrices is one linear pass. Children of one parent sit
+// next to each other, so the children of any run of slots are a run on the next level too. Creating, destroying or
+// reparenting an entity can move others to keep that order, handles survive the moves but slots don't, look them up
+// again with entity_slot afterwards.
+typedef struct EntityStore {
+    unsigned int count;
+    // components, change the transforms through set_entity_transform (or mark_entity_dirty after writing them
+    // directly) so the next update picks them up
+    TRSBatch locals; // position, rotation and scale relative to the parent
+    std::vector<unsigned int> meshes; // the caller's mesh index
+    std::vector<unsigned int> materials; // texture library material
+    std::vector<glm::vec3> boundsCenters, boundsExtents; // local space AABB of the mesh
+    // hierarchy
+    std::vector<unsigned int> parents; // parent's slot, ENTITY_NONE for roots
+    std::vector<unsigned int> levelStarts; // first slot of each hierarchy depth, levelStarts[0] is always 0
+    // count + 1 entries, slot i's children are [firstChildren[i], firstChildren[i + 1]), only kept with a hierarchy
+    std::vector<unsigned int> firstChildren;
+    std::vector<char> dirty; // local transform changed (or, during an update, the parent's world matrix did)
+    // per level, the range holding every slot marked dirty since the last update (begin ENTITY_NONE when empty), an
+    // update only visits these and the children of what it rebuilt
+    std::vector<unsigned int> dirtyBegins, dirtyEnds;
+    bool anyDirty; // lets an update of an unchanged scene return straight away
+    // rebuilt from the components by update_entity_transforms, world = parent's world * local
+    std::vector<glm::mat4> worldMatrices;
+    CullingBounds worldBounds;
+    // handle bookkeeping
+    std::vector<Entity> slotEntities; // slot -> handle
+    std::vector<uint32_t> handleSlots; // handle index -> slot
+    std::vector<uint32_t> handleGenerations; // handle index -> current generation
+    std::vector<uint32_t> freeHandles;
+}EntityStore;
+
+EntityStore create_entity_store();
+void reserve_entities(EntityStore& store, unsigned int count);
+// New root entity at the origin with no rotation and unit scale
+Entity create_entity(EntityStore& store, unsigned int mesh, unsigned int material, const glm::vec3& boundsCenter, const glm::vec3& boundsExtent);
+// The entity's children become roots, keeping their local transforms
+void destroy_entity(EntityStore& store, Entity entity);
+bool entity_alive(const EntityStore& store, Entity entity);
+unsigned int entity_slot(const EntityStore& store, Entity entity); // the entity's index into the pools
+
+// Makes child's transform relative to parent, ENTITY_NONE makes it a root again
+// Fails if parent is child itself or one of its descendants
+bool set_entity_parent(EntityStore& store, Entity child, Entity parent);
+void set_entity_transform(EntityStore& store, unsigned int slot, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+// rotation as euler angles in degrees, the same as rotating by X, then Y, then Z
+void set_entity_transform(EntityStore& store, unsigned int slot, const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale);
+void mark_entity_dirty(EntityStore& store, unsigned int slot);
+
+// Rebuilds the world matrices and world bounds of the dirty entities and everything below them, one hierarchy level
+// after the other, compose_trs_matrices writes each run of changed slots' local matrices straight into worldMatrices.
+// Returns how many were rebuilt, none for a scene where nothing moved.
+unsigned int update_entity_transforms(EntityStore& store);
+unsigned int update_entity_transforms_parallel(JobSystem& jobs, EntityStore& store); // each level in ENTITY_JOB_SIZE pieces
+#define ENTITY_JOB_SIZE 512
+
+#endif // !ENTITY_STORE
@@ -0,0 +1,54 @@
+#include "flythrough.h"
+
+CameraSpline default_flythrough_spline() {
+    CameraSpline spline;
+    spline.segmentDuration = 2.0f;
+    spline.keyframes = {
+        { glm::vec3(0.0f, 0.0f, 3.0f), -90.0f, 0.0f },
+        { glm::vec3(2.5f, 0.5f, 2.0f), -135.0f, -10.0f },
+        { glm::vec3(3.0f, 1.0f, -1.5f), -200.0f, -15.0f },
+        { glm::vec3(0.0f, 2.5f, -4.0f), -270.0f, -35.0f },
+        { glm::vec3(-4.0f, 1.5f, -7.0f), -330.0f, -20.0f },
+        { glm::vec3(-3.0f, 0.5f, 1.5f), -410.0f, -5.0f },
+        { glm::vec3(0.0f, 0.0f, 3.0f), -450.0f, 0.0f }
+    };
+    return spline;
+}
+
+float flythrough_duration(const CameraSpline& spline) {
+    if (spline.keyframes.size() < 2)
+        return 0.0f;
+    return spline.segmentDuration * (spline.keyframes.size() - 1);
+}
+
+// uniform Catmull-Rom between p1 and p2
+template <typename T>
+static T catmull_rom(const T& p0, const T& p1, const T& p2, const T& p3, float t) {
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+bool apply_flythrough(const CameraSpline& spline, float time, Camera& camera) {
+    float duration = flythrough_duration(spline);
+    if (duration <= 0.0f || time > duration)
+        return false;
+
+    int lastKey = static_cast<int>(spline.keyframes.size()) - 1;
+    int segment = static_cast<int>(time / spline.segmentDuration);
+    if (segment >= lastKey)
+        segment = lastKey - 1;
+    float t = (time - segment * spline.segmentDuration) / spline.segmentDuration;
+
+    // clamp the neighbours at the ends of the path
+    const CameraKeyframe& k0 = spline.keyframes[segment > 0 ? segment - 1 : 0];
+    const CameraKeyframe& k1 = spline.keyframes[segment];
+    const CameraKeyframe& k2 = spline.keyframes[segment + 1];
+    const CameraKeyframe& k3 = spline.keyframes[segment + 2 <= lastKey ? segment + 2 : lastKey];
+
+    camera.Position = catmull_rom(k0.position, k1.position, k2.position, k3.position, t);
+    camera.Yaw = catmull_rom(k0.yaw, k1.yaw, k2.yaw, k3.yaw, t);
+    camera.Pitch = glm::clamp(catmull_rom(k0.pitch, k1.pitch, k2.pitch, k3.pitch, t), -89.0f, 89.0f);
+    camera.MarkDirty();
+    return true;
+}
@@ -0,0 +1,24 @@
+#ifndef FLYTHROUGH
+#define FLYTHROUGH
+
+#include <vector>
+#include <glm.hpp>
+#include "camera.h"
+
+// One control point of a scripted camera path
+typedef struct CameraKeyframe {
+    glm::vec3 position;
+    float yaw, pitch;
+}CameraKeyframe;
+
+typedef struct CameraSpline {
+    std::vector<CameraKeyframe> keyframes;
+    float segmentDuration; // seconds spent between consecutive keyframes
+}CameraSpline;
+
+CameraSpline default_flythrough_spline(); // circles the demo scene and sweeps over the robot crowd
+float flythrough_duration(const CameraSpline& spline);
+// Places the camera on the Catmull-Rom spline at the given time, returns false once past the end
+bool apply_flythrough(const CameraSpline& spline, float time, Camera& camera);
+
+#endif // !FLYTHROUGH
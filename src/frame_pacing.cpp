@@ -0,0 +1,194 @@
+#include <GL/glew.h>
+#include "frame_pacing.h"
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+bool frame_pacing_preset(const std::string& name, FramePacingSettings& outSettings) {
+    if (name == "default") {
+        outSettings.swapMode = SWAP_VSYNC;
+        outSettings.maxFramesInFlight = 2;
+        outSettings.targetFps = 0.0;
+        outSettings.spinWait = true;
+    }
+    else if (name == "competitive") {
+        outSettings.swapMode = SWAP_IMMEDIATE;
+        outSettings.maxFramesInFlight = 1;
+        outSettings.targetFps = 0.0;
+        outSettings.spinWait = true;
+    }
+    else if (name == "kiosk") {
+        outSettings.swapMode = SWAP_VSYNC;
+        outSettings.maxFramesInFlight = 2;
+        outSettings.targetFps = 30.0;
+        outSettings.spinWait = false;
+    }
+    else {
+        std::cout << "ERROR::FRAME_PACING::UNKNOWN_PRESET " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parse_swap_mode(const std::string& name, SwapMode& outMode) {
+    if (name == "off")
+        outMode = SWAP_IMMEDIATE;
+    else if (name == "on")
+        outMode = SWAP_VSYNC;
+    else if (name == "adaptive")
+        outMode = SWAP_ADAPTIVE;
+    else {
+        std::cout << "ERROR::FRAME_PACING::UNKNOWN_SWAP_MODE " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parse_frames_in_flight(const std::string& text, unsigned int& outFrames) {
+    char* end = NULL;
+    long frames = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || frames < 1 || frames > FRAME_PACING_MAX_FRAMES_IN_FLIGHT) {
+        std::cout << "ERROR::FRAME_PACING::INVALID_FRAMES_IN_FLIGHT " << text << ", expected 1 to " << FRAME_PACING_MAX_FRAMES_IN_FLIGHT << std::endl;
+        return false;
+    }
+    outFrames = (unsigned int)frames;
+    return true;
+}
+
+bool parse_fps_limit(const std::string& text, double& outFps) {
+    char* end = NULL;
+    double fps = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || !std::isfinite(fps) || fps < 0.0) {
+        std::cout << "ERROR::FRAME_PACING::INVALID_FPS_LIMIT " << text << ", expected 0 (none) or a positive frame rate" << std::endl;
+        return false;
+    }
+    outFps = fps;
+    return true;
+}
+
+FramePacer::FramePacer(GLFWwindow* window, const FramePacingSettings& settings)
+    : settings(settings), frame(0), oldest(0), inFlight(0), inputTime(0.0), gpuClockOffset(0.0), latencySum(0.0), latencyCount(0) {
+    this->settings.maxFramesInFlight = std::min(std::max(settings.maxFramesInFlight, 1u), (unsigned int)FRAME_PACING_MAX_FRAMES_IN_FLIGHT);
+    if (this->settings.swapMode == SWAP_ADAPTIVE && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+        std::cout << "Adaptive vsync isn't supported, using vsync" << std::endl;
+        this->settings.swapMode = SWAP_VSYNC;
+    }
+    glfwSwapInterval(this->settings.swapMode == SWAP_IMMEDIATE ? 0 : this->settings.swapMode == SWAP_VSYNC ? 1 : -1);
+
+    // on average a frame waits half a refresh for the vertical blank, then takes another half to scan out to the middle
+    // of the screen
+    GLFWmonitor* monitor = glfwGetWindowMonitor(window);
+    if (!monitor)
+        monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+    double refreshPeriod = mode && mode->refreshRate > 0 ? 1.0 / mode->refreshRate : 1.0 / 60.0;
+    displayDelay = refreshPeriod * 0.5;
+    if (this->settings.swapMode != SWAP_IMMEDIATE)
+        displayDelay += refreshPeriod * 0.5;
+
+    timestamps = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    for (unsigned int i = 0; i < FRAME_PACING_MAX_FRAMES_IN_FLIGHT; ++i) {
+        slots[i].fence = NULL;
+        slots[i].query = 0;
+        if (timestamps)
+            glGenQueries(1, &slots[i].query);
+    }
+    if (timestamps)
+        calibrateClocks();
+    frameStart = glfwGetTime();
+}
+
+FramePacer::~FramePacer() {
+    for (unsigned int i = 0; i < FRAME_PACING_MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (slots[i].fence)
+            glDeleteSync((GLsync)slots[i].fence);
+        if (slots[i].query)
+            glDeleteQueries(1, &slots[i].query);
+    }
+}
+
+void FramePacer::BeginFrame() {
+    finishedFrames.clear();
+
+    // collect the frames the GPU is done with, waiting on the oldest only while the queue is full
+    while (inFlight > 0) {
+        FrameSlot& slot = slots[oldest];
+        GLenum result = glClientWaitSync((GLsync)slot.fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            if (inFlight < settings.maxFramesInFlight)
+                break;
+            while (result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync((GLsync)slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        }
+        finishFrame(slot, glfwGetTime());
+        oldest = (oldest + 1) % FRAME_PACING_MAX_FRAMES_IN_FLIGHT;
+        --inFlight;
+    }
+
+    // frame rate limiter, sleeps most of the way and spins the rest since sleeps overshoot by up to a scheduler tick
+    if (settings.targetFps > 0.0) {
+        double deadline = frameStart + 1.0 / settings.targetFps;
+        double margin = settings.spinWait ? FRAME_PACING_SPIN_MARGIN : 0.0;
+        double remaining = deadline - glfwGetTime();
+        while (remaining > margin) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(remaining - margin));
+            remaining = deadline - glfwGetTime();
+        }
+        if (settings.spinWait) {
+            while (glfwGetTime() < deadline)
+                std::this_thread::yield();
+        }
+        // keeps an even cadence, but a frame that was late anyway starts a new one rather than rushing to catch up
+        frameStart = remaining < -1.0 / settings.targetFps ? glfwGetTime() : deadline;
+    }
+    else
+        frameStart = glfwGetTime();
+
+    inputTime = glfwGetTime();
+    ++frame;
+    if (timestamps && frame % FRAME_PACING_CALIBRATION_FRAMES == 0)
+        calibrateClocks();
+}
+
+void FramePacer::EndFrame() {
+    FrameSlot& slot = slots[(oldest + inFlight) % FRAME_PACING_MAX_FRAMES_IN_FLIGHT];
+    if (timestamps)
+        glQueryCounter(slot.query, GL_TIMESTAMP);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frame - 1;
+    slot.inputTime = inputTime;
+    ++inFlight;
+}
+
+float FramePacer::GetAverageLatency() const {
+    return latencyCount > 0 ? (float)(latencySum / latencyCount) : 0.0f;
+}
+
+void FramePacer::finishFrame(FrameSlot& slot, double observedTime) {
+    double finishedTime = observedTime;
+    if (timestamps) {
+        GLuint64 gpuTime = 0;
+        glGetQueryObjectui64v(slot.query, GL_QUERY_RESULT, &gpuTime); // available, the fence after it has signaled
+        // the clocks drift a little between calibrations, never let that move the finish outside what was observed
+        finishedTime = std::min(std::max(gpuTime * 1e-9 + gpuClockOffset, slot.inputTime), observedTime);
+    }
+    FrameLatency latency;
+    latency.frame = slot.frame;
+    latency.milliseconds = (float)((finishedTime - slot.inputTime + displayDelay) * 1000.0);
+    finishedFrames.push_back(latency);
+    latencySum += latency.milliseconds;
+    ++latencyCount;
+
+    glDeleteSync((GLsync)slot.fence);
+    slot.fence = NULL;
+}
+
+void FramePacer::calibrateClocks() {
+    GLint64 gpuTime = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+    gpuClockOffset = glfwGetTime() - gpuTime * 1e-9;
+}
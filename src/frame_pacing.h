@@ -0,0 +1,86 @@
+#ifndef FRAME_PACING
+#define FRAME_PACING
+
+#include <vector>
+#include <string>
+#include <GLFW/glfw3.h>
+#include "stream_buffer.h"
+
+#define FRAME_PACING_MAX_FRAMES_IN_FLIGHT STREAM_BUFFER_FRAMES // more would only end up waiting in the stream buffer
+#define FRAME_PACING_SPIN_MARGIN 0.002 // seconds before the limiter's deadline where sleeping stops and spinning starts
+#define FRAME_PACING_CALIBRATION_FRAMES 300 // how often the GPU clock is lined up with the CPU one again
+
+// Swap behaviour passed to glfwSwapInterval
+enum SwapMode {
+    SWAP_IMMEDIATE, // 0, no vsync, tears but shows every frame as soon as it is done
+    SWAP_VSYNC, // 1
+    SWAP_ADAPTIVE // -1, vsync unless a frame is late, then swap right away (needs *_EXT_swap_control_tear)
+};
+
+typedef struct FramePacingSettings {
+    SwapMode swapMode;
+    unsigned int maxFramesInFlight; // frames the CPU may queue before it waits on the GPU, 1 to FRAME_PACING_MAX_FRAMES_IN_FLIGHT
+    double targetFps; // frame rate limiter, 0 for none
+    bool spinWait; // spin out the last FRAME_PACING_SPIN_MARGIN of a limited frame for precise timing, costs power
+}FramePacingSettings;
+
+// "default": vsync, 2 frames in flight, no limiter
+// "competitive": no vsync, 1 frame in flight, input sampled right before the frame is built for the lowest latency
+// "kiosk": vsync, 2 frames in flight, limited to 30 fps with plain sleeps so the CPU and GPU idle as much as possible
+bool frame_pacing_preset(const std::string& name, FramePacingSettings& outSettings);
+bool parse_swap_mode(const std::string& name, SwapMode& outMode); // off|on|adaptive
+bool parse_frames_in_flight(const std::string& text, unsigned int& outFrames); // 1 to FRAME_PACING_MAX_FRAMES_IN_FLIGHT
+bool parse_fps_limit(const std::string& text, double& outFps); // 0 or more, 0 for none
+
+// Estimated input to photon latency of one finished frame
+typedef struct FrameLatency {
+    unsigned int frame;
+    float milliseconds;
+}FrameLatency;
+
+// Paces the render loop: limits the frame rate, caps the frames queued on the GPU with a fence after each swap, and
+// estimates every frame's latency as the time from sampling its input to the GPU finishing it (a timestamp query
+// when available, otherwise when its fence is seen signaled) plus the wait for and the scan out to the middle of the
+// display. Needs the window's context current.
+class FramePacer {
+public:
+	FramePacer(GLFWwindow* window, const FramePacingSettings& settings);
+	~FramePacer();
+
+	// call at the top of the frame before polling input, waits for the limiter and for a free frame slot
+	void BeginFrame();
+	// call right after glfwSwapBuffers
+	void EndFrame();
+
+	const FramePacingSettings& GetSettings() const { return settings; }
+	// frames whose latency became known during the last BeginFrame, oldest first
+	const std::vector<FrameLatency>& GetFinishedFrames() const { return finishedFrames; }
+	float GetAverageLatency() const; // ms over every finished frame so far
+
+private:
+	typedef struct FrameSlot {
+		void* fence; // GLsync, NULL when the slot is free
+		unsigned int query; // GL_TIMESTAMP after the swap
+		unsigned int frame;
+		double inputTime; // seconds on the glfw clock
+	}FrameSlot;
+
+	void finishFrame(FrameSlot& slot, double observedTime);
+	void calibrateClocks();
+
+	FramePacingSettings settings;
+	FrameSlot slots[FRAME_PACING_MAX_FRAMES_IN_FLIGHT];
+	unsigned int frame; // frames begun
+	unsigned int oldest; // slot of the oldest frame still in flight
+	unsigned int inFlight;
+	double frameStart; // when the limiter last let a frame through
+	double inputTime; // when BeginFrame returned this frame
+	double displayDelay; // seconds added to GPU completion for the display to show the frame
+	bool timestamps;
+	double gpuClockOffset; // glfw time minus GL_TIMESTAMP time, both in seconds
+	std::vector<FrameLatency> finishedFrames;
+	double latencySum;
+	unsigned int latencyCount;
+};
+
+#endif // !FRAME_PACING
@@ -0,0 +1,221 @@
+#include "frustum_culling.h"
+
+#include <cmath>
+#include <algorithm>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_CULLING_SSE
+#endif
+
+void compute_mesh_bounds(const Mesh& mesh, glm::vec3& outCenter, glm::vec3& outExtent) {
+    if (mesh.vertices.size() < 5) {
+        outCenter = glm::vec3(0.0f);
+        outExtent = glm::vec3(0.0f);
+        return;
+    }
+
+    glm::vec3 minCorner(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]);
+    glm::vec3 maxCorner = minCorner;
+    for (size_t i = 5; i + 2 < mesh.vertices.size(); i += 5) {
+        glm::vec3 position(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+        minCorner = glm::min(minCorner, position);
+        maxCorner = glm::max(maxCorner, position);
+    }
+    outCenter = (minCorner + maxCorner) * 0.5f;
+    outExtent = (maxCorner - minCorner) * 0.5f;
+}
+
+Frustum extract_frustum_planes(const glm::mat4& viewProjection) {
+    // glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0; // left
+    frustum.planes[1] = row3 - row0; // right
+    frustum.planes[2] = row3 + row1; // bottom
+    frustum.planes[3] = row3 - row1; // top
+    frustum.planes[4] = row3 + row2; // near
+    frustum.planes[5] = row3 - row2; // far
+
+    // normalize so plane distances are in world units, needed for the sphere test
+    for (int i = 0; i < 6; ++i) {
+        float length = glm::length(glm::vec3(frustum.planes[i]));
+        if (length > 0.0f)
+            frustum.planes[i] /= length;
+    }
+    return frustum;
+}
+
+void resize_culling_bounds(CullingBounds& bounds, unsigned int count) {
+    unsigned int padded = (count + CULLING_BATCH - 1) / CULLING_BATCH * CULLING_BATCH;
+    bounds.count = count;
+    bounds.centerX.resize(padded, 0.0f);
+    bounds.centerY.resize(padded, 0.0f);
+    bounds.centerZ.resize(padded, 0.0f);
+    bounds.extentX.resize(padded, 0.0f);
+    bounds.extentY.resize(padded, 0.0f);
+    bounds.extentZ.resize(padded, 0.0f);
+    bounds.radius.resize(padded, 0.0f);
+}
+
+void set_culling_bounds(CullingBounds& bounds, unsigned int index, const glm::mat4& model, const glm::vec3& localCenter, const glm::vec3& localExtent) {
+    glm::vec3 center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+    // the world extent along each axis is the sum of the absolute rotated/scaled local extents
+    glm::vec3 extent;
+    extent.x = std::fabs(model[0][0]) * localExtent.x + std::fabs(model[1][0]) * localExtent.y + std::fabs(model[2][0]) * localExtent.z;
+    extent.y = std::fabs(model[0][1]) * localExtent.x + std::fabs(model[1][1]) * localExtent.y + std::fabs(model[2][1]) * localExtent.z;
+    extent.z = std::fabs(model[0][2]) * localExtent.x + std::fabs(model[1][2]) * localExtent.y + std::fabs(model[2][2]) * localExtent.z;
+
+    bounds.centerX[index] = center.x;
+    bounds.centerY[index] = center.y;
+    bounds.centerZ[index] = center.z;
+    bounds.extentX[index] = extent.x;
+    bounds.extentY[index] = extent.y;
+    bounds.extentZ[index] = extent.z;
+    bounds.radius[index] = glm::length(extent);
+}
+
+glm::vec3 culling_bounds_center(const CullingBounds& bounds, unsigned int index) {
+    return glm::vec3(bounds.centerX[index], bounds.centerY[index], bounds.centerZ[index]);
+}
+
+glm::vec3 culling_bounds_extent(const CullingBounds& bounds, unsigned int index) {
+    return glm::vec3(bounds.extentX[index], bounds.extentY[index], bounds.extentZ[index]);
+}
+
+// append the set bits of an 8 wide visibility mask as object indices
+static inline void append_visible(unsigned int mask, unsigned int base, unsigned int count, std::vector<unsigned int>& visibleIndices) {
+    for (unsigned int bit = 0; mask && bit < CULLING_BATCH; ++bit, mask >>= 1) {
+        if ((mask & 1u) && base + bit < count)
+            visibleIndices.push_back(base + bit);
+    }
+}
+
+// an AABB is outside if, for any plane, center distance + projected extent is negative
+// a sphere is the same test with the radius as the projected extent
+static unsigned int cull_bounds(const Frustum& frustum, const CullingBounds& bounds, unsigned int begin, unsigned int end, bool useSpheres, std::vector<unsigned int>& visibleIndices) {
+    size_t startSize = visibleIndices.size();
+    unsigned int last = std::min(end, bounds.count);
+    unsigned int padded = (last + CULLING_BATCH - 1) / CULLING_BATCH * CULLING_BATCH;
+
+#if defined(__AVX__)
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    for (unsigned int base = begin; base < padded; base += 8) {
+        __m256 cx = _mm256_loadu_ps(&bounds.centerX[base]);
+        __m256 cy = _mm256_loadu_ps(&bounds.centerY[base]);
+        __m256 cz = _mm256_loadu_ps(&bounds.centerZ[base]);
+        __m256 ex = _mm256_loadu_ps(&bounds.extentX[base]);
+        __m256 ey = _mm256_loadu_ps(&bounds.extentY[base]);
+        __m256 ez = _mm256_loadu_ps(&bounds.extentZ[base]);
+        __m256 r = _mm256_loadu_ps(&bounds.radius[base]);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (int p = 0; p < 6; ++p) {
+            const glm::vec4& plane = frustum.planes[p];
+            __m256 nx = _mm256_set1_ps(plane.x), ny = _mm256_set1_ps(plane.y), nz = _mm256_set1_ps(plane.z);
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)),
+                _mm256_add_ps(_mm256_mul_ps(nz, cz), _mm256_set1_ps(plane.w)));
+            __m256 reach = r;
+            if (!useSpheres) {
+                __m256 ax = _mm256_andnot_ps(signMask, nx), ay = _mm256_andnot_ps(signMask, ny), az = _mm256_andnot_ps(signMask, nz);
+                reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, ex), _mm256_mul_ps(ay, ey)), _mm256_mul_ps(az, ez));
+            }
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        append_visible(static_cast<unsigned int>(_mm256_movemask_ps(inside)), base, last, visibleIndices);
+    }
+#elif defined(FRUSTUM_CULLING_SSE)
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    for (unsigned int base = begin; base < padded; base += 8) {
+        unsigned int mask = 0;
+        for (unsigned int half = 0; half < 8; half += 4) {
+            unsigned int i = base + half;
+            __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+            __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+            __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+            __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+            __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+            __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+            __m128 r = _mm_loadu_ps(&bounds.radius[i]);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+            for (int p = 0; p < 6; ++p) {
+                const glm::vec4& plane = frustum.planes[p];
+                __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                    _mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(plane.w)));
+                __m128 reach = r;
+                if (!useSpheres) {
+                    __m128 ax = _mm_andnot_ps(signMask, nx), ay = _mm_andnot_ps(signMask, ny), az = _mm_andnot_ps(signMask, nz);
+                    reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, ex), _mm_mul_ps(ay, ey)), _mm_mul_ps(az, ez));
+                }
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+            }
+            mask |= static_cast<unsigned int>(_mm_movemask_ps(inside)) << half;
+        }
+        append_visible(mask, base, last, visibleIndices);
+    }
+#else
+    for (unsigned int i = begin; i < last; ++i) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; ++p) {
+            const glm::vec4& plane = frustum.planes[p];
+            float distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+            float reach = useSpheres ? bounds.radius[i]
+                : std::fabs(plane.x) * bounds.extentX[i] + std::fabs(plane.y) * bounds.extentY[i] + std::fabs(plane.z) * bounds.extentZ[i];
+            inside = distance + reach >= 0.0f;
+        }
+        if (inside)
+            visibleIndices.push_back(i);
+    }
+    (void)padded;
+#endif
+
+    return static_cast<unsigned int>(visibleIndices.size() - startSize);
+}
+
+unsigned int cull_aabbs(const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visibleIndices) {
+    return cull_bounds(frustum, bounds, 0, bounds.count, false, visibleIndices);
+}
+
+unsigned int cull_spheres(const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visibleIndices) {
+    return cull_bounds(frustum, bounds, 0, bounds.count, true, visibleIndices);
+}
+
+unsigned int cull_aabbs_range(const Frustum& frustum, const CullingBounds& bounds, unsigned int begin, unsigned int end, std::vector<unsigned int>& visibleIndices) {
+    return cull_bounds(frustum, bounds, begin, end, false, visibleIndices);
+}
+
+unsigned int cull_spheres_range(const Frustum& frustum, const CullingBounds& bounds, unsigned int begin, unsigned int end, std::vector<unsigned int>& visibleIndices) {
+    return cull_bounds(frustum, bounds, begin, end, true, visibleIndices);
+}
+
+static unsigned int cull_bounds_parallel(JobSystem& jobs, const Frustum& frustum, const CullingBounds& bounds, bool useSpheres, std::vector<unsigned int>& visibleIndices) {
+    unsigned int jobCount = (bounds.count + CULLING_JOB_SIZE - 1) / CULLING_JOB_SIZE;
+    if (jobCount <= 1)
+        return cull_bounds(frustum, bounds, 0, bounds.count, useSpheres, visibleIndices);
+
+    // each job appends to its own list, joined in job order afterwards
+    std::vector<std::vector<unsigned int>> jobVisible(jobCount);
+    jobs.ParallelFor(jobCount, 1, [&](unsigned int first, unsigned int last) {
+        for (unsigned int job = first; job < last; ++job)
+            cull_bounds(frustum, bounds, job * CULLING_JOB_SIZE, (job + 1) * CULLING_JOB_SIZE, useSpheres, jobVisible[job]);
+    });
+    size_t startSize = visibleIndices.size();
+    for (const std::vector<unsigned int>& visible : jobVisible)
+        visibleIndices.insert(visibleIndices.end(), visible.begin(), visible.end());
+    return static_cast<unsigned int>(visibleIndices.size() - startSize);
+}
+
+unsigned int cull_aabbs_parallel(JobSystem& jobs, const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visibleIndices) {
+    return cull_bounds_parallel(jobs, frustum, bounds, false, visibleIndices);
+}
+
+unsigned int cull_spheres_parallel(JobSystem& jobs, const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visibleIndices) {
+    return cull_bounds_parallel(jobs, frustum, bounds, true, visibleIndices);
+}
@@ -0,0 +1,48 @@
+#ifndef FRUSTUM_CULLING
+#define FRUSTUM_CULLING
+
+#include <vector>
+#include <glm.hpp>
+#include "mesh.h"
+#include "job_system.h"
+
+#define CULLING_BATCH 8 // bounds are tested this many at a time, arrays are padded to a multiple of it
+#define CULLING_JOB_SIZE 1024 // bounds per job when culling on the job system, a multiple of CULLING_BATCH
+
+// The six clip planes (left, right, bottom, top, near, far) as xyz = normal, w = distance, normals point inwards
+typedef struct Frustum {
+    glm::vec4 planes[6];
+}Frustum;
+
+// Structure of arrays world space bounds, each object has an AABB (center/extent) and a bounding sphere
+typedef struct CullingBounds {
+    unsigned int count;
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+}CullingBounds;
+
+// Local space AABB of a mesh using the position + texture coordinate vertex layout
+void compute_mesh_bounds(const Mesh& mesh, glm::vec3& outCenter, glm::vec3& outExtent);
+
+// Gribb/Hartmann plane extraction from projection * view
+Frustum extract_frustum_planes(const glm::mat4& viewProjection);
+
+void resize_culling_bounds(CullingBounds& bounds, unsigned int count);
+// Transforms a local AABB by the model matrix and stores the enclosing world AABB and sphere at index
+void set_culling_bounds(CullingBounds& bounds, unsigned int index, const glm::mat4& model, const glm::vec3& localCenter, const glm::vec3& localExtent);
+glm::vec3 culling_bounds_center(const CullingBounds& bounds, unsigned int index);
+glm::vec3 culling_bounds_extent(const CullingBounds& bounds, unsigned int index);
+
+// Append the index of every object that is at least partially inside the frustum to visibleIndices, returns the visible count
+// Uses AVX when compiled with it, otherwise SSE, otherwise a scalar loop
+unsigned int cull_aabbs(const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visibleIndices);
+unsigned int cull_spheres(const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visibleIndices);
+// Same for the objects in [begin, end) only, begin must be a multiple of CULLING_BATCH, lets disjoint ranges be culled in parallel
+unsigned int cull_aabbs_range(const Frustum& frustum, const CullingBounds& bounds, unsigned int begin, unsigned int end, std::vector<unsigned int>& visibleIndices);
+unsigned int cull_spheres_range(const Frustum& frustum, const CullingBounds& bounds, unsigned int begin, unsigned int end, std::vector<unsigned int>& visibleIndices);
+// Culls CULLING_JOB_SIZE ranges as jobs, the indices still come out in order
+unsigned int cull_aabbs_parallel(JobSystem& jobs, const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visibleIndices);
+unsigned int cull_spheres_parallel(JobSystem& jobs, const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visibleIndices);
+
+#endif // !FRUSTUM_CULLING
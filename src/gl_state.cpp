@@ -0,0 +1,295 @@
+#include <GL/glew.h>
+#include <unordered_map>
+#include "gl_state.h"
+
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu // never a valid GL name or enum, so the next call always goes through
+#define GL_STATE_TEXTURE_UNITS 32
+#define GL_STATE_TEXTURE_TARGETS 4
+
+typedef struct IndexedBinding {
+    unsigned int buffer;
+    long long offset, size; // -1 for a whole buffer (glBindBufferBase)
+}IndexedBinding;
+
+// Bindings missing from the maps are unknown, the first call for them always goes through
+typedef struct GLState {
+    unsigned int program;
+    unsigned int vao;
+    std::unordered_map<unsigned int, unsigned int> buffers; // target -> buffer, except GL_ELEMENT_ARRAY_BUFFER
+    std::unordered_map<unsigned int, unsigned int> elementBuffers; // vao -> element buffer, it's part of the VAO
+    std::unordered_map<unsigned long long, IndexedBinding> indexedBuffers; // target << 32 | index
+    unsigned int activeTexture;
+    unsigned int textures[GL_STATE_TEXTURE_UNITS][GL_STATE_TEXTURE_TARGETS];
+    unsigned int drawFramebuffer, readFramebuffer;
+    std::unordered_map<unsigned int, bool> capabilities;
+    unsigned int depthMask;
+    unsigned int depthFunc;
+    unsigned int colorMask;
+    int viewport[4];
+    GLStateStats stats;
+}GLState;
+
+static void reset_state(GLState& state) {
+    state.program = GL_STATE_UNKNOWN;
+    state.vao = GL_STATE_UNKNOWN;
+    state.buffers.clear();
+    state.elementBuffers.clear();
+    state.indexedBuffers.clear();
+    state.activeTexture = GL_STATE_UNKNOWN;
+    for (int unit = 0; unit < GL_STATE_TEXTURE_UNITS; ++unit) {
+        for (int slot = 0; slot < GL_STATE_TEXTURE_TARGETS; ++slot)
+            state.textures[unit][slot] = GL_STATE_UNKNOWN;
+    }
+    state.drawFramebuffer = GL_STATE_UNKNOWN;
+    state.readFramebuffer = GL_STATE_UNKNOWN;
+    state.capabilities.clear();
+    state.depthMask = GL_STATE_UNKNOWN;
+    state.depthFunc = GL_STATE_UNKNOWN;
+    state.colorMask = GL_STATE_UNKNOWN;
+    state.viewport[0] = state.viewport[1] = state.viewport[2] = state.viewport[3] = -1;
+}
+
+static GLState& current_state() {
+    static GLState state = [] {
+        GLState initial;
+        reset_state(initial);
+        initial.stats = GLStateStats{ 0, 0 };
+        return initial;
+    }();
+    return state;
+}
+
+// counts the call, returns whether it has to reach the driver
+static bool record(GLState& state, bool changed) {
+    if (changed)
+        ++state.stats.issued;
+    else
+        ++state.stats.filtered;
+    return changed;
+}
+
+static int texture_target_slot(unsigned int target) {
+    switch (target) {
+    case GL_TEXTURE_2D: return 0;
+    case GL_TEXTURE_2D_ARRAY: return 1;
+    case GL_TEXTURE_CUBE_MAP: return 2;
+    case GL_TEXTURE_3D: return 3;
+    default: return -1; // not tracked, always issued
+    }
+}
+
+void gl_use_program(unsigned int program) {
+    GLState& state = current_state();
+    if (record(state, state.program != program)) {
+        state.program = program;
+        glUseProgram(program);
+    }
+}
+
+void gl_bind_vertex_array(unsigned int vao) {
+    GLState& state = current_state();
+    if (record(state, state.vao != vao)) {
+        state.vao = vao;
+        glBindVertexArray(vao);
+    }
+}
+
+void gl_bind_buffer(unsigned int target, unsigned int buffer) {
+    GLState& state = current_state();
+    std::unordered_map<unsigned int, unsigned int>& bindings = target == GL_ELEMENT_ARRAY_BUFFER ? state.elementBuffers : state.buffers;
+    // with an unknown VAO bound there is no way to tell which VAO the element buffer goes into
+    unsigned int key = target == GL_ELEMENT_ARRAY_BUFFER ? state.vao : target;
+    auto found = bindings.find(key);
+    bool changed = found == bindings.end() || found->second != buffer || key == GL_STATE_UNKNOWN;
+    if (record(state, changed)) {
+        bindings[key] = buffer;
+        glBindBuffer(target, buffer);
+    }
+}
+
+static void bind_indexed_buffer(unsigned int target, unsigned int index, unsigned int buffer, long long offset, long long size) {
+    GLState& state = current_state();
+    unsigned long long key = ((unsigned long long)target << 32) | index;
+    auto found = state.indexedBuffers.find(key);
+    bool changed = found == state.indexedBuffers.end() || found->second.buffer != buffer || found->second.offset != offset || found->second.size != size;
+    if (record(state, changed)) {
+        state.indexedBuffers[key] = IndexedBinding{ buffer, offset, size };
+        state.buffers[target] = buffer; // binding an index also binds the generic target
+        if (offset < 0)
+            glBindBufferBase(target, index, buffer);
+        else
+            glBindBufferRange(target, index, buffer, (GLintptr)offset, (GLsizeiptr)size);
+    }
+}
+
+void gl_bind_buffer_base(unsigned int target, unsigned int index, unsigned int buffer) {
+    bind_indexed_buffer(target, index, buffer, -1, -1);
+}
+
+void gl_bind_buffer_range(unsigned int target, unsigned int index, unsigned int buffer, long long offset, long long size) {
+    bind_indexed_buffer(target, index, buffer, offset, size);
+}
+
+void gl_active_texture(unsigned int unit) {
+    GLState& state = current_state();
+    if (record(state, state.activeTexture != unit)) {
+        state.activeTexture = unit;
+        glActiveTexture(unit);
+    }
+}
+
+void gl_bind_texture(unsigned int target, unsigned int texture) {
+    GLState& state = current_state();
+    unsigned int unit = state.activeTexture - GL_TEXTURE0;
+    int slot = texture_target_slot(target);
+    bool tracked = state.activeTexture != GL_STATE_UNKNOWN && unit < GL_STATE_TEXTURE_UNITS && slot >= 0;
+    if (record(state, !tracked || state.textures[unit][slot] != texture)) {
+        if (tracked)
+            state.textures[unit][slot] = texture;
+        glBindTexture(target, texture);
+    }
+}
+
+void gl_bind_framebuffer(unsigned int target, unsigned int framebuffer) {
+    GLState& state = current_state();
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool changed = (draw && state.drawFramebuffer != framebuffer) || (read && state.readFramebuffer != framebuffer);
+    if (record(state, changed)) {
+        if (draw)
+            state.drawFramebuffer = framebuffer;
+        if (read)
+            state.readFramebuffer = framebuffer;
+        glBindFramebuffer(target, framebuffer);
+    }
+}
+
+static void set_capability(unsigned int capability, bool enabled) {
+    GLState& state = current_state();
+    auto found = state.capabilities.find(capability);
+    if (record(state, found == state.capabilities.end() || found->second != enabled)) {
+        state.capabilities[capability] = enabled;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+}
+
+void gl_enable(unsigned int capability) {
+    set_capability(capability, true);
+}
+
+void gl_disable(unsigned int capability) {
+    set_capability(capability, false);
+}
+
+void gl_depth_mask(unsigned char flag) {
+    GLState& state = current_state();
+    unsigned int mask = flag ? 1u : 0u;
+    if (record(state, state.depthMask != mask)) {
+        state.depthMask = mask;
+        glDepthMask(flag);
+    }
+}
+
+void gl_depth_func(unsigned int func) {
+    GLState& state = current_state();
+    if (record(state, state.depthFunc != func)) {
+        state.depthFunc = func;
+        glDepthFunc(func);
+    }
+}
+
+void gl_color_mask(unsigned char red, unsigned char green, unsigned char blue, unsigned char alpha) {
+    GLState& state = current_state();
+    unsigned int mask = (red ? 1u : 0u) | (green ? 2u : 0u) | (blue ? 4u : 0u) | (alpha ? 8u : 0u);
+    if (record(state, state.colorMask != mask)) {
+        state.colorMask = mask;
+        glColorMask(red, green, blue, alpha);
+    }
+}
+
+void gl_viewport(int x, int y, int width, int height) {
+    GLState& state = current_state();
+    int* viewport = state.viewport;
+    if (record(state, viewport[0] != x || viewport[1] != y || viewport[2] != width || viewport[3] != height)) {
+        viewport[0] = x;
+        viewport[1] = y;
+        viewport[2] = width;
+        viewport[3] = height;
+        glViewport(x, y, width, height);
+    }
+}
+
+void gl_delete_program(unsigned int program) {
+    GLState& state = current_state();
+    if (state.program == program)
+        state.program = GL_STATE_UNKNOWN;
+    glDeleteProgram(program);
+}
+
+void gl_delete_vertex_arrays(int count, const unsigned int* vaos) {
+    GLState& state = current_state();
+    for (int i = 0; i < count; ++i) {
+        if (state.vao == vaos[i])
+            state.vao = GL_STATE_UNKNOWN;
+        state.elementBuffers.erase(vaos[i]);
+    }
+    glDeleteVertexArrays(count, vaos);
+}
+
+void gl_delete_buffers(int count, const unsigned int* buffers) {
+    GLState& state = current_state();
+    for (int i = 0; i < count; ++i) {
+        for (auto& binding : state.buffers) {
+            if (binding.second == buffers[i])
+                binding.second = GL_STATE_UNKNOWN;
+        }
+        for (auto& binding : state.elementBuffers) {
+            if (binding.second == buffers[i])
+                binding.second = GL_STATE_UNKNOWN;
+        }
+        for (auto& binding : state.indexedBuffers) {
+            if (binding.second.buffer == buffers[i])
+                binding.second.buffer = GL_STATE_UNKNOWN;
+        }
+    }
+    glDeleteBuffers(count, buffers);
+}
+
+void gl_delete_textures(int count, const unsigned int* textures) {
+    GLState& state = current_state();
+    for (int i = 0; i < count; ++i) {
+        for (int unit = 0; unit < GL_STATE_TEXTURE_UNITS; ++unit) {
+            for (int slot = 0; slot < GL_STATE_TEXTURE_TARGETS; ++slot) {
+                if (state.textures[unit][slot] == textures[i])
+                    state.textures[unit][slot] = GL_STATE_UNKNOWN;
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
+
+void gl_delete_framebuffers(int count, const unsigned int* framebuffers) {
+    GLState& state = current_state();
+    for (int i = 0; i < count; ++i) {
+        if (state.drawFramebuffer == framebuffers[i])
+            state.drawFramebuffer = GL_STATE_UNKNOWN;
+        if (state.readFramebuffer == framebuffers[i])
+            state.readFramebuffer = GL_STATE_UNKNOWN;
+    }
+    glDeleteFramebuffers(count, framebuffers);
+}
+
+void gl_state_invalidate() {
+    reset_state(current_state());
+}
+
+GLStateStats gl_state_stats() {
+    return current_state().stats;
+}
+
+void gl_state_reset_stats() {
+    current_state().stats = GLStateStats{ 0, 0 };
+}
@@ -0,0 +1,40 @@
+#ifndef GL_STATE
+#define GL_STATE
+
+// Shadow copy of the GL binding and fixed function state, every bind and state call in the renderer goes through
+// these instead of calling GL directly so calls that wouldn't change anything never reach the driver.
+// Anything that changes bindings behind the cache's back (deleting a bound object, a library making GL calls) must
+// go through the gl_delete_* wrappers or be followed by gl_state_invalidate().
+
+typedef struct GLStateStats {
+    unsigned int issued; // calls that reached the driver
+    unsigned int filtered; // calls dropped because the state already matched
+}GLStateStats;
+
+void gl_use_program(unsigned int program);
+void gl_bind_vertex_array(unsigned int vao);
+void gl_bind_buffer(unsigned int target, unsigned int buffer); // the element array binding is tracked per VAO
+void gl_bind_buffer_base(unsigned int target, unsigned int index, unsigned int buffer);
+void gl_bind_buffer_range(unsigned int target, unsigned int index, unsigned int buffer, long long offset, long long size);
+void gl_active_texture(unsigned int unit); // GL_TEXTURE0 + n like glActiveTexture
+void gl_bind_texture(unsigned int target, unsigned int texture); // binds to the active unit
+void gl_bind_framebuffer(unsigned int target, unsigned int framebuffer);
+void gl_enable(unsigned int capability);
+void gl_disable(unsigned int capability);
+void gl_depth_mask(unsigned char flag);
+void gl_depth_func(unsigned int func);
+void gl_color_mask(unsigned char red, unsigned char green, unsigned char blue, unsigned char alpha);
+void gl_viewport(int x, int y, int width, int height);
+
+// Deleting unbinds the object in GL, so the shadow copy has to forget it too or a recycled name would be skipped
+void gl_delete_program(unsigned int program);
+void gl_delete_vertex_arrays(int count, const unsigned int* vaos);
+void gl_delete_buffers(int count, const unsigned int* buffers);
+void gl_delete_textures(int count, const unsigned int* textures);
+void gl_delete_framebuffers(int count, const unsigned int* framebuffers);
+
+void gl_state_invalidate(); // forget everything, the next call of each kind always reaches the driver
+GLStateStats gl_state_stats(); // counts since the last reset
+void gl_state_reset_stats(); // call once per frame for per frame counts
+
+#endif // !GL_STATE
@@ -0,0 +1,250 @@
+#include <GL/glew.h>
+#include "gpu_profiler.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+#define GPU_PROFILER_DROPPED 0xFFFFFFFFu // open scope past GPU_PROFILER_MAX_SCOPES
+
+GpuProfiler::GpuProfiler(bool enabled)
+    : enabled(enabled), pipelineStatistics(false), frame(0), sample(0), samples(0), droppedFrames(0) {
+    if (enabled && !IsSupported()) {
+        std::cout << "GPU profiling needs OpenGL 3.3 or ARB_timer_query, profiling disabled" << std::endl;
+        this->enabled = false;
+    }
+    if (this->enabled)
+        pipelineStatistics = GLEW_VERSION_4_6 || GLEW_ARB_pipeline_statistics_query;
+    for (unsigned int i = 0; i < GPU_PROFILER_FRAMES; ++i) {
+        frames[i].statisticsUsed = 0;
+        frames[i].lastQuery = 0;
+        frames[i].pending = false;
+    }
+    frameMs.assign(GPU_PROFILER_WINDOW, 0.0f);
+}
+
+GpuProfiler::~GpuProfiler() {
+    for (unsigned int i = 0; i < GPU_PROFILER_FRAMES; ++i) {
+        if (!frames[i].timestamps.empty())
+            glDeleteQueries((GLsizei)frames[i].timestamps.size(), frames[i].timestamps.data());
+        if (!frames[i].statistics.empty())
+            glDeleteQueries((GLsizei)frames[i].statistics.size(), frames[i].statistics.data());
+    }
+}
+
+bool GpuProfiler::IsSupported() {
+    return GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+}
+
+void GpuProfiler::BeginFrame() {
+    if (!enabled)
+        return;
+    FrameQueries& queries = frames[frame];
+    if (queries.pending) {
+        // reissuing the queries would throw away results that aren't ready yet, which is fine, waiting isn't
+        if (!collect(queries))
+            ++droppedFrames;
+        queries.pending = false;
+    }
+    queries.scopes.clear();
+    queries.open.clear();
+    queries.statisticsUsed = 0;
+}
+
+void GpuProfiler::BeginScope(const char* name) {
+    if (!enabled)
+        return;
+    FrameQueries& queries = frames[frame];
+    if (queries.scopes.size() >= GPU_PROFILER_MAX_SCOPES) {
+        queries.open.push_back(GPU_PROFILER_DROPPED);
+        return;
+    }
+    // the pools grow to whatever the busiest frame needed and are reused from then on
+    unsigned int index = (unsigned int)queries.scopes.size();
+    if (queries.timestamps.size() < 2 * (index + 1)) {
+        queries.timestamps.resize(2 * (index + 1));
+        glGenQueries(2, &queries.timestamps[2 * index]);
+    }
+    glQueryCounter(queries.timestamps[2 * index], GL_TIMESTAMP);
+
+    Scope scope;
+    scope.name = name;
+    scope.depth = (unsigned int)queries.open.size();
+    // only one query per statistic can be active, so only the passes get them
+    scope.statistics = pipelineStatistics && scope.depth == 0;
+    if (scope.statistics) {
+        unsigned int first = 3 * queries.statisticsUsed++;
+        if (queries.statistics.size() < first + 3) {
+            queries.statistics.resize(first + 3);
+            glGenQueries(3, &queries.statistics[first]);
+        }
+        glBeginQuery(GL_VERTICES_SUBMITTED_ARB, queries.statistics[first]);
+        glBeginQuery(GL_PRIMITIVES_SUBMITTED_ARB, queries.statistics[first + 1]);
+        glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, queries.statistics[first + 2]);
+    }
+    queries.scopes.push_back(scope);
+    queries.open.push_back(index);
+}
+
+void GpuProfiler::EndScope() {
+    if (!enabled || frames[frame].open.empty())
+        return;
+    FrameQueries& queries = frames[frame];
+    unsigned int index = queries.open.back();
+    queries.open.pop_back();
+    if (index == GPU_PROFILER_DROPPED)
+        return;
+    if (queries.scopes[index].statistics) {
+        glEndQuery(GL_VERTICES_SUBMITTED_ARB);
+        glEndQuery(GL_PRIMITIVES_SUBMITTED_ARB);
+        glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+    }
+    queries.lastQuery = queries.timestamps[2 * index + 1];
+    glQueryCounter(queries.lastQuery, GL_TIMESTAMP);
+}
+
+void GpuProfiler::EndFrame() {
+    if (!enabled)
+        return;
+    FrameQueries& queries = frames[frame];
+    while (!queries.open.empty())
+        EndScope();
+    queries.pending = !queries.scopes.empty();
+    frame = (frame + 1) % GPU_PROFILER_FRAMES;
+}
+
+unsigned int GpuProfiler::findHistory(const char* name, unsigned int depth) {
+    for (unsigned int i = 0; i < histories.size(); ++i) {
+        if (histories[i].depth == depth && histories[i].name == name)
+            return i;
+    }
+    ScopeHistory history;
+    history.name = name;
+    history.depth = depth;
+    history.calls.assign(GPU_PROFILER_WINDOW, 0.0f);
+    history.ms.assign(GPU_PROFILER_WINDOW, 0.0f);
+    history.vertices.assign(GPU_PROFILER_WINDOW, 0.0f);
+    history.primitives.assign(GPU_PROFILER_WINDOW, 0.0f);
+    history.fragments.assign(GPU_PROFILER_WINDOW, 0.0f);
+    histories.push_back(history);
+    return (unsigned int)histories.size() - 1;
+}
+
+bool GpuProfiler::collect(FrameQueries& queries) {
+    GLint available = 0;
+    glGetQueryObjectiv(queries.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+
+    for (ScopeHistory& history : histories) {
+        history.calls[sample] = 0.0f;
+        history.ms[sample] = 0.0f;
+        history.vertices[sample] = 0.0f;
+        history.primitives[sample] = 0.0f;
+        history.fragments[sample] = 0.0f;
+    }
+    GLuint64 frameBegin = ~(GLuint64)0, frameEnd = 0;
+    unsigned int statistics = 0;
+    for (unsigned int i = 0; i < queries.scopes.size(); ++i) {
+        const Scope& scope = queries.scopes[i];
+        ScopeHistory& history = histories[findHistory(scope.name, scope.depth)];
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(queries.timestamps[2 * i], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(queries.timestamps[2 * i + 1], GL_QUERY_RESULT, &end);
+        frameBegin = std::min(frameBegin, begin);
+        frameEnd = std::max(frameEnd, end);
+        history.calls[sample] += 1.0f;
+        history.ms[sample] += (float)((end - begin) * 1e-6);
+        if (scope.statistics) {
+            GLuint64 counts[3] = { 0, 0, 0 };
+            for (unsigned int counter = 0; counter < 3; ++counter)
+                glGetQueryObjectui64v(queries.statistics[3 * statistics + counter], GL_QUERY_RESULT, &counts[counter]);
+            ++statistics;
+            history.vertices[sample] += (float)counts[0];
+            history.primitives[sample] += (float)counts[1];
+            history.fragments[sample] += (float)counts[2];
+        }
+    }
+    frameMs[sample] = frameEnd > frameBegin ? (float)((frameEnd - frameBegin) * 1e-6) : 0.0f;
+    sample = (sample + 1) % GPU_PROFILER_WINDOW;
+    samples = std::min(samples + 1, (unsigned int)GPU_PROFILER_WINDOW);
+    return true;
+}
+
+std::vector<GpuScopeTiming> GpuProfiler::GetTimings() const {
+    std::vector<GpuScopeTiming> timings;
+    for (const ScopeHistory& history : histories) {
+        GpuScopeTiming timing;
+        timing.name = history.name;
+        timing.depth = history.depth;
+        timing.calls = 0.0f;
+        timing.averageMs = 0.0f;
+        timing.minMs = 0.0f;
+        timing.maxMs = 0.0f;
+        timing.vertices = 0.0;
+        timing.primitives = 0.0;
+        timing.fragments = 0.0;
+        bool seen = false;
+        for (unsigned int i = 0; i < samples; ++i) {
+            timing.calls += history.calls[i];
+            timing.averageMs += history.ms[i];
+            timing.vertices += history.vertices[i];
+            timing.primitives += history.primitives[i];
+            timing.fragments += history.fragments[i];
+            if (history.calls[i] > 0.0f) {
+                timing.minMs = seen ? std::min(timing.minMs, history.ms[i]) : history.ms[i];
+                timing.maxMs = std::max(timing.maxMs, history.ms[i]);
+                seen = true;
+            }
+        }
+        if (samples > 0) {
+            timing.calls /= samples;
+            timing.averageMs /= samples;
+            timing.vertices /= samples;
+            timing.primitives /= samples;
+            timing.fragments /= samples;
+        }
+        timings.push_back(timing);
+    }
+    return timings;
+}
+
+float GpuProfiler::GetAverageFrameMs() const {
+    float total = 0.0f;
+    for (unsigned int i = 0; i < samples; ++i)
+        total += frameMs[i];
+    return samples > 0 ? total / samples : 0.0f;
+}
+
+void GpuProfiler::PrintReport() const {
+    if (!enabled)
+        return;
+    std::cout << "GPU profile, averaged over " << samples << " frames (" << droppedFrames << " dropped waiting for results)" << std::endl;
+    std::cout << "  frame: " << GetAverageFrameMs() << " ms" << std::endl;
+    for (const GpuScopeTiming& timing : GetTimings()) {
+        std::cout << "  " << std::string(timing.depth * 2, ' ') << timing.name << ": " << timing.averageMs << " ms (min " << timing.minMs
+            << ", max " << timing.maxMs << ", " << timing.calls << " per frame)";
+        if (pipelineStatistics && timing.depth == 0)
+            std::cout << ", " << timing.vertices << " vertices, " << timing.primitives << " primitives, " << timing.fragments << " fragments";
+        std::cout << std::endl;
+    }
+}
+
+bool GpuProfiler::WriteReport(const char* filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to write the GPU profile: " << filename << std::endl;
+        return false;
+    }
+    file << "scope,depth,calls,avg_ms,min_ms,max_ms,vertices,primitives,fragments\n";
+    file << "frame,0,1," << GetAverageFrameMs() << ",,,,,\n";
+    for (const GpuScopeTiming& timing : GetTimings()) {
+        file << timing.name << "," << timing.depth << "," << timing.calls << "," << timing.averageMs << "," << timing.minMs << "," << timing.maxMs << ",";
+        if (pipelineStatistics && timing.depth == 0)
+            file << timing.vertices << "," << timing.primitives << "," << timing.fragments;
+        else
+            file << ",,";
+        file << "\n";
+    }
+    return file.good();
+}
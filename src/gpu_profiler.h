@@ -0,0 +1,84 @@
+#ifndef GPU_PROFILER
+#define GPU_PROFILER
+
+#include <vector>
+#include <string>
+
+#define GPU_PROFILER_FRAMES 4 // frames of queries in flight, each frame's results are read this many frames later
+#define GPU_PROFILER_MAX_SCOPES 256 // per frame, scopes past this are dropped
+#define GPU_PROFILER_WINDOW 120 // frames the averages cover
+
+// One named pass or draw scope averaged over the window, scopes sharing a name in a frame are summed
+typedef struct GpuScopeTiming {
+    std::string name;
+    unsigned int depth; // 0 for passes, 1 for scopes directly inside one and so on
+    float calls; // scopes with the name per frame
+    float averageMs, minMs, maxMs; // per frame, min and max over the frames it appeared in
+    double vertices, primitives, fragments; // per frame, passes only and only with pipeline statistics
+}GpuScopeTiming;
+
+// GPU time per render pass (and optionally per draw) from GL_TIMESTAMP queries written at each scope's begin and end,
+// timestamps rather than GL_TIME_ELAPSED since only one of those can be active and scopes nest. Every frame gets its
+// own pool of query objects and is read back GPU_PROFILER_FRAMES later, a frame whose results still aren't there is
+// dropped rather than waited for. Where GL 4.6 or ARB_pipeline_statistics_query is available the passes (the
+// outermost scopes) also count submitted vertices, primitives and fragment shader invocations.
+// A disabled profiler makes no queries and every call returns straight away, so the passes can be wrapped
+// unconditionally.
+class GpuProfiler {
+public:
+	GpuProfiler(bool enabled);
+	~GpuProfiler();
+
+	static bool IsSupported(); // GL 3.3 or ARB_timer_query
+
+	void BeginFrame(); // collects the oldest frame's results if they are ready
+	void BeginScope(const char* name); // the name is kept by pointer, pass a literal
+	void EndScope();
+	void EndFrame();
+
+	bool IsEnabled() const { return enabled; }
+	bool HasPipelineStatistics() const { return pipelineStatistics; }
+	std::vector<GpuScopeTiming> GetTimings() const; // in the order the scopes were first seen
+	float GetAverageFrameMs() const; // first scope's begin to last scope's end
+	unsigned int GetDroppedFrames() const { return droppedFrames; }
+	void PrintReport() const;
+	bool WriteReport(const char* filename) const; // csv, one row per scope plus the frame total
+
+private:
+	typedef struct Scope {
+		const char* name;
+		unsigned int depth;
+		bool statistics; // has pipeline statistics queries
+	}Scope;
+
+	typedef struct FrameQueries {
+		std::vector<unsigned int> timestamps; // begin and end of each scope
+		std::vector<unsigned int> statistics; // vertices, primitives and fragments of each pass
+		std::vector<Scope> scopes;
+		std::vector<unsigned int> open; // scopes begun and not yet ended
+		unsigned int statisticsUsed;
+		unsigned int lastQuery; // the frame's last timestamp, its results are ready once this one's are
+		bool pending;
+	}FrameQueries;
+
+	typedef struct ScopeHistory {
+		std::string name;
+		unsigned int depth;
+		std::vector<float> calls, ms, vertices, primitives, fragments; // GPU_PROFILER_WINDOW each, one per collected frame
+	}ScopeHistory;
+
+	bool collect(FrameQueries& queries); // false if the results weren't ready
+	unsigned int findHistory(const char* name, unsigned int depth);
+
+	bool enabled;
+	bool pipelineStatistics;
+	FrameQueries frames[GPU_PROFILER_FRAMES];
+	unsigned int frame; // slot being recorded
+	std::vector<ScopeHistory> histories;
+	std::vector<float> frameMs;
+	unsigned int sample; // next window position
+	unsigned int samples; // filled window positions
+	unsigned int droppedFrames;
+};
+
+#endif // !GPU_PROFILER
@@ -0,0 +1,226 @@
+#include <GL/glew.h>
+#include <algorithm>
+#include "hiz_culling.h"
+#include "camera_uniforms.h"
+#include "gl_state.h"
+
+//HI-Z PYRAMID COMPUTE SHADER, each texel keeps the farthest depth of the source texels it covers
+const char* hizPyramidComputeShaderSource = "#version 430 core\n"
+"layout (local_size_x = 8, local_size_y = 8) in;\n"
+"layout (binding = 0) uniform sampler2D source;\n"
+"layout (r32f, binding = 0) uniform writeonly image2D destination;\n"
+"uniform int sourceLevel;\n"
+"uniform ivec2 sourceSize;\n"
+"uniform ivec2 destinationSize;\n"
+"void main()\n"
+"{\n"
+"   ivec2 texel = ivec2(gl_GlobalInvocationID.xy);\n"
+"   if (any(greaterThanEqual(texel, destinationSize)))\n"
+"      return;\n"
+"   // odd sized sources fold their last row/column into the last destination texel\n"
+"   ivec2 start = texel * 2;\n"
+"   ivec2 end = min(start + 1 + ivec2(equal(texel, destinationSize - 1)) * (sourceSize & 1), sourceSize - 1);\n"
+"   float farthest = 0.0;\n"
+"   for (int y = start.y; y <= end.y; ++y)\n"
+"      for (int x = start.x; x <= end.x; ++x)\n"
+"         farthest = max(farthest, texelFetch(source, ivec2(x, y), sourceLevel).r);\n"
+"   imageStore(destination, texel, vec4(farthest));\n"
+"}\0";
+
+//HI-Z CULL COMPUTE SHADER
+const char* hizCullComputeShaderSource = "#version 430 core\n"
+"layout (local_size_x = 64) in;\n"
+CAMERA_UNIFORM_BLOCK_GLSL
+"struct DrawCommand { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };\n"
+"layout (std430, binding = 0) readonly buffer InstanceBounds { vec4 bounds[]; }; // center, extent pairs\n"
+"layout (std430, binding = 1) readonly buffer InstanceData { vec4 instances[]; };\n"
+"layout (std430, binding = 2) writeonly buffer CulledInstances { vec4 culled[]; };\n"
+"layout (std430, binding = 3) buffer DrawCommands { DrawCommand commands[2]; };\n"
+"layout (std430, binding = 4) buffer Rejected { uint rejected[]; };\n"
+"layout (binding = 0) uniform sampler2D hiz;\n"
+"uniform int phase;\n"
+"uniform uint instanceCount;\n"
+"uniform int hizMaxLevel;\n"
+"bool isVisible(vec3 center, vec3 extent)\n"
+"{\n"
+"   vec3 minNdc = vec3(1e30);\n"
+"   vec3 maxNdc = vec3(-1e30);\n"
+"   for (int i = 0; i < 8; ++i) {\n"
+"      vec3 corner = center + extent * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);\n"
+"      vec4 clip = viewProjection * vec4(corner, 1.0);\n"
+"      if (clip.w <= 1e-4)\n"
+"         return true; // reaches behind the camera\n"
+"      vec3 ndc = clip.xyz / clip.w;\n"
+"      minNdc = min(minNdc, ndc);\n"
+"      maxNdc = max(maxNdc, ndc);\n"
+"   }\n"
+"   if (maxNdc.x < -1.0 || minNdc.x > 1.0 || maxNdc.y < -1.0 || minNdc.y > 1.0 || minNdc.z > 1.0)\n"
+"      return false; // outside the frustum\n"
+"   // pick the level where the box covers about two texels, widened by one texel either side to stay conservative\n"
+"   vec2 uvMin = clamp(minNdc.xy * 0.5 + 0.5, 0.0, 1.0);\n"
+"   vec2 uvMax = clamp(maxNdc.xy * 0.5 + 0.5, 0.0, 1.0);\n"
+"   vec2 size = (uvMax - uvMin) * vec2(textureSize(hiz, 0));\n"
+"   int level = clamp(int(ceil(log2(max(max(size.x, size.y), 1.0)))), 0, hizMaxLevel);\n"
+"   ivec2 levelSize = textureSize(hiz, level);\n"
+"   ivec2 texelMin = clamp(ivec2(uvMin * vec2(levelSize)) - 1, ivec2(0), levelSize - 1);\n"
+"   ivec2 texelMax = clamp(ivec2(uvMax * vec2(levelSize)) + 1, ivec2(0), levelSize - 1);\n"
+"   float farthest = 0.0;\n"
+"   for (int y = texelMin.y; y <= texelMax.y; ++y)\n"
+"      for (int x = texelMin.x; x <= texelMax.x; ++x)\n"
+"         farthest = max(farthest, texelFetch(hiz, ivec2(x, y), level).r);\n"
+"   return minNdc.z * 0.5 + 0.5 <= farthest;\n"
+"}\n"
+"void main()\n"
+"{\n"
+"   uint i = gl_GlobalInvocationID.x;\n"
+"   if (i >= instanceCount)\n"
+"      return;\n"
+"   if (phase == 1 && rejected[i] == 0u)\n"
+"      return; // already drawn in phase 0\n"
+"   bool visible = isVisible(bounds[i * 2u].xyz, bounds[i * 2u + 1u].xyz);\n"
+"   if (phase == 0)\n"
+"      rejected[i] = visible ? 0u : 1u;\n"
+"   if (visible) {\n"
+"      uint slot = atomicAdd(commands[phase].instanceCount, 1u);\n"
+"      culled[commands[phase].baseInstance + slot] = instances[i];\n"
+"   }\n"
+"}\0";
+
+// matches DrawElementsIndirectCommand
+typedef struct DrawCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+}DrawCommand;
+
+HiZCuller::HiZCuller(int depthWidth, int depthHeight, unsigned int pyramidProgram, unsigned int cullProgram)
+    : depthWidth(depthWidth), depthHeight(depthHeight), pyramidShader(pyramidProgram), cullShader(cullProgram), instanceCount(0), indexCount(0) {
+    pyramidWidth = std::max(1, depthWidth / 2);
+    pyramidHeight = std::max(1, depthHeight / 2);
+    pyramidLevels = 1;
+    while ((pyramidWidth >> pyramidLevels) > 0 || (pyramidHeight >> pyramidLevels) > 0)
+        ++pyramidLevels;
+
+    glGenTextures(1, &pyramidTexture);
+    gl_bind_texture(GL_TEXTURE_2D, pyramidTexture);
+    glTexStorage2D(GL_TEXTURE_2D, pyramidLevels, GL_R32F, pyramidWidth, pyramidHeight);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // start at the far plane everywhere so the first frame's phase 0 culls nothing
+    std::vector<float> farPlane(static_cast<size_t>(pyramidWidth) * pyramidHeight, 1.0f);
+    for (int level = 0; level < pyramidLevels; ++level) {
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, std::max(1, pyramidWidth >> level), std::max(1, pyramidHeight >> level), GL_RED, GL_FLOAT, farPlane.data());
+    }
+    gl_bind_texture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(1, &boundsBuffer);
+    glGenBuffers(1, &instanceBuffer);
+    glGenBuffers(1, &culledBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &rejectedBuffer);
+
+    bind_camera_uniform_block(cullProgram);
+}
+
+HiZCuller::~HiZCuller() {
+    gl_delete_textures(1, &pyramidTexture);
+    gl_delete_buffers(1, &boundsBuffer);
+    gl_delete_buffers(1, &instanceBuffer);
+    gl_delete_buffers(1, &culledBuffer);
+    gl_delete_buffers(1, &commandBuffer);
+    gl_delete_buffers(1, &rejectedBuffer);
+}
+
+bool HiZCuller::IsSupported() {
+    return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_multi_draw_indirect && GLEW_ARB_texture_storage);
+}
+
+void HiZCuller::SetInstances(const std::vector<glm::vec4>& instanceData, const std::vector<glm::vec3>& centers, const std::vector<glm::vec3>& extents, unsigned int meshIndexCount) {
+    instanceCount = static_cast<unsigned int>(instanceData.size());
+    indexCount = meshIndexCount;
+
+    std::vector<glm::vec4> bounds;
+    for (unsigned int i = 0; i < instanceCount; ++i) {
+        bounds.push_back(glm::vec4(centers[i], 0.0f));
+        bounds.push_back(glm::vec4(extents[i], 0.0f));
+    }
+    gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(glm::vec4), bounds.data(), GL_STATIC_DRAW);
+    gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instanceData.size() * sizeof(glm::vec4), instanceData.data(), GL_STATIC_DRAW);
+    // room for both phases, phase 1 appends after the worst case of phase 0
+    gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, culledBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * instanceData.size() * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+    gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, rejectedBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instanceData.size() * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+    gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(DrawCommand), NULL, GL_DYNAMIC_DRAW);
+    gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void HiZCuller::CullPhase(int phase) {
+    if (instanceCount == 0)
+        return;
+
+    if (phase == 0) {
+        DrawCommand commands[2] = {
+            { indexCount, 0, 0, 0, 0 },
+            { indexCount, 0, 0, 0, instanceCount }
+        };
+        gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(commands), commands);
+        gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    cullShader.Use();
+    cullShader.SetInt("phase", phase);
+    cullShader.SetUInt("instanceCount", instanceCount);
+    cullShader.SetInt("hizMaxLevel", pyramidLevels - 1);
+    gl_active_texture(GL_TEXTURE0);
+    gl_bind_texture(GL_TEXTURE_2D, pyramidTexture);
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 0, boundsBuffer);
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 1, instanceBuffer);
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 2, culledBuffer);
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 3, commandBuffer);
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 4, rejectedBuffer);
+    glDispatchCompute((instanceCount + 63) / 64, 1, 1);
+
+    // the draw reads the counts as indirect arguments and the culled instances as vertex attributes
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void HiZCuller::BuildPyramid(unsigned int depthTexture) {
+    pyramidShader.Use();
+    gl_active_texture(GL_TEXTURE0);
+
+    int sourceWidth = depthWidth, sourceHeight = depthHeight;
+    for (int level = 0; level < pyramidLevels; ++level) {
+        int width = std::max(1, pyramidWidth >> level);
+        int height = std::max(1, pyramidHeight >> level);
+
+        // level 0 reduces the scene depth, every other level reduces the one above it
+        gl_bind_texture(GL_TEXTURE_2D, level == 0 ? depthTexture : pyramidTexture);
+        pyramidShader.SetInt("sourceLevel", level == 0 ? 0 : level - 1);
+        pyramidShader.SetIVec2("sourceSize", glm::ivec2(sourceWidth, sourceHeight));
+        pyramidShader.SetIVec2("destinationSize", glm::ivec2(width, height));
+        glBindImageTexture(0, pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        sourceWidth = width;
+        sourceHeight = height;
+    }
+    gl_bind_texture(GL_TEXTURE_2D, 0);
+}
+
+void HiZCuller::DrawPhase(int phase) {
+    if (instanceCount == 0)
+        return;
+    gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(phase * sizeof(DrawCommand)));
+    gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
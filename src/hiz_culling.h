@@ -0,0 +1,44 @@
+#ifndef HIZ_CULLING
+#define HIZ_CULLING
+
+#include <vector>
+#include <glm.hpp>
+#include "shader_program.h"
+
+// GPU driven two phase occlusion culling against a hierarchical Z pyramid (needs GL 4.3 compute shaders)
+//  phase 0: every instance is tested against the pyramid built from the previous frame's depth,
+//           survivors are appended to the culled instance buffer and counted into draw command 0
+//  BuildPyramid: a max depth mip chain is rebuilt from this frame's depth once the phase 0 draws are in it
+//  phase 1: only the instances phase 0 rejected are re-tested against the new pyramid, anything that turned out
+//           to be visible after all goes into draw command 1, so nothing pops in a frame late
+// Draw command i is drawn with glDrawElementsIndirect, the culled instances are meant to feed an instanced
+// vertex attribute (command 1 starts at baseInstance = instanceCount).
+class HiZCuller {
+public:
+	HiZCuller(int depthWidth, int depthHeight, unsigned int pyramidProgram, unsigned int cullProgram);
+	~HiZCuller();
+
+	static bool IsSupported(); // compute shaders, storage buffers and indirect draws
+
+	// static per instance data copied to the culled buffer when visible, and world bounds tested against the pyramid
+	void SetInstances(const std::vector<glm::vec4>& instanceData, const std::vector<glm::vec3>& centers, const std::vector<glm::vec3>& extents, unsigned int indexCount);
+	void CullPhase(int phase);
+	void BuildPyramid(unsigned int depthTexture);
+	void DrawPhase(int phase); // draws with whatever VAO and program are bound
+
+	unsigned int GetCulledInstanceBuffer() const { return culledBuffer; }
+
+private:
+	int pyramidWidth, pyramidHeight, pyramidLevels; // level 0 is half the depth buffer's resolution
+	int depthWidth, depthHeight;
+	unsigned int pyramidTexture;
+	ShaderProgram pyramidShader, cullShader;
+	unsigned int boundsBuffer, instanceBuffer, culledBuffer, commandBuffer, rejectedBuffer;
+	unsigned int instanceCount, indexCount;
+};
+
+// Compute shader sources, compile each into its own program
+extern const char* hizPyramidComputeShaderSource;
+extern const char* hizCullComputeShaderSource;
+
+#endif // !HIZ_CULLING
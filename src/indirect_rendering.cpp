@@ -0,0 +1,222 @@
+#include <GL/glew.h>
+#include <cstring>
+#include <algorithm>
+#include <gtc/type_ptr.hpp>
+#include "indirect_rendering.h"
+#include "camera_uniforms.h"
+#include "texture_library.h"
+#include "gl_state.h"
+
+//INDIRECT VERTEX SHADER
+const char* indirectVertexShaderSource = "#version 430 core\n"
+"#extension GL_ARB_shader_draw_parameters : require\n"
+"layout (location = 0) in vec3 aPos;\n"
+"layout (location = 2) in vec2 aTexCord;\n"
+"out vec2 TexCoord;\n"
+"flat out uint materialIndex;\n"
+CAMERA_UNIFORM_BLOCK_GLSL
+"layout (std430, binding = 0) readonly buffer DrawTransforms { mat4 models[]; };\n"
+"layout (std430, binding = 1) readonly buffer DrawMaterials { uint materials[]; };\n"
+"void main()\n"
+"{\n"
+"   gl_Position = viewProjection * models[gl_DrawIDARB] * vec4(aPos, 1.0);\n"
+"   TexCoord = aTexCord;\n"
+"   materialIndex = materials[gl_DrawIDARB];\n"
+"}\0";
+
+//INDIRECT FRAGMENT SHADER
+const char* indirectFragmentShaderSource = "#version 430 core\n"
+"out vec4 FragColor;\n"
+"in vec2 TexCoord;\n"
+"flat in uint materialIndex;\n"
+MATERIAL_SAMPLE_GLSL
+"void main()\n"
+"{\n"
+"   FragColor = sampleMaterial(materialIndex, TexCoord);\n"
+"}\n\0";
+
+//INDIRECT BINDLESS FRAGMENT SHADER, the material comes from gl_DrawID and neighbouring fragments can belong to
+//different draws of one multi draw, so the handle isn't dynamically uniform and GL_NV_gpu_shader5 has to allow that
+const char* indirectBindlessFragmentShaderSource = "#version 430 core\n"
+"#extension GL_ARB_bindless_texture : require\n"
+"#extension GL_NV_gpu_shader5 : require\n"
+"out vec4 FragColor;\n"
+"in vec2 TexCoord;\n"
+"flat in uint materialIndex;\n"
+MATERIAL_SAMPLE_BINDLESS_GLSL
+"void main()\n"
+"{\n"
+"   FragColor = sampleMaterial(materialIndex, TexCoord);\n"
+"}\n\0";
+
+//INDIRECT CULL COMPUTE SHADER, one invocation per draw
+const char* indirectCullComputeShaderSource = "#version 430 core\n"
+"layout (local_size_x = 64) in;\n"
+"struct DrawCommand { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };\n"
+"struct MeshInfo { uvec4 range; vec4 center; vec4 extent; }; // range = count, firstIndex, baseVertex\n"
+"layout (std430, binding = 0) readonly buffer DrawTransforms { mat4 models[]; };\n"
+"layout (std430, binding = 2) readonly buffer DrawMeshes { uint drawMeshes[]; };\n"
+"layout (std430, binding = 3) readonly buffer MeshInfos { MeshInfo meshes[]; };\n"
+"layout (std430, binding = 4) writeonly buffer DrawCommands { DrawCommand commands[]; };\n"
+"layout (std430, binding = 5) readonly buffer DrawOcclusion { uint occluded[]; };\n"
+"uniform uint drawCount;\n"
+"uniform vec4 frustumPlanes[6];\n"
+"void main()\n"
+"{\n"
+"   uint i = gl_GlobalInvocationID.x;\n"
+"   if (i >= drawCount)\n"
+"      return;\n"
+"   MeshInfo mesh = meshes[drawMeshes[i]];\n"
+"   mat4 model = models[i];\n"
+"   vec3 center = (model * vec4(mesh.center.xyz, 1.0)).xyz;\n"
+"   vec3 extent = mat3(abs(model[0].xyz), abs(model[1].xyz), abs(model[2].xyz)) * mesh.extent.xyz;\n"
+"   bool visible = occluded[i] == 0u;\n"
+"   for (int p = 0; p < 6; ++p) {\n"
+"      vec4 plane = frustumPlanes[p];\n"
+"      if (dot(plane.xyz, center) + plane.w < -dot(extent, abs(plane.xyz)))\n"
+"         visible = false;\n"
+"   }\n"
+"   commands[i].count = mesh.range.x;\n"
+"   commands[i].instanceCount = visible ? 1u : 0u;\n"
+"   commands[i].firstIndex = mesh.range.y;\n"
+"   commands[i].baseVertex = int(mesh.range.z);\n"
+"   commands[i].baseInstance = 0u;\n"
+"}\0";
+
+// matches DrawElementsIndirectCommand
+typedef struct IndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+}IndirectCommand;
+
+IndirectRenderer::IndirectRenderer(unsigned int cullProgram)
+    : cullShader(cullProgram), dirtyBegin(0), dirtyEnd(0), occludedBegin(0), occludedEnd(0), layoutDirty(true) {
+    glGenBuffers(1, &meshBuffer);
+    glGenBuffers(1, &transformBuffer);
+    glGenBuffers(1, &drawMeshBuffer);
+    glGenBuffers(1, &materialBuffer);
+    glGenBuffers(1, &occlusionBuffer);
+    glGenBuffers(1, &commandBuffer);
+}
+
+IndirectRenderer::~IndirectRenderer() {
+    gl_delete_buffers(1, &meshBuffer);
+    gl_delete_buffers(1, &transformBuffer);
+    gl_delete_buffers(1, &drawMeshBuffer);
+    gl_delete_buffers(1, &materialBuffer);
+    gl_delete_buffers(1, &occlusionBuffer);
+    gl_delete_buffers(1, &commandBuffer);
+}
+
+bool IndirectRenderer::IsSupported() {
+    return (GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_multi_draw_indirect))
+        && (GLEW_VERSION_4_6 || GLEW_ARB_shader_draw_parameters);
+}
+
+unsigned int IndirectRenderer::AddMesh(const MeshRange& range, const glm::vec3& localCenter, const glm::vec3& localExtent) {
+    // the range is stored as raw uint bits so the shader can read it as a uvec4
+    glm::vec4 packedRange;
+    unsigned int rangeBits[4] = { range.indexCount, range.firstIndex, (unsigned int)range.baseVertex, 0 };
+    std::memcpy(&packedRange, rangeBits, sizeof(packedRange));
+    meshInfos.push_back(packedRange);
+    meshInfos.push_back(glm::vec4(localCenter, 0.0f));
+    meshInfos.push_back(glm::vec4(localExtent, 0.0f));
+    layoutDirty = true;
+    return (unsigned int)(meshInfos.size() / 3 - 1);
+}
+
+unsigned int IndirectRenderer::AddDraw(unsigned int mesh, unsigned int material, const glm::mat4& model) {
+    models.push_back(model);
+    drawMeshes.push_back(mesh);
+    drawMaterials.push_back(std::min(material, (unsigned int)TEXTURE_LIBRARY_MAX_MATERIALS - 1));
+    drawOccluded.push_back(0);
+    layoutDirty = true;
+    return (unsigned int)(models.size() - 1);
+}
+
+void IndirectRenderer::SetTransform(unsigned int draw, const glm::mat4& model) {
+    models[draw] = model;
+    if (dirtyBegin == dirtyEnd) {
+        dirtyBegin = draw;
+        dirtyEnd = draw + 1;
+    }
+    else {
+        dirtyBegin = std::min(dirtyBegin, draw);
+        dirtyEnd = std::max(dirtyEnd, draw + 1);
+    }
+}
+
+void IndirectRenderer::SetOccluded(unsigned int draw, bool occluded) {
+    if (drawOccluded[draw] == (occluded ? 1u : 0u))
+        return;
+    drawOccluded[draw] = occluded ? 1 : 0;
+    if (occludedBegin == occludedEnd) {
+        occludedBegin = draw;
+        occludedEnd = draw + 1;
+    }
+    else {
+        occludedBegin = std::min(occludedBegin, draw);
+        occludedEnd = std::max(occludedEnd, draw + 1);
+    }
+}
+
+void IndirectRenderer::Upload() {
+    if (layoutDirty) {
+        gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, meshBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, meshInfos.size() * sizeof(glm::vec4), meshInfos.data(), GL_STATIC_DRAW);
+        gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, transformBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, models.size() * sizeof(glm::mat4), models.data(), GL_DYNAMIC_DRAW);
+        gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, drawMeshBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, drawMeshes.size() * sizeof(unsigned int), drawMeshes.data(), GL_STATIC_DRAW);
+        gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, drawMaterials.size() * sizeof(unsigned int), drawMaterials.data(), GL_STATIC_DRAW);
+        gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, occlusionBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, drawOccluded.size() * sizeof(unsigned int), drawOccluded.data(), GL_DYNAMIC_DRAW);
+        gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, models.size() * sizeof(IndirectCommand), NULL, GL_DYNAMIC_DRAW);
+        layoutDirty = false;
+    }
+    else {
+        if (dirtyBegin != dirtyEnd) {
+            gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, transformBuffer);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirtyBegin * sizeof(glm::mat4), (dirtyEnd - dirtyBegin) * sizeof(glm::mat4), &models[dirtyBegin]);
+        }
+        if (occludedBegin != occludedEnd) {
+            gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, occlusionBuffer);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, occludedBegin * sizeof(unsigned int), (occludedEnd - occludedBegin) * sizeof(unsigned int), &drawOccluded[occludedBegin]);
+        }
+    }
+    gl_bind_buffer(GL_SHADER_STORAGE_BUFFER, 0);
+    dirtyBegin = dirtyEnd = 0;
+    occludedBegin = occludedEnd = 0;
+}
+
+void IndirectRenderer::Cull(const Frustum& frustum) {
+    if (models.empty())
+        return;
+    Upload();
+
+    cullShader.Use();
+    cullShader.SetUInt("drawCount", (unsigned int)models.size());
+    cullShader.SetVec4Array("frustumPlanes", frustum.planes, 6);
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 0, transformBuffer);
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 2, drawMeshBuffer);
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 3, meshBuffer);
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 4, commandBuffer);
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 5, occlusionBuffer);
+    glDispatchCompute(((unsigned int)models.size() + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void IndirectRenderer::Draw() {
+    if (models.empty())
+        return;
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 0, transformBuffer);
+    gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 1, materialBuffer);
+    gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, (GLsizei)models.size(), 0);
+    gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
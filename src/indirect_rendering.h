@@ -0,0 +1,55 @@
+#ifndef INDIRECT_RENDERING
+#define INDIRECT_RENDERING
+
+#include <vector>
+#include <glm.hpp>
+#include "mesh_batch.h"
+#include "frustum_culling.h"
+#include "shader_program.h"
+
+// GPU driven submission of everything in one MeshBatch (needs GL 4.3 and ARB_shader_draw_parameters)
+// Every draw keeps a slot in the transform, material and command buffers, a compute pass frustum culls each draw,
+// drops the ones flagged as occluded by the CPU and writes its indirect command (instanceCount 0 when culled), then
+// the whole lot is one glMultiDrawElementsIndirect whose vertex shader finds its transform and material through gl_DrawID. The CPU cost per frame is a dispatch and
+// a draw call no matter how many objects there are, plus uploading the transforms that actually changed.
+class IndirectRenderer {
+public:
+	IndirectRenderer(unsigned int cullProgram);
+	~IndirectRenderer();
+
+	static bool IsSupported();
+
+	// local bounds of the mesh are used for culling every draw of it
+	unsigned int AddMesh(const MeshRange& range, const glm::vec3& localCenter, const glm::vec3& localExtent);
+	unsigned int AddDraw(unsigned int mesh, unsigned int material, const glm::mat4& model);
+	void SetTransform(unsigned int draw, const glm::mat4& model); // only the changed range is uploaded
+	void SetOccluded(unsigned int draw, bool occluded); // from CPU occlusion culling, the flag sticks until set again
+
+	void Cull(const Frustum& frustum); // uploads pending changes then writes this frame's commands
+	void Draw(); // with the draw program, the batch's VAO and the material textures bound
+
+	unsigned int GetDrawCount() const { return (unsigned int)models.size(); }
+
+private:
+	void Upload();
+
+	ShaderProgram cullShader;
+	std::vector<glm::vec4> meshInfos; // per mesh: (count, firstIndex, baseVertex, 0) as uint bits, center, extent
+	std::vector<glm::mat4> models;
+	std::vector<unsigned int> drawMeshes, drawMaterials, drawOccluded;
+	unsigned int dirtyBegin, dirtyEnd; // transforms waiting to be uploaded
+	unsigned int occludedBegin, occludedEnd; // occlusion flags waiting to be uploaded
+	bool layoutDirty; // draws or meshes were added, every buffer has to be rebuilt
+	unsigned int meshBuffer, transformBuffer, drawMeshBuffer, materialBuffer, occlusionBuffer, commandBuffer;
+};
+
+// Draw program sources, the vertex shader reads transforms and materials by gl_DrawID, materials are sampled from
+// the texture library's arrays, bound to units, or through bindless handles where GL_NV_gpu_shader5 allows a
+// handle that differs between the draws of one multi draw
+extern const char* indirectVertexShaderSource;
+extern const char* indirectFragmentShaderSource;
+extern const char* indirectBindlessFragmentShaderSource;
+// Cull compute program source
+extern const char* indirectCullComputeShaderSource;
+
+#endif // !INDIRECT_RENDERING
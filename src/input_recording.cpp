@@ -0,0 +1,159 @@
+#include "input_recording.h"
+
+#include <fstream>
+#include <iostream>
+#include "camera.h"
+
+static const unsigned int INPUT_LOG_MAGIC = 0x31504E49; // "INP1"
+
+// Every key the camera or simulation polls, bit i of InputFrame::keys is recordedKeys[i]
+static const int recordedKeys[] = {
+    GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, // camera
+    GLFW_KEY_KP_8, GLFW_KEY_KP_5, GLFW_KEY_KP_6, GLFW_KEY_KP_4, GLFW_KEY_KP_ADD, GLFW_KEY_KP_SUBTRACT, // cube
+    GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_RIGHT, GLFW_KEY_LEFT, // diamond
+    GLFW_KEY_I, GLFW_KEY_K, GLFW_KEY_L, GLFW_KEY_J // sphere
+};
+static const unsigned int recordedKeyCount = sizeof(recordedKeys) / sizeof(recordedKeys[0]);
+
+static unsigned int poll_recorded_keys(GLFWwindow* window) {
+    unsigned int keys = 0;
+    for (unsigned int i = 0; i < recordedKeyCount; ++i) {
+        if (glfwGetKey(window, recordedKeys[i]) == GLFW_PRESS)
+            keys |= 1u << i;
+    }
+    return keys;
+}
+
+bool create_input_recorder(InputRecorder& recorder, InputMode mode, const char* logPath) {
+    recorder.mode = mode;
+    recorder.logPath = logPath ? logPath : "";
+    recorder.frames.clear();
+    recorder.replayPosition = 0;
+
+    if (mode == INPUT_REPLAY && !load_input_log(recorder.frames, logPath)) {
+        std::cout << "Failed to load input log: " << recorder.logPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool next_input_frame(InputRecorder& recorder, GLFWwindow* window, float deltaTime, float mouseX, float mouseY, InputFrame& outFrame) {
+    switch (recorder.mode) {
+    case INPUT_REPLAY:
+        if (recorder.replayPosition >= recorder.frames.size())
+            return false;
+        outFrame = recorder.frames[recorder.replayPosition++];
+        return true;
+    case INPUT_FLYTHROUGH:
+        outFrame.deltaTime = INPUT_FLYTHROUGH_DELTA_TIME;
+        outFrame.keys = 0;
+        outFrame.mouseX = 0.0f;
+        outFrame.mouseY = 0.0f;
+        return true;
+    default:
+        outFrame.deltaTime = deltaTime;
+        outFrame.keys = poll_recorded_keys(window);
+        outFrame.mouseX = mouseX;
+        outFrame.mouseY = mouseY;
+        if (recorder.mode == INPUT_RECORD)
+            recorder.frames.push_back(outFrame);
+        return true;
+    }
+}
+
+bool finish_input_recorder(InputRecorder& recorder) {
+    if (recorder.mode != INPUT_RECORD)
+        return true;
+    return save_input_log(recorder.frames, recorder.logPath.c_str());
+}
+
+bool input_key_down(const InputFrame& frame, int glfwKey) {
+    for (unsigned int i = 0; i < recordedKeyCount; ++i) {
+        if (recordedKeys[i] == glfwKey)
+            return (frame.keys & (1u << i)) != 0;
+    }
+    return false;
+}
+
+unsigned int input_camera_directions(const InputFrame& frame) {
+    unsigned int directions = 0;
+    if (input_key_down(frame, GLFW_KEY_W))
+        directions |= CAMERA_FORWARD;
+    if (input_key_down(frame, GLFW_KEY_S))
+        directions |= CAMERA_BACKWARD;
+    if (input_key_down(frame, GLFW_KEY_A))
+        directions |= CAMERA_LEFT;
+    if (input_key_down(frame, GLFW_KEY_D))
+        directions |= CAMERA_RIGHT;
+    return directions;
+}
+
+// Log layout: magic, frame count, then per frame delta time, key bits, mouse x, mouse y (16 bytes)
+bool save_input_log(const std::vector<InputFrame>& frames, const char* filename) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to save input log: " << filename << std::endl;
+        return false;
+    }
+
+    unsigned int header[2] = { INPUT_LOG_MAGIC, static_cast<unsigned int>(frames.size()) };
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const InputFrame& frame : frames) {
+        file.write(reinterpret_cast<const char*>(&frame.deltaTime), sizeof(float));
+        file.write(reinterpret_cast<const char*>(&frame.keys), sizeof(unsigned int));
+        file.write(reinterpret_cast<const char*>(&frame.mouseX), sizeof(float));
+        file.write(reinterpret_cast<const char*>(&frame.mouseY), sizeof(float));
+    }
+    return file.good();
+}
+
+bool load_input_log(std::vector<InputFrame>& frames, const char* filename) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+    unsigned long long fileSize = (unsigned long long)file.tellg();
+    file.seekg(0);
+
+    unsigned int header[2] = {};
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file.good() || header[0] != INPUT_LOG_MAGIC)
+        return false;
+    // a truncated or corrupt log can't claim more frames than the file holds
+    const unsigned long long frameSize = sizeof(float) * 3 + sizeof(unsigned int);
+    if ((unsigned long long)header[1] * frameSize > fileSize - sizeof(header))
+        return false;
+
+    frames.resize(header[1]);
+    for (InputFrame& frame : frames) {
+        file.read(reinterpret_cast<char*>(&frame.deltaTime), sizeof(float));
+        file.read(reinterpret_cast<char*>(&frame.keys), sizeof(unsigned int));
+        file.read(reinterpret_cast<char*>(&frame.mouseX), sizeof(float));
+        file.read(reinterpret_cast<char*>(&frame.mouseY), sizeof(float));
+    }
+    return file.good();
+}
+
+bool write_frame_time_log(const FrameTimeLog& log, const char* filename) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to write frame times: " << filename << std::endl;
+        return false;
+    }
+
+    file << "frame,delta_time,frame_ms,state_changes_saved,gl_calls_issued,gl_calls_filtered,latency_ms\n";
+    for (size_t i = 0; i < log.frameTimes.size(); ++i) {
+        file << i << "," << log.deltaTimes[i] << "," << log.frameTimes[i] * 1000.0f << ",";
+        if (i < log.stateChangesSaved.size()) // the last frame can end before anything was drawn
+            file << log.stateChangesSaved[i];
+        file << ",";
+        if (i < log.glCallsIssued.size())
+            file << log.glCallsIssued[i] << "," << log.glCallsFiltered[i];
+        else
+            file << ",";
+        file << ",";
+        if (i < log.latencies.size() && log.latencies[i] >= 0.0f)
+            file << log.latencies[i];
+        file << "\n";
+    }
+    return file.good();
+}
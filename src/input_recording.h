@@ -0,0 +1,56 @@
+#ifndef INPUT_RECORDING
+#define INPUT_RECORDING
+
+#include <vector>
+#include <string>
+#include <GLFW/glfw3.h> // for keyboard input
+
+// Where each frame's input comes from
+enum InputMode {
+    INPUT_LIVE, // poll the keyboard and mouse
+    INPUT_RECORD, // poll, and keep every frame so it can be written to a log on exit
+    INPUT_REPLAY, // feed back a recorded log, ignoring the real keyboard and mouse
+    INPUT_FLYTHROUGH // no input, fixed frame time, the camera follows a scripted spline
+};
+
+// Everything the camera and simulation consume in one frame
+typedef struct InputFrame {
+    float deltaTime; // seconds
+    unsigned int keys; // one bit per entry of the recorded key table
+    float mouseX, mouseY; // mouse movement accumulated since the last frame
+}InputFrame;
+
+typedef struct InputRecorder {
+    InputMode mode;
+    std::string logPath;
+    std::vector<InputFrame> frames;
+    size_t replayPosition;
+}InputRecorder;
+
+// Measured wall clock frame times, written out so runs of different builds can be compared frame for frame
+typedef struct FrameTimeLog {
+    std::vector<float> deltaTimes; // what the simulation was fed
+    std::vector<float> frameTimes; // what the frame actually took
+    std::vector<unsigned int> stateChangesSaved; // binds the render queue skipped
+    std::vector<unsigned int> glCallsIssued; // binds and state changes that reached the driver
+    std::vector<unsigned int> glCallsFiltered; // ones the state cache dropped as redundant
+    std::vector<float> latencies; // estimated input to photon ms by frame, -1 (or missing at the end) while the GPU hadn't finished it
+}FrameTimeLog;
+
+#define INPUT_FLYTHROUGH_DELTA_TIME (1.0f / 60.0f)
+
+// Loads the log up front when replaying, returns false if it couldn't be read
+bool create_input_recorder(InputRecorder& recorder, InputMode mode, const char* logPath);
+// Fills outFrame for this frame, returns false once a replay has run out of frames
+bool next_input_frame(InputRecorder& recorder, GLFWwindow* window, float deltaTime, float mouseX, float mouseY, InputFrame& outFrame);
+// Writes the log when recording
+bool finish_input_recorder(InputRecorder& recorder);
+
+bool input_key_down(const InputFrame& frame, int glfwKey); // only keys in the recorded key table are ever down
+unsigned int input_camera_directions(const InputFrame& frame); // Camera_Movement flags
+
+bool save_input_log(const std::vector<InputFrame>& frames, const char* filename);
+bool load_input_log(std::vector<InputFrame>& frames, const char* filename);
+bool write_frame_time_log(const FrameTimeLog& log, const char* filename); // csv: frame, delta time, frame time in ms, state changes saved, gl calls issued/filtered, latency in ms
+
+#endif // !INPUT_RECORDING
@@ -0,0 +1,69 @@
+#include <GL/glew.h>
+#include "instancing.h"
+#include "camera_uniforms.h"
+#include "gl_state.h"
+
+//INSTANCED VERTEX SHADER
+const char* instancedVertexShaderSource = "#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"layout (location = 2) in vec2 aTexCord;\n"
+"layout (location = 4) in mat4 instanceModel; // locations 4-7\n"
+"out vec2 TexCoord;\n"
+CAMERA_UNIFORM_BLOCK_GLSL
+"void main()\n"
+"{\n"
+"   gl_Position = viewProjection * instanceModel * vec4(aPos, 1.0);\n"
+"   TexCoord = aTexCord;\n"
+"}\0";
+
+InstanceBuffer create_instance_buffer(unsigned int capacity) {
+    InstanceBuffer instances;
+    instances.capacity = capacity;
+    instances.count = 0;
+    glGenBuffers(1, &instances.vbo);
+    gl_bind_buffer(GL_ARRAY_BUFFER, instances.vbo);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+    gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+    return instances;
+}
+
+void attach_instance_buffer(const InstanceBuffer& instances) {
+    attach_instance_range(instances.vbo, 0);
+}
+
+void attach_instance_range(unsigned int buffer, unsigned int offset) {
+    gl_bind_buffer(GL_ARRAY_BUFFER, buffer);
+    // a mat4 attribute is four vec4 columns, each advancing once per instance
+    for (unsigned int column = 0; column < 4; ++column) {
+        glVertexAttribPointer(INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(size_t)(offset + column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+        glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + column, 1);
+    }
+    gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+}
+
+void upload_instances(InstanceBuffer& instances, const glm::mat4* models, unsigned int count) {
+    gl_bind_buffer(GL_ARRAY_BUFFER, instances.vbo);
+    if (count > instances.capacity) {
+        instances.capacity = count;
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), models, GL_DYNAMIC_DRAW);
+    }
+    else {
+        // orphan the old storage so a frame still drawing from it doesn't stall the upload
+        glBufferData(GL_ARRAY_BUFFER, instances.capacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), models);
+    }
+    gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+    instances.count = count;
+}
+
+void draw_mesh_instanced(const MeshRange& range, unsigned int instanceCount) {
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void*)(range.firstIndex * sizeof(unsigned int)), instanceCount, range.baseVertex);
+}
+
+void delete_instance_buffer(InstanceBuffer& instances) {
+    gl_delete_buffers(1, &instances.vbo);
+    instances.vbo = 0;
+    instances.capacity = 0;
+    instances.count = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef INSTANCING
+#define INSTANCING
+
+#include <glm.hpp>
+#include "mesh_batch.h"
+
+#define INSTANCE_MODEL_LOCATION 4 // the per instance model matrix takes this and the next three attribute locations
+
+// Per instance model matrices for drawing many copies of a mesh in one call
+typedef struct InstanceBuffer {
+    unsigned int vbo;
+    unsigned int capacity; // in instances
+    unsigned int count;
+}InstanceBuffer;
+
+InstanceBuffer create_instance_buffer(unsigned int capacity);
+// Points the instance attributes of the bound VAO (which already has the mesh's vertex layout) at the buffer
+void attach_instance_buffer(const InstanceBuffer& instances);
+// Same for model matrices written anywhere else (a stream buffer), starting offset bytes into buffer
+void attach_instance_range(unsigned int buffer, unsigned int offset);
+// Replaces the contents, growing the buffer when needed, attached VAOs keep working since the name doesn't change
+void upload_instances(InstanceBuffer& instances, const glm::mat4* models, unsigned int count);
+void draw_mesh_instanced(const MeshRange& range, unsigned int instanceCount); // with the instanced VAO bound
+void delete_instance_buffer(InstanceBuffer& instances);
+
+// Vertex shader reading the model matrix from the instance attributes, pairs with the scene's fragment shader
+extern const char* instancedVertexShaderSource;
+
+#endif // !INSTANCING
@@ -0,0 +1,125 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+// which system and deque the running thread belongs to, workers set these once when they start
+static thread_local const JobSystem* workerSystem = NULL;
+static thread_local unsigned int workerQueue = 0;
+
+JobSystem::JobSystem(unsigned int threadCount) : queuedJobs(0), sleepingWorkers(0), shuttingDown(false) {
+    threadCount = std::max(1u, threadCount);
+    for (unsigned int queue = 0; queue < threadCount; ++queue)
+        queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+    for (unsigned int queue = 1; queue < threadCount; ++queue)
+        workers.push_back(std::thread(&JobSystem::workerLoop, this, queue));
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        shuttingDown = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+unsigned int JobSystem::currentQueue() const {
+    return workerSystem == this ? workerQueue : 0;
+}
+
+void JobSystem::Run(Job job, JobCounter& counter) {
+    counter.fetch_add(1);
+    JobQueue& queue = *queues[currentQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(QueuedJob{ std::move(job), &counter });
+    }
+    queuedJobs.fetch_add(1);
+
+    // a worker that saw no jobs either sees this one before it sleeps or is already waiting on wake, taking the
+    // mutex here makes sure it can't be in between
+    if (sleepingWorkers.load() > 0) {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_one();
+    }
+}
+
+bool JobSystem::takeJob(unsigned int queue, QueuedJob& outJob) {
+    if (queuedJobs.load() == 0)
+        return false;
+    {
+        JobQueue& own = *queues[queue];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            outJob = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            queuedJobs.fetch_sub(1);
+            return true;
+        }
+    }
+    // steal the oldest job of the next deque that has one, starting after our own so thieves spread out
+    unsigned int count = (unsigned int)queues.size();
+    for (unsigned int offset = 1; offset < count; ++offset) {
+        JobQueue& victim = *queues[(queue + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            outJob = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            queuedJobs.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::runJob(QueuedJob& job) {
+    job.job();
+    job.counter->fetch_sub(1);
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+    unsigned int queue = currentQueue();
+    QueuedJob job;
+    while (counter.load() > 0) {
+        if (takeJob(queue, job))
+            runJob(job);
+        else
+            std::this_thread::yield(); // the last jobs are running on other threads
+    }
+}
+
+void JobSystem::ParallelFor(unsigned int count, unsigned int grainSize, const std::function<void(unsigned int begin, unsigned int end)>& body) {
+    grainSize = std::max(1u, grainSize);
+    if (count <= grainSize) {
+        if (count)
+            body(0, count);
+        return;
+    }
+    JobCounter counter(0);
+    // the first piece is kept for the calling thread, it would only be waiting otherwise
+    for (unsigned int begin = grainSize; begin < count; begin += grainSize) {
+        unsigned int end = std::min(begin + grainSize, count);
+        Run([&body, begin, end]() { body(begin, end); }, counter);
+    }
+    body(0, grainSize);
+    Wait(counter);
+}
+
+void JobSystem::workerLoop(unsigned int queue) {
+    workerSystem = this;
+    workerQueue = queue;
+    QueuedJob job;
+    while (true) {
+        if (takeJob(queue, job)) {
+            runJob(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1);
+        wake.wait(lock, [this] { return shuttingDown || queuedJobs.load() > 0; });
+        sleepingWorkers.fetch_sub(1);
+        if (shuttingDown)
+            return;
+    }
+}
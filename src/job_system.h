@@ -0,0 +1,57 @@
+#ifndef JOB_SYSTEM
+#define JOB_SYSTEM
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+typedef std::function<void()> Job;
+typedef std::atomic<unsigned int> JobCounter; // jobs still to finish, Run adds one and each finished job takes one off
+
+// Work stealing job system for per frame CPU work
+// Every thread owns a deque, a thread pushes and pops its own jobs at the back (newest first, still warm in cache)
+// and steals from the front of the others' once it runs dry. Threads that aren't workers (the main thread) submit
+// into a shared deque and work on jobs too while they Wait, so nothing ever blocks on a job it could run itself.
+class JobSystem {
+public:
+	JobSystem(unsigned int threadCount); // counts the calling thread, threadCount - 1 workers are started
+	~JobSystem();
+
+	void Run(Job job, JobCounter& counter);
+	void Wait(JobCounter& counter); // runs jobs (any jobs) until the counter reaches zero
+	// body(begin, end) over [0, count) in pieces of grainSize, returns once all of them are done
+	void ParallelFor(unsigned int count, unsigned int grainSize, const std::function<void(unsigned int begin, unsigned int end)>& body);
+
+	unsigned int GetThreadCount() const { return (unsigned int)queues.size(); }
+
+private:
+	typedef struct QueuedJob {
+	    Job job;
+	    JobCounter* counter;
+	}QueuedJob;
+
+	typedef struct JobQueue {
+	    std::mutex mutex;
+	    std::deque<QueuedJob> jobs;
+	}JobQueue;
+
+	unsigned int currentQueue() const; // the calling thread's own deque, 0 for threads that aren't workers
+	bool takeJob(unsigned int queue, QueuedJob& outJob); // own deque first, then steal
+	void runJob(QueuedJob& job);
+	void workerLoop(unsigned int queue);
+
+	std::vector<std::unique_ptr<JobQueue>> queues; // [0] is shared by every thread that isn't a worker
+	std::vector<std::thread> workers;
+	std::atomic<unsigned int> queuedJobs; // in any deque, lets idle workers sleep instead of spinning
+	std::atomic<unsigned int> sleepingWorkers;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<bool> shuttingDown;
+};
+
+#endif // !JOB_SYSTEM
@@ -0,0 +1,17 @@
+#include <GL/glew.h>
+#include "mesh_batch.h"
+
+MeshRange append_mesh(MeshBatch& batch, const Mesh& mesh) {
+    MeshRange range;
+    range.firstIndex = (unsigned int)batch.indices.size();
+    range.indexCount = mesh.num_of_indices;
+    range.baseVertex = (int)(batch.vertices.size() / MESH_BATCH_FLOATS_PER_VERTEX);
+
+    batch.vertices.insert(batch.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+    batch.indices.insert(batch.indices.end(), mesh.indices.begin(), mesh.indices.begin() + mesh.num_of_indices);
+    return range;
+}
+
+void draw_mesh_range(const MeshRange& range) {
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void*)(range.firstIndex * sizeof(unsigned int)), range.baseVertex);
+}
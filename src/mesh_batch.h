@@ -0,0 +1,24 @@
+#ifndef MESH_BATCH
+#define MESH_BATCH
+
+#include "mesh.h"
+
+#define MESH_BATCH_FLOATS_PER_VERTEX 5 // position + texture coordinates, the layout setupVertexAttributes expects
+
+// Where a mesh lives inside a batch, indices stay relative to the mesh and baseVertex moves them to its vertices
+typedef struct MeshRange {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+}MeshRange;
+
+// Several meshes sharing one vertex layout packed back to back, uploaded as a single VBO/EBO pair behind one VAO
+typedef struct MeshBatch {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+}MeshBatch;
+
+MeshRange append_mesh(MeshBatch& batch, const Mesh& mesh);
+void draw_mesh_range(const MeshRange& range); // with the batch's VAO bound
+
+#endif // !MESH_BATCH
@@ -0,0 +1,107 @@
+#include "obj_loader.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <utility>
+#include <iostream>
+
+// Resolve an obj index (1 based, or negative for relative to the end of the list) into a 0 based index, -1 if it
+// doesn't name an element of the list (0 is not a valid obj index either)
+static int resolve_index(int index, size_t count) {
+    long long resolved = -1;
+    if (index > 0)
+        resolved = (long long)index - 1;
+    else if (index < 0)
+        resolved = (long long)count + index;
+    return resolved >= 0 && resolved < (long long)count ? static_cast<int>(resolved) : -1;
+}
+
+Mesh load_obj(const char* filename) {
+    Mesh mesh;
+    mesh.num_of_indices = 0;
+
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to load model: " << filename << std::endl;
+        return mesh;
+    }
+
+    std::vector<float> positions; // 3 floats per obj position
+    std::vector<float> texCoords; // 2 floats per obj texture coordinate
+    std::map<std::pair<int, int>, unsigned int> vertexLookup; // v/vt pair -> index into mesh vertices
+    unsigned int badCorners = 0; // malformed or out of range face corners, skipped
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string type;
+        stream >> type;
+
+        if (type == "v") {
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            stream >> x >> y >> z;
+            positions.push_back(x);
+            positions.push_back(y);
+            positions.push_back(z);
+        }
+        else if (type == "vt") {
+            float u = 0.0f, v = 0.0f;
+            stream >> u >> v;
+            texCoords.push_back(u);
+            texCoords.push_back(v);
+        }
+        else if (type == "f") {
+            // gather every corner of the polygon first, then fan triangulate it
+            std::vector<unsigned int> corners;
+            std::string corner;
+            while (stream >> corner) {
+                int v = 0, vt = 0;
+                size_t firstSlash = corner.find('/');
+                try {
+                    v = std::stoi(corner.substr(0, firstSlash));
+                    if (firstSlash != std::string::npos && firstSlash + 1 < corner.size() && corner[firstSlash + 1] != '/')
+                        vt = std::stoi(corner.substr(firstSlash + 1));
+                }
+                catch (const std::exception&) { // not a number, or too big for one
+                    ++badCorners;
+                    continue;
+                }
+
+                int positionIndex = resolve_index(v, positions.size() / 3);
+                int texCoordIndex = vt == 0 ? -1 : resolve_index(vt, texCoords.size() / 2); // 0 means the corner has no uv
+                if (positionIndex < 0 || (vt != 0 && texCoordIndex < 0)) {
+                    ++badCorners;
+                    continue;
+                }
+
+                std::pair<int, int> key(positionIndex, texCoordIndex);
+                auto found = vertexLookup.find(key);
+                if (found == vertexLookup.end()) {
+                    unsigned int newIndex = static_cast<unsigned int>(mesh.vertices.size() / 5);
+                    mesh.vertices.push_back(positions[positionIndex * 3 + 0]);
+                    mesh.vertices.push_back(positions[positionIndex * 3 + 1]);
+                    mesh.vertices.push_back(positions[positionIndex * 3 + 2]);
+                    mesh.vertices.push_back(texCoordIndex >= 0 ? texCoords[texCoordIndex * 2 + 0] : 0.0f);
+                    mesh.vertices.push_back(texCoordIndex >= 0 ? texCoords[texCoordIndex * 2 + 1] : 0.0f);
+                    found = vertexLookup.emplace(key, newIndex).first;
+                }
+                corners.push_back(found->second);
+            }
+
+            for (size_t i = 2; i < corners.size(); ++i) {
+                mesh.indices.push_back(corners[0]);
+                mesh.indices.push_back(corners[i - 1]);
+                mesh.indices.push_back(corners[i]);
+            }
+        }
+        // normals, groups and materials are ignored, the vertex layout only carries position and uv
+    }
+
+    mesh.num_of_indices = static_cast<unsigned int>(mesh.indices.size());
+    if (badCorners > 0)
+        std::cout << "ERROR::OBJ_LOADER::SKIPPED_FACE_CORNERS " << badCorners << " in " << filename << std::endl;
+
+    return mesh;
+}
@@ -0,0 +1,10 @@
+#ifndef OBJ_LOADER
+#define OBJ_LOADER
+
+#include "mesh.h"
+
+// Loads a Wavefront .obj file into the same position + texture coordinate layout used by construct_mesh
+// Polygons are fan triangulated and each unique v/vt pair becomes one vertex. Returns an empty mesh on failure.
+Mesh load_obj(const char* filename);
+
+#endif // !OBJ_LOADER
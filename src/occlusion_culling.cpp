@@ -0,0 +1,258 @@
+#include "occlusion_culling.h"
+
+#include <algorithm>
+#include <cmath>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define OCCLUSION_CULLING_SSE
+#endif
+
+#define OCCLUSION_TILES_X (OCCLUSION_WIDTH / OCCLUSION_TILE_SIZE)
+#define OCCLUSION_TILES_Y (OCCLUSION_HEIGHT / OCCLUSION_TILE_SIZE)
+
+OccluderMesh make_occluder_mesh(const Mesh& mesh) {
+    OccluderMesh occluder;
+    for (size_t i = 0; i + 2 < mesh.vertices.size(); i += 5)
+        occluder.positions.push_back(glm::vec3(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]));
+    occluder.indices = mesh.indices;
+    return occluder;
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int threadCount)
+    : viewProjection(1.0f), depth(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f), tileMaxDepth(OCCLUSION_TILES_X * OCCLUSION_TILES_Y, 1.0f),
+      workGeneration(0), bandsRemaining(0), shuttingDown(false) {
+    // bands are whole tile rows so no two threads ever write the same tile
+    bandCount = std::max(1u, std::min(threadCount, (unsigned int)OCCLUSION_TILES_Y));
+    for (unsigned int band = 1; band < bandCount; ++band)
+        workers.push_back(std::thread(&OcclusionCuller::workerLoop, this, band));
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        shuttingDown = true;
+    }
+    workReady.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& frameViewProjection) {
+    viewProjection = frameViewProjection;
+    triangles.clear();
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), 1.0f);
+}
+
+void OcclusionCuller::AddOccluder(const OccluderMesh& occluder, const glm::mat4& model) {
+    glm::mat4 modelViewProjection = viewProjection * model;
+
+    std::vector<glm::vec4>& clip = clipPositions;
+    clip.resize(occluder.positions.size());
+    for (size_t i = 0; i < occluder.positions.size(); ++i)
+        clip[i] = modelViewProjection * glm::vec4(occluder.positions[i], 1.0f);
+
+    for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+        const glm::vec4& a = clip[occluder.indices[i]];
+        const glm::vec4& b = clip[occluder.indices[i + 1]];
+        const glm::vec4& c = clip[occluder.indices[i + 2]];
+        // triangles crossing the near plane are dropped, fewer occluders only ever means fewer objects culled
+        const float nearW = 1e-4f;
+        if (a.w < nearW || b.w < nearW || c.w < nearW)
+            continue;
+
+        ScreenTriangle triangle;
+        glm::vec4 corners[3] = { a, b, c };
+        glm::vec3* out[3] = { &triangle.v0, &triangle.v1, &triangle.v2 };
+        for (int k = 0; k < 3; ++k) {
+            glm::vec3 ndc = glm::vec3(corners[k]) / corners[k].w;
+            out[k]->x = (ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+            out[k]->y = (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+            out[k]->z = ndc.z * 0.5f + 0.5f;
+        }
+        triangles.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::RasterizeOccluders() {
+    if (triangles.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        bandsRemaining = bandCount - 1;
+        ++workGeneration;
+    }
+    workReady.notify_all();
+
+    rasterizeBand(0);
+
+    std::unique_lock<std::mutex> lock(workMutex);
+    workDone.wait(lock, [this] { return bandsRemaining == 0; });
+}
+
+void OcclusionCuller::workerLoop(unsigned int band) {
+    unsigned int seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(workMutex);
+            workReady.wait(lock, [&] { return shuttingDown || workGeneration != seenGeneration; });
+            if (shuttingDown)
+                return;
+            seenGeneration = workGeneration;
+        }
+
+        rasterizeBand(band);
+
+        {
+            std::lock_guard<std::mutex> lock(workMutex);
+            --bandsRemaining;
+        }
+        workDone.notify_one();
+    }
+}
+
+void OcclusionCuller::rasterizeBand(unsigned int band) {
+    int firstTileRow = OCCLUSION_TILES_Y * band / bandCount;
+    int lastTileRow = OCCLUSION_TILES_Y * (band + 1) / bandCount;
+    int minRow = firstTileRow * OCCLUSION_TILE_SIZE;
+    int maxRow = lastTileRow * OCCLUSION_TILE_SIZE - 1;
+
+    for (const ScreenTriangle& triangle : triangles)
+        rasterizeTriangle(triangle, minRow, maxRow);
+
+    // farthest depth of every tile in this band
+    for (int tileY = firstTileRow; tileY < lastTileRow; ++tileY) {
+        for (int tileX = 0; tileX < OCCLUSION_TILES_X; ++tileX) {
+            float farthest = 0.0f;
+            for (int y = 0; y < OCCLUSION_TILE_SIZE; ++y) {
+                const float* row = &depth[(tileY * OCCLUSION_TILE_SIZE + y) * OCCLUSION_WIDTH + tileX * OCCLUSION_TILE_SIZE];
+                for (int x = 0; x < OCCLUSION_TILE_SIZE; ++x)
+                    farthest = std::max(farthest, row[x]);
+            }
+            tileMaxDepth[tileY * OCCLUSION_TILES_X + tileX] = farthest;
+        }
+    }
+}
+
+// half space rasterizer, pixel centers inside all three edges get the triangle's depth if it is nearer
+void OcclusionCuller::rasterizeTriangle(const ScreenTriangle& triangle, int minRow, int maxRow) {
+    glm::vec3 v0 = triangle.v0, v1 = triangle.v1, v2 = triangle.v2;
+
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (std::fabs(area) < 1e-8f)
+        return;
+    if (area < 0.0f) { // occluders are solid, accept either winding
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    int minX = std::max(0, (int)std::floor(std::min({ v0.x, v1.x, v2.x })));
+    int maxX = std::min(OCCLUSION_WIDTH - 1, (int)std::ceil(std::max({ v0.x, v1.x, v2.x })));
+    int minY = std::max(minRow, (int)std::floor(std::min({ v0.y, v1.y, v2.y })));
+    int maxY = std::min(maxRow, (int)std::ceil(std::max({ v0.y, v1.y, v2.y })));
+    if (minX > maxX || minY > maxY)
+        return;
+
+    // edge functions E(x, y) = A * x + B * y + C, positive inside
+    float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = v1.x * v2.y - v1.y * v2.x;
+    float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = v2.x * v0.y - v2.y * v0.x;
+    float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = v0.x * v1.y - v0.y * v1.x;
+
+    // depth is linear in screen space: z = v0.z + dzdx * (x - v0.x) + dzdy * (y - v0.y)
+    float dzdx = (a0 * v0.z + a1 * v1.z + a2 * v2.z) / area;
+    float dzdy = (b0 * v0.z + b1 * v1.z + b2 * v2.z) / area;
+    float z0 = v0.z - dzdx * v0.x - dzdy * v0.y;
+
+    for (int y = minY; y <= maxY; ++y) {
+        float py = y + 0.5f;
+        float* row = &depth[y * OCCLUSION_WIDTH];
+        int x = minX;
+
+#if defined(__AVX__)
+        const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        for (; x + 7 <= maxX; x += 8) {
+            __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), laneOffsets);
+            __m256 e0 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a0), px), _mm256_set1_ps(b0 * py + c0));
+            __m256 e1 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a1), px), _mm256_set1_ps(b1 * py + c1));
+            __m256 e2 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a2), px), _mm256_set1_ps(b2 * py + c2));
+            __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+                _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+            if (_mm256_movemask_ps(inside) == 0)
+                continue;
+            __m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(dzdx), px), _mm256_set1_ps(dzdy * py + z0));
+            __m256 current = _mm256_loadu_ps(row + x);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+        }
+#elif defined(OCCLUSION_CULLING_SSE)
+        const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+        for (; x + 3 <= maxX; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), _mm_set1_ps(b0 * py + c0));
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), _mm_set1_ps(b1 * py + c1));
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), _mm_set1_ps(b2 * py + c2));
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), _mm_set1_ps(dzdy * py + z0));
+            __m128 current = _mm_loadu_ps(row + x);
+            _mm_storeu_ps(row + x, _mm_blendv_ps(current, _mm_min_ps(current, z), inside));
+        }
+#endif
+        // scalar tail (and the whole row without SIMD)
+        for (; x <= maxX; ++x) {
+            float px = x + 0.5f;
+            if (a0 * px + b0 * py + c0 < 0.0f || a1 * px + b1 * py + c1 < 0.0f || a2 * px + b2 * py + c2 < 0.0f)
+                continue;
+            float z = dzdx * px + dzdy * py + z0;
+            if (z < row[x])
+                row[x] = z;
+        }
+    }
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3& center, const glm::vec3& extent) const {
+    // screen rectangle and nearest depth of the box's projected corners
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1.0f;
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 offset((corner & 1) ? extent.x : -extent.x, (corner & 2) ? extent.y : -extent.y, (corner & 4) ? extent.z : -extent.z);
+        glm::vec4 clip = viewProjection * glm::vec4(center + offset, 1.0f);
+        if (clip.w < 1e-4f)
+            return true; // box reaches behind the camera, can't be hidden by anything in front of it
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        minX = std::min(minX, (ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH);
+        maxX = std::max(maxX, (ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH);
+        minY = std::min(minY, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT);
+        maxY = std::max(maxY, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT);
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+
+    int x0 = std::max(0, (int)std::floor(minX));
+    int x1 = std::min(OCCLUSION_WIDTH - 1, (int)std::ceil(maxX));
+    int y0 = std::max(0, (int)std::floor(minY));
+    int y1 = std::min(OCCLUSION_HEIGHT - 1, (int)std::ceil(maxY));
+    if (x0 > x1 || y0 > y1)
+        return true; // off screen, that's the frustum culler's call
+
+    for (int tileY = y0 / OCCLUSION_TILE_SIZE; tileY <= y1 / OCCLUSION_TILE_SIZE; ++tileY) {
+        for (int tileX = x0 / OCCLUSION_TILE_SIZE; tileX <= x1 / OCCLUSION_TILE_SIZE; ++tileX) {
+            // everything in this tile is nearer than the box, skip the per pixel test
+            if (tileMaxDepth[tileY * OCCLUSION_TILES_X + tileX] < nearest)
+                continue;
+
+            int px0 = std::max(x0, tileX * OCCLUSION_TILE_SIZE), px1 = std::min(x1, tileX * OCCLUSION_TILE_SIZE + OCCLUSION_TILE_SIZE - 1);
+            int py0 = std::max(y0, tileY * OCCLUSION_TILE_SIZE), py1 = std::min(y1, tileY * OCCLUSION_TILE_SIZE + OCCLUSION_TILE_SIZE - 1);
+            for (int y = py0; y <= py1; ++y) {
+                for (int x = px0; x <= px1; ++x) {
+                    if (depth[y * OCCLUSION_WIDTH + x] >= nearest)
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
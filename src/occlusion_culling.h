@@ -0,0 +1,65 @@
+#ifndef OCCLUSION_CULLING
+#define OCCLUSION_CULLING
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <glm.hpp>
+#include "mesh.h"
+
+#define OCCLUSION_WIDTH 240 // depth buffer resolution, a quarter of the window in each direction
+#define OCCLUSION_HEIGHT 160
+#define OCCLUSION_TILE_SIZE 8 // pixels per side of a hierarchical depth tile
+
+// Positions only copy of a mesh used to draw into the occlusion buffer, should be a simplified, fully solid stand in
+typedef struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+}OccluderMesh;
+
+OccluderMesh make_occluder_mesh(const Mesh& mesh);
+
+// CPU depth rasterizer for software occlusion culling.
+// Occluders are rasterized into a low resolution depth buffer (8 pixels at a time, split into row bands across threads),
+// then every tile keeps its farthest depth so most bounding box tests are settled without touching individual pixels.
+class OcclusionCuller {
+public:
+	OcclusionCuller(unsigned int threadCount);
+	~OcclusionCuller();
+
+	void BeginFrame(const glm::mat4& viewProjection); // clears the buffer and the occluder list
+	void AddOccluder(const OccluderMesh& occluder, const glm::mat4& model); // transforms and queues the occluder's triangles
+	void RasterizeOccluders(); // draws every queued triangle and builds the tile depths
+	bool IsVisible(const glm::vec3& center, const glm::vec3& extent) const; // world AABB test, true if any part may be visible
+
+	unsigned int GetOccluderTriangleCount() const { return static_cast<unsigned int>(triangles.size()); }
+
+private:
+	// a screen space triangle ready for rasterizing, depth is NDC z remapped to 0 (near) .. 1 (far)
+	typedef struct ScreenTriangle {
+		glm::vec3 v0, v1, v2;
+	}ScreenTriangle;
+
+	void rasterizeBand(unsigned int band);
+	void rasterizeTriangle(const ScreenTriangle& triangle, int minRow, int maxRow);
+	void workerLoop(unsigned int band);
+
+	glm::mat4 viewProjection;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<glm::vec4> clipPositions; // scratch for AddOccluder, kept to avoid reallocating per occluder
+	std::vector<float> depth; // OCCLUSION_WIDTH * OCCLUSION_HEIGHT, nearest occluder depth per pixel
+	std::vector<float> tileMaxDepth; // farthest depth in each tile
+
+	// persistent band workers, the calling thread rasterizes band 0 itself
+	unsigned int bandCount;
+	std::vector<std::thread> workers;
+	std::mutex workMutex;
+	std::condition_variable workReady;
+	std::condition_variable workDone;
+	unsigned int workGeneration;
+	unsigned int bandsRemaining;
+	bool shuttingDown;
+};
+
+#endif // !OCCLUSION_CULLING
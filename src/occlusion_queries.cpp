@@ -0,0 +1,249 @@
+#include <GL/glew.h>
+#include "occlusion_queries.h"
+#include "camera_uniforms.h"
+#include "gl_state.h"
+
+//BOUNDS VERTEX SHADER
+const char* boundsVertexShaderSource = "#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+CAMERA_UNIFORM_BLOCK_GLSL
+"uniform vec3 boxCenter;\n"
+"uniform vec3 boxExtent;\n"
+"void main()\n"
+"{\n"
+"   gl_Position = viewProjection * vec4(boxCenter + aPos * boxExtent, 1.0);\n"
+"}\0";
+
+//BOUNDS FRAGMENT SHADER (color writes are masked off, only the depth test matters)
+const char* boundsFragmentShaderSource = "#version 330 core\n"
+"out vec4 FragColor;\n"
+"void main()\n"
+"{\n"
+"   FragColor = vec4(1.0);\n"
+"}\n\0";
+
+OcclusionQueryCuller::OcclusionQueryCuller(unsigned int boundsProgram)
+    : cameraPosition(0.0f), frame(1), queriesIssued(0), boxProgram(boundsProgram) {
+    // unit box from -1 to 1, scaled by the node's extent
+    float boxVertices[] = {
+        -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f
+    };
+    unsigned int boxIndices[] = {
+        0, 1, 2, 0, 2, 3, // back
+        4, 6, 5, 4, 7, 6, // front
+        0, 3, 7, 0, 7, 4, // left
+        1, 5, 6, 1, 6, 2, // right
+        0, 4, 5, 0, 5, 1, // bottom
+        3, 2, 6, 3, 6, 7  // top
+    };
+
+    glGenVertexArrays(1, &boxVAO);
+    gl_bind_vertex_array(boxVAO);
+    glGenBuffers(1, &boxVBO);
+    gl_bind_buffer(GL_ARRAY_BUFFER, boxVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(boxVertices), boxVertices, GL_STATIC_DRAW);
+    glGenBuffers(1, &boxEBO);
+    gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, boxEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(boxIndices), boxIndices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    gl_bind_vertex_array(0);
+
+    bind_camera_uniform_block(boxProgram);
+    boxCenterLoc = glGetUniformLocation(boxProgram, "boxCenter");
+    boxExtentLoc = glGetUniformLocation(boxProgram, "boxExtent");
+}
+
+OcclusionQueryCuller::~OcclusionQueryCuller() {
+    for (QueryNode& node : nodes)
+        glDeleteQueries(OCCLUSION_QUERY_FRAMES, node.queries);
+    gl_delete_vertex_arrays(1, &boxVAO);
+    gl_delete_buffers(1, &boxVBO);
+    gl_delete_buffers(1, &boxEBO);
+}
+
+int OcclusionQueryCuller::AddNode(int parent, bool boundsQueryOnly) {
+    QueryNode node;
+    node.parent = parent;
+    node.boundsQueryOnly = boundsQueryOnly;
+    node.isGroup = false;
+    node.visible = true; // optimistic, the first real result arrives a frame later
+    node.center = glm::vec3(0.0f);
+    node.extent = glm::vec3(0.0f);
+    node.activeFrame = 0;
+    node.queriedThisFrame = false;
+    glGenQueries(OCCLUSION_QUERY_FRAMES, node.queries);
+    for (int i = 0; i < OCCLUSION_QUERY_FRAMES; ++i) {
+        node.pending[i] = false;
+        node.issuedFrame[i] = 0;
+    }
+
+    int index = static_cast<int>(nodes.size());
+    node.nextRecheckFrame = index % OCCLUSION_RECHECK_INTERVAL; // stagger rechecks so they don't all land on one frame
+    if (parent >= 0) {
+        nodes[parent].isGroup = true;
+        nodes[parent].boundsQueryOnly = true;
+    }
+    nodes.push_back(node);
+    return index;
+}
+
+void OcclusionQueryCuller::SetBounds(int node, const glm::vec3& center, const glm::vec3& extent) {
+    nodes[node].center = center;
+    nodes[node].extent = extent;
+    nodes[node].activeFrame = frame;
+
+    // the camera inside the box clips the proxy against the near plane, never trust a query there
+    glm::vec3 offset = glm::abs(cameraPosition - center);
+    if (offset.x <= extent.x + 0.2f && offset.y <= extent.y + 0.2f && offset.z <= extent.z + 0.2f)
+        nodes[node].visible = true;
+}
+
+void OcclusionQueryCuller::openGroup(int group) {
+    nodes[group].visible = true;
+    for (size_t i = group + 1; i < nodes.size(); ++i) {
+        if (nodes[i].parent == group)
+            nodes[i].visible = true; // children start out optimistic, their own queries sort them out
+    }
+}
+
+void OcclusionQueryCuller::BeginFrame(const glm::vec3& frameCameraPosition) {
+    cameraPosition = frameCameraPosition;
+    queriesIssued = 0;
+
+    // newest available result per node, never waiting on one that isn't ready
+    std::vector<int> groupsToOpen;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        QueryNode& node = nodes[i];
+        node.queriedThisFrame = false;
+        unsigned int newestFrame = 0;
+        for (int slot = 0; slot < OCCLUSION_QUERY_FRAMES; ++slot) {
+            if (!node.pending[slot])
+                continue;
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(node.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint anySamples = GL_FALSE;
+            glGetQueryObjectuiv(node.queries[slot], GL_QUERY_RESULT, &anySamples);
+            node.pending[slot] = false;
+            if (node.issuedFrame[slot] < newestFrame)
+                continue;
+            newestFrame = node.issuedFrame[slot];
+            bool wasVisible = node.visible;
+            node.visible = anySamples != GL_FALSE;
+            if (node.isGroup && node.visible && !wasVisible)
+                groupsToOpen.push_back(static_cast<int>(i));
+        }
+    }
+    for (int group : groupsToOpen)
+        openGroup(group);
+
+    // pull up: children are stored after their parents, so walking backwards settles every group after its children
+    std::vector<int> visibleChildren(nodes.size(), 0), knownChildren(nodes.size(), 0);
+    for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; --i) {
+        QueryNode& node = nodes[i];
+        if (node.isGroup && node.visible && knownChildren[i] > 0)
+            node.visible = visibleChildren[i] > 0; // an open group whose children are all hidden closes
+        if (node.parent >= 0) {
+            ++knownChildren[node.parent];
+            if (node.visible)
+                ++visibleChildren[node.parent];
+        }
+    }
+}
+
+bool OcclusionQueryCuller::ancestorsVisible(int node) const {
+    for (int parent = nodes[node].parent; parent >= 0; parent = nodes[parent].parent) {
+        if (!nodes[parent].visible)
+            return false;
+    }
+    return true;
+}
+
+bool OcclusionQueryCuller::WasVisible(int node) const {
+    const QueryNode& queryNode = nodes[node];
+    return queryNode.activeFrame == frame && queryNode.visible && ancestorsVisible(node);
+}
+
+bool OcclusionQueryCuller::beginQuery(QueryNode& node) {
+    int slot = frame % OCCLUSION_QUERY_FRAMES;
+    if (node.pending[slot])
+        return false; // three frames and still not back, skip rather than stall
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, node.queries[slot]);
+    node.pending[slot] = true;
+    node.issuedFrame[slot] = frame;
+    node.queriedThisFrame = true;
+    ++queriesIssued;
+    return true;
+}
+
+void OcclusionQueryCuller::BeginDraw(int node) {
+    QueryNode& queryNode = nodes[node];
+    if (queryNode.boundsQueryOnly || frame < queryNode.nextRecheckFrame)
+        return;
+    if (beginQuery(queryNode))
+        queryNode.nextRecheckFrame = frame + OCCLUSION_RECHECK_INTERVAL;
+}
+
+void OcclusionQueryCuller::EndDraw(int node) {
+    QueryNode& queryNode = nodes[node];
+    if (queryNode.queriedThisFrame)
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+}
+
+void OcclusionQueryCuller::IssueBoundsQueries() {
+    bool stateSet = false;
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        QueryNode& node = nodes[i];
+        if (node.activeFrame != frame || node.queriedThisFrame || !ancestorsVisible(static_cast<int>(i)))
+            continue;
+
+        bool query = false;
+        if (!node.visible)
+            query = true; // hidden leaf, or a closed group standing in for all of its children
+        else if (node.boundsQueryOnly && !node.isGroup && frame >= node.nextRecheckFrame)
+            query = true; // visible, but the only way to recheck it is by its box
+        if (!query)
+            continue;
+
+        if (!stateSet) {
+            gl_color_mask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            gl_depth_mask(GL_FALSE);
+            gl_use_program(boxProgram);
+            gl_bind_vertex_array(boxVAO);
+            stateSet = true;
+        }
+        if (!beginQuery(node))
+            continue;
+        glUniform3fv(boxCenterLoc, 1, &node.center[0]);
+        glUniform3fv(boxExtentLoc, 1, &node.extent[0]);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        if (node.visible)
+            node.nextRecheckFrame = frame + OCCLUSION_RECHECK_INTERVAL;
+    }
+
+    if (stateSet) {
+        gl_color_mask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        gl_depth_mask(GL_TRUE);
+    }
+}
+
+bool OcclusionQueryCuller::BeginConditionalDraw(int node) {
+    QueryNode& queryNode = nodes[node];
+    if (!queryNode.queriedThisFrame || queryNode.visible)
+        return false;
+    glBeginConditionalRender(queryNode.queries[frame % OCCLUSION_QUERY_FRAMES], GL_QUERY_NO_WAIT);
+    return true;
+}
+
+void OcclusionQueryCuller::EndConditionalDraw() {
+    glEndConditionalRender();
+}
+
+void OcclusionQueryCuller::EndFrame() {
+    ++frame;
+}
@@ -0,0 +1,78 @@
+#ifndef OCCLUSION_QUERIES
+#define OCCLUSION_QUERIES
+
+#include <vector>
+#include <glm.hpp>
+
+#define OCCLUSION_QUERY_FRAMES 3 // query objects per node, results are read at least one frame after they were issued
+#define OCCLUSION_RECHECK_INTERVAL 8 // visible nodes are re-queried roughly this often (staggered per node)
+
+// Hardware occlusion culling with temporal coherence, after CHC++:
+//  - nodes visible last frame are drawn straight away, and only re-queried every few frames
+//  - nodes hidden last frame get a bounding box query once the visible geometry is in the depth buffer,
+//    and are drawn inside glBeginConditionalRender(GL_QUERY_NO_WAIT) so the CPU never waits on the GPU
+//  - query results are read back a frame late, only once GL reports them available
+//  - visibility propagates through a node hierarchy: a group with no visible children closes and is queried as one box,
+//    a visible leaf opens all of its ancestors
+// Needs a GL context for construction and a program compiled from the bounding box shaders below.
+class OcclusionQueryCuller {
+public:
+	OcclusionQueryCuller(unsigned int boundsProgram);
+	~OcclusionQueryCuller();
+
+	int AddNode(int parent, bool boundsQueryOnly); // parents must be added before their children, returns the node index
+	void BeginFrame(const glm::vec3& cameraPosition); // collects finished query results and propagates visibility
+	void SetBounds(int node, const glm::vec3& center, const glm::vec3& extent); // call after BeginFrame, also marks the node as in view this frame
+	bool WasVisible(int node) const; // visible in the latest results, along with every ancestor
+
+	// wrap the draw of a node that WasVisible, re-checks it with a query on the real geometry when it is due
+	void BeginDraw(int node);
+	void EndDraw(int node);
+
+	// queries the bounding box of every in view node that is hidden (or visible but only checkable by its box and due)
+	// changes the bound program, VAO, color and depth masks; restores the masks
+	void IssueBoundsQueries();
+
+	// wrap the draw of a hidden node, returns false if it wasn't queried this frame (so it must be skipped)
+	bool BeginConditionalDraw(int node);
+	void EndConditionalDraw();
+
+	void EndFrame();
+
+	unsigned int GetQueriesIssued() const { return queriesIssued; } // this frame
+
+private:
+	typedef struct QueryNode {
+		int parent;
+		bool boundsQueryOnly; // can't be queried by its own geometry (groups, instanced draws)
+		bool isGroup;
+		bool visible;
+		glm::vec3 center, extent;
+		unsigned int activeFrame; // last frame SetBounds was called
+		unsigned int nextRecheckFrame;
+		unsigned int queries[OCCLUSION_QUERY_FRAMES];
+		bool pending[OCCLUSION_QUERY_FRAMES];
+		unsigned int issuedFrame[OCCLUSION_QUERY_FRAMES];
+		bool queriedThisFrame;
+	}QueryNode;
+
+	bool ancestorsVisible(int node) const;
+	bool beginQuery(QueryNode& node); // false if this frame's query slot is still waiting on an old result
+	void openGroup(int group);
+
+	std::vector<QueryNode> nodes;
+	glm::vec3 cameraPosition;
+	unsigned int frame;
+	unsigned int queriesIssued;
+
+	// unit box proxy
+	unsigned int boxProgram;
+	unsigned int boxVAO, boxVBO, boxEBO;
+	int boxCenterLoc, boxExtentLoc;
+};
+
+// Bounding box proxy shader, draws a unit cube scaled to a node's bounds using the shared camera uniform block
+extern const char* boundsVertexShaderSource;
+extern const char* boundsFragmentShaderSource;
+
+#endif // !OCCLUSION_QUERIES
@@ -0,0 +1,176 @@
+#include <GL/glew.h>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <gtc/type_ptr.hpp>
+#include "render_queue.h"
+#include "gl_state.h"
+
+uint64_t make_render_key(RenderPass pass, unsigned int program, unsigned int material, unsigned int vao, float normalizedDepth) {
+    const uint64_t depthMax = (1ull << RENDER_KEY_DEPTH_BITS) - 1;
+    normalizedDepth = std::min(std::max(normalizedDepth, 0.0f), 1.0f);
+    if (pass == RENDER_PASS_TRANSPARENT)
+        normalizedDepth = 1.0f - normalizedDepth; // back to front
+    uint64_t depth = (uint64_t)(normalizedDepth * depthMax);
+
+    // GL names are small in practice, if one overflows its field it only loses grouping, the binds are still exact
+    uint64_t key = (uint64_t)pass;
+    key = (key << RENDER_KEY_PROGRAM_BITS) | (program & ((1u << RENDER_KEY_PROGRAM_BITS) - 1));
+    key = (key << RENDER_KEY_MATERIAL_BITS) | (material & ((1u << RENDER_KEY_MATERIAL_BITS) - 1));
+    key = (key << RENDER_KEY_VAO_BITS) | (vao & ((1u << RENDER_KEY_VAO_BITS) - 1));
+    key = (key << RENDER_KEY_DEPTH_BITS) | depth;
+    return key;
+}
+
+void radix_sort_keys(const std::vector<uint64_t>& keys, std::vector<uint32_t>& order, std::vector<uint32_t>& scratch) {
+    uint32_t count = (uint32_t)keys.size();
+    order.resize(count);
+    scratch.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+        order[i] = i;
+    if (count < 2)
+        return;
+
+    // all 8 histograms in one read of the keys
+    uint32_t histograms[8][256] = {};
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t key = keys[i];
+        for (int byte = 0; byte < 8; ++byte)
+            ++histograms[byte][(key >> (byte * 8)) & 0xFF];
+    }
+
+    for (int byte = 0; byte < 8; ++byte) {
+        uint32_t* histogram = histograms[byte];
+        // every key has the same byte here (unused key bits, one program...), the pass wouldn't move anything
+        if (histogram[(keys[0] >> (byte * 8)) & 0xFF] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket) {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t index = order[i];
+            scratch[histogram[(keys[index] >> (byte * 8)) & 0xFF]++] = index;
+        }
+        order.swap(scratch);
+    }
+}
+
+RenderQueue::RenderQueue(float nearPlane, float farPlane) : nearPlane(nearPlane), farPlane(farPlane), jobs(NULL) {
+}
+
+void RenderQueue::Clear() {
+    items.clear();
+    order.clear();
+}
+
+void RenderQueue::Submit(RenderPass pass, unsigned int program, unsigned int vao, unsigned int material, const MeshRange& range, const glm::mat4& model, float viewDepth, int id) {
+    DrawItem item;
+    item.key = make_render_key(pass, program, material, vao, (viewDepth - nearPlane) / (farPlane - nearPlane));
+    item.program = program;
+    item.vao = vao;
+    item.material = material;
+    item.range = range;
+    item.model = model;
+    item.id = id;
+    items.push_back(item);
+}
+
+void RenderQueue::Sort() {
+    std::vector<uint64_t> keys(items.size());
+    for (size_t i = 0; i < items.size(); ++i)
+        keys[i] = items[i].key;
+    radix_sort_keys(keys, order, scratch);
+}
+
+RenderQueueStats RenderQueue::Execute(StreamBuffer& constants, const DrawHook& beforeDraw, const DrawHook& afterDraw) {
+    RenderQueueStats stats = { 0, 0, 0 };
+    if (items.empty())
+        return stats;
+    if (order.size() != items.size())
+        Sort();
+
+    // constants go in sorted order, each at its own aligned offset so it can be bound as a uniform block range
+    unsigned int alignment = constants.GetUniformAlignment();
+    unsigned int stride = ((unsigned int)sizeof(ObjectConstants) + alignment - 1) / alignment * alignment;
+    unsigned int constantsOffset;
+    unsigned char* constantData = (unsigned char*)constants.Allocate(stride * (unsigned int)order.size(), alignment, constantsOffset);
+    if (!constantData) {
+        std::cout << "ERROR::RENDER_QUEUE::STREAM_BUFFER_FULL" << std::endl;
+        return stats;
+    }
+
+    size_t recorders = (order.size() + RENDER_QUEUE_MIN_DRAWS_PER_RECORDER - 1) / RENDER_QUEUE_MIN_DRAWS_PER_RECORDER;
+    recorders = std::max<size_t>(1, std::min<size_t>(recorders, jobs ? jobs->GetThreadCount() : 1));
+    commandBuffers.resize(recorders);
+    stats = Record(commandBuffers, constantData, constants.GetBuffer(), constantsOffset, stride, (bool)beforeDraw, (bool)afterDraw, jobs);
+    constants.Flush();
+
+    std::vector<CommandCallback> callbacks = { beforeDraw, afterDraw };
+    for (size_t i = 0; i < recorders; ++i)
+        commandBuffers[i].Execute(callbacks);
+    return stats;
+}
+
+RenderQueueStats RenderQueue::Record(std::vector<CommandBuffer>& buffers, unsigned char* constantData, unsigned int constantBuffer, unsigned int constantsOffset, unsigned int stride,
+    bool beforeDraw, bool afterDraw, JobSystem* recordJobs) const {
+    std::vector<RenderQueueStats> partStats(buffers.size(), RenderQueueStats{ 0, 0, 0 });
+    record_command_buffers(buffers, order.size(), [&](CommandBuffer& commands, size_t begin, size_t end) {
+        RenderQueueStats& part = partStats[&commands - buffers.data()];
+        // a part starts from the state the draw before it left behind, which is what the previous part ends with once
+        // they are replayed in order, so splitting the queue never adds a bind
+        unsigned int boundProgram = begin > 0 ? items[order[begin - 1]].program : 0;
+        unsigned int boundVAO = begin > 0 ? items[order[begin - 1]].vao : 0;
+        for (size_t i = begin; i < end; ++i) {
+            const DrawItem& item = items[order[i]];
+            ObjectConstants objectConstants = { item.model, glm::uvec4(item.material, 0, 0, 0) };
+            std::memcpy(constantData + i * stride, &objectConstants, sizeof(objectConstants));
+
+            if (item.program != boundProgram) {
+                commands.UseProgram(item.program);
+                boundProgram = item.program;
+                ++part.stateChanges;
+            }
+            if (item.vao != boundVAO) {
+                commands.BindVertexArray(item.vao);
+                boundVAO = item.vao;
+                ++part.stateChanges;
+            }
+
+            if (beforeDraw)
+                commands.Callback(0, item.id);
+            commands.BindBufferRange(GL_UNIFORM_BUFFER, OBJECT_UNIFORM_BINDING, constantBuffer, constantsOffset + (unsigned int)i * stride, sizeof(ObjectConstants));
+            commands.DrawElements(item.range);
+            if (afterDraw)
+                commands.Callback(1, item.id);
+            ++part.draws;
+        }
+    }, recordJobs);
+
+    RenderQueueStats stats = { 0, 0, 0 };
+    for (const RenderQueueStats& part : partStats) {
+        stats.draws += part.draws;
+        stats.stateChanges += part.stateChanges;
+    }
+    stats.stateChangesSaved = stats.draws * 3 - stats.stateChanges;
+    return stats;
+}
+
+void bind_object_uniform_block(unsigned int shaderProgram) {
+    unsigned int blockIndex = glGetUniformBlockIndex(shaderProgram, "ObjectConstants");
+    if (blockIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(shaderProgram, blockIndex, OBJECT_UNIFORM_BINDING);
+}
+
+bool push_object_constants(StreamBuffer& constants, const glm::mat4& model, unsigned int material) {
+    ObjectConstants objectConstants = { model, glm::uvec4(material, 0, 0, 0) };
+    unsigned int offset;
+    if (!constants.Write(&objectConstants, sizeof(objectConstants), constants.GetUniformAlignment(), offset))
+        return false;
+    constants.Flush();
+    gl_bind_buffer_range(GL_UNIFORM_BUFFER, OBJECT_UNIFORM_BINDING, constants.GetBuffer(), offset, sizeof(ObjectConstants));
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef RENDER_QUEUE
+#define RENDER_QUEUE
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <glm.hpp>
+#include "mesh_batch.h"
+#include "command_buffer.h"
+#include "stream_buffer.h"
+
+#define OBJECT_UNIFORM_BINDING 1 // uniform buffer binding point of the per draw constants
+#define RENDER_QUEUE_MIN_DRAWS_PER_RECORDER 256 // fewer draws than this aren't worth handing to another thread
+
+// GLSL declaration of the per draw constants, written to the stream buffer and bound by range for each draw
+#define OBJECT_UNIFORM_BLOCK_GLSL \
+"layout (std140) uniform ObjectConstants\n" \
+"{\n" \
+"   mat4 model;\n" \
+"   uvec4 material; // x = material index\n" \
+"};\n"
+
+// CPU side layout of ObjectConstants
+typedef struct ObjectConstants {
+    glm::mat4 model;
+    glm::uvec4 material;
+}ObjectConstants;
+
+enum RenderPass { RENDER_PASS_OPAQUE, RENDER_PASS_TRANSPARENT };
+
+// Sort key, most significant first: pass (2 bits) | program (10) | material (12) | VAO (12) | depth (24)
+// so a sorted queue groups draws by the most expensive state first and goes front to back inside each group
+// (transparent draws store inverted depth and come out back to front). Materials only live in the per draw
+// constants, they still group so draws sharing textures sample them back to back.
+#define RENDER_KEY_DEPTH_BITS 24
+#define RENDER_KEY_VAO_BITS 12
+#define RENDER_KEY_MATERIAL_BITS 12
+#define RENDER_KEY_PROGRAM_BITS 10
+
+typedef struct DrawItem {
+    uint64_t key;
+    unsigned int program;
+    unsigned int vao;
+    unsigned int material;
+    MeshRange range;
+    glm::mat4 model;
+    int id; // caller's handle for the draw, passed to the execute hooks
+}DrawItem;
+
+typedef struct RenderQueueStats {
+    unsigned int draws;
+    unsigned int stateChanges;      // program and VAO binds actually made
+    unsigned int stateChangesSaved; // binds skipped compared to binding program, VAO and texture for every draw
+}RenderQueueStats;
+
+typedef std::function<void(int id)> DrawHook;
+
+class RenderQueue {
+public:
+	RenderQueue(float nearPlane, float farPlane);
+
+	void Clear();
+	// viewDepth is the distance along the view direction, used for the front to back order
+	void Submit(RenderPass pass, unsigned int program, unsigned int vao, unsigned int material, const MeshRange& range, const glm::mat4& model, float viewDepth, int id);
+	void Sort(); // radix sort on the keys, only the order is sorted, items stay where they were submitted
+	// records the sorted draws into command buffers, skipping any bind that matches the previous draw's state, then
+	// replays them on this thread. Large queues are split into contiguous parts recorded as jobs on the job system
+	// (when there is one), each writing its draws' constants straight into the stream buffer. Textures come from the
+	// material table so there are none to bind.
+	RenderQueueStats Execute(StreamBuffer& constants, const DrawHook& beforeDraw = DrawHook(), const DrawHook& afterDraw = DrawHook());
+	// The recording half of Execute, no GL calls: the sorted draws go into one contiguous part per buffer (as jobs on
+	// recordJobs when it isn't NULL) and draw i's constants to constantData + i * stride. Replayed in order the parts
+	// hold exactly the commands a single buffer would, the hooks only decide whether callback commands are recorded.
+	RenderQueueStats Record(std::vector<CommandBuffer>& buffers, unsigned char* constantData, unsigned int constantBuffer, unsigned int constantsOffset, unsigned int stride,
+		bool beforeDraw, bool afterDraw, JobSystem* recordJobs) const;
+
+	void SetJobSystem(JobSystem* jobSystem) { jobs = jobSystem; } // NULL records everything on the calling thread
+	unsigned int GetSize() const { return (unsigned int)items.size(); }
+
+private:
+	float nearPlane, farPlane;
+	JobSystem* jobs;
+	std::vector<DrawItem> items;
+	std::vector<uint32_t> order, scratch;
+	std::vector<CommandBuffer> commandBuffers; // one per recording job, kept between frames
+};
+
+void bind_object_uniform_block(unsigned int shaderProgram); // points a program's ObjectConstants block at its binding
+// writes one draw's constants and binds them, for draws outside the queue, false if the stream buffer is full
+bool push_object_constants(StreamBuffer& constants, const glm::mat4& model, unsigned int material);
+
+uint64_t make_render_key(RenderPass pass, unsigned int program, unsigned int material, unsigned int vao, float normalizedDepth);
+// LSD radix sort, 8 bits per pass, fills order with the indices of keys in ascending key order
+void radix_sort_keys(const std::vector<uint64_t>& keys, std::vector<uint32_t>& order, std::vector<uint32_t>& scratch);
+
+#endif // !RENDER_QUEUE
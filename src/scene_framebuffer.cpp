@@ -0,0 +1,61 @@
+#include <GL/glew.h>
+#include <iostream>
+#include "scene_framebuffer.h"
+#include "gl_state.h"
+
+// nearest filtered, edge clamped texture storage for a framebuffer attachment
+static unsigned int create_attachment_texture(GLint internalFormat, GLenum format, GLenum type, int width, int height) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    gl_bind_texture(GL_TEXTURE_2D, textureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+    return textureID;
+}
+
+SceneFramebuffer create_scene_framebuffer(int width, int height) {
+    SceneFramebuffer target;
+    target.width = width;
+    target.height = height;
+    target.colorTexture = create_attachment_texture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    target.depthTexture = create_attachment_texture(GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, width, height);
+    gl_bind_texture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &target.framebuffer);
+    gl_bind_framebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depthTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::FRAMEBUFFER::SCENE_FRAMEBUFFER_INCOMPLETE" << std::endl;
+        gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
+        delete_scene_framebuffer(target);
+        return target;
+    }
+    gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
+    return target;
+}
+
+void bind_scene_framebuffer(const SceneFramebuffer& target) {
+    gl_bind_framebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    gl_viewport(0, 0, target.width, target.height);
+}
+
+void blit_scene_framebuffer_to_screen(const SceneFramebuffer& target) {
+    gl_bind_framebuffer(GL_READ_FRAMEBUFFER, target.framebuffer);
+    gl_bind_framebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, target.width, target.height, 0, 0, target.width, target.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void delete_scene_framebuffer(SceneFramebuffer& target) {
+    if (target.framebuffer)
+        gl_delete_framebuffers(1, &target.framebuffer);
+    gl_delete_textures(1, &target.colorTexture);
+    gl_delete_textures(1, &target.depthTexture);
+    target.framebuffer = 0;
+    target.colorTexture = 0;
+    target.depthTexture = 0;
+}
@@ -0,0 +1,17 @@
+#ifndef SCENE_FRAMEBUFFER
+#define SCENE_FRAMEBUFFER
+
+// Offscreen target the scene can be drawn into when later passes need to sample its depth (e.g. the Hi-Z pyramid)
+typedef struct SceneFramebuffer {
+    unsigned int framebuffer;
+    unsigned int colorTexture; // RGBA8
+    unsigned int depthTexture; // GL_DEPTH_COMPONENT32F, nearest filtered
+    int width, height;
+}SceneFramebuffer;
+
+SceneFramebuffer create_scene_framebuffer(int width, int height); // framebuffer is 0 if it couldn't be completed
+void bind_scene_framebuffer(const SceneFramebuffer& target);
+void blit_scene_framebuffer_to_screen(const SceneFramebuffer& target); // copies color to the default framebuffer and binds it
+void delete_scene_framebuffer(SceneFramebuffer& target);
+
+#endif // !SCENE_FRAMEBUFFER
@@ -0,0 +1,220 @@
+#include <GL/glew.h>
+#include <cstring>
+#include <algorithm>
+#include <gtc/type_ptr.hpp>
+#include "shader_program.h"
+#include "gl_state.h"
+
+// Whether a uniform declared as uniformType can be set with the glUniform* call for setterType
+static bool uniform_type_matches(unsigned int setterType, unsigned int uniformType) {
+    if (setterType == uniformType)
+        return true;
+    if (uniformType == GL_BOOL) // bools take any of glUniform1i, glUniform1ui and glUniform1f
+        return setterType == GL_INT || setterType == GL_UNSIGNED_INT || setterType == GL_FLOAT;
+    if (setterType != GL_INT)
+        return false;
+    switch (uniformType) { // samplers and images are set to their texture or image unit with glUniform1i
+    case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+    case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_1D_ARRAY_SHADOW: case GL_SAMPLER_2D_ARRAY_SHADOW:
+    case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_RECT:
+    case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_CUBE: case GL_INT_SAMPLER_2D_ARRAY: case GL_INT_SAMPLER_BUFFER:
+    case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_CUBE:
+    case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+    case GL_IMAGE_2D: case GL_IMAGE_3D: case GL_IMAGE_CUBE: case GL_IMAGE_2D_ARRAY: case GL_IMAGE_BUFFER:
+    case GL_INT_IMAGE_2D: case GL_INT_IMAGE_2D_ARRAY: case GL_UNSIGNED_INT_IMAGE_2D: case GL_UNSIGNED_INT_IMAGE_2D_ARRAY:
+        return true;
+    default:
+        return false;
+    }
+}
+
+ShaderProgram::ShaderProgram() : program(0) {
+}
+
+ShaderProgram::ShaderProgram(unsigned int program) : program(program) {
+    if (program == 0)
+        return;
+
+    int count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(maxLength + 1);
+    for (int i = 0; i < count; ++i) {
+        int length = 0, size = 0;
+        GLenum type;
+        glGetActiveUniform(program, i, (GLsizei)name.size(), &length, &size, &type, name.data());
+        std::string uniformName(name.data(), length);
+        int location = glGetUniformLocation(program, uniformName.c_str());
+        if (location == -1)
+            continue; // a uniform block member
+
+        // arrays are reported as "name[0]", keep them reachable as "name" and by element
+        Uniform uniform = { std::vector<int>(1, location), type, 0, std::vector<unsigned char>(), std::vector<char>() };
+        unsigned int index = (unsigned int)uniforms.size();
+        bool isArray = uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0;
+        if (isArray) {
+            std::string baseName = uniformName.substr(0, uniformName.size() - 3);
+            uniformNames.push_back(UniformName{ baseName, index, 0 });
+            for (int element = 0; element < size; ++element) {
+                std::string elementName = baseName + "[" + std::to_string(element) + "]";
+                if (element > 0)
+                    uniform.locations.push_back(glGetUniformLocation(program, elementName.c_str()));
+                uniformNames.push_back(UniformName{ elementName, index, element });
+            }
+        }
+        else {
+            uniformNames.push_back(UniformName{ uniformName, index, 0 });
+        }
+        uniforms.push_back(uniform);
+    }
+    std::sort(uniformNames.begin(), uniformNames.end(), [](const UniformName& a, const UniformName& b) {
+        return a.name < b.name;
+    });
+
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    name.resize(maxLength + 1);
+    for (int i = 0; i < count; ++i) {
+        int length = 0;
+        glGetActiveUniformBlockName(program, i, (GLsizei)name.size(), &length, name.data());
+        uniformBlocks[std::string(name.data(), length)] = (unsigned int)i;
+    }
+
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+    name.resize(maxLength + 1);
+    for (int i = 0; i < count; ++i) {
+        int length = 0, size = 0;
+        GLenum type;
+        glGetActiveAttrib(program, i, (GLsizei)name.size(), &length, &size, &type, name.data());
+        std::string attributeName(name.data(), length);
+        int location = glGetAttribLocation(program, attributeName.c_str());
+        if (location != -1) // built ins like gl_VertexID are active attributes without a location
+            attributes[attributeName] = location;
+    }
+}
+
+void ShaderProgram::Use() const {
+    gl_use_program(program);
+}
+
+const ShaderProgram::UniformName* ShaderProgram::FindUniform(const char* name) const {
+    auto found = std::lower_bound(uniformNames.begin(), uniformNames.end(), name, [](const UniformName& uniformName, const char* key) {
+        return std::strcmp(uniformName.name.c_str(), key) < 0;
+    });
+    return found != uniformNames.end() && found->name == name ? &*found : NULL;
+}
+
+int ShaderProgram::GetUniformLocation(const char* name) const {
+    const UniformName* found = FindUniform(name);
+    return found ? uniforms[found->uniform].locations[found->element] : -1;
+}
+
+int ShaderProgram::GetAttributeLocation(const std::string& name) const {
+    auto found = attributes.find(name);
+    return found == attributes.end() ? -1 : found->second;
+}
+
+unsigned int ShaderProgram::GetUniformBlockIndex(const std::string& name) const {
+    auto found = uniformBlocks.find(name);
+    return found == uniformBlocks.end() ? GL_INVALID_INDEX : found->second;
+}
+
+bool ShaderProgram::Lookup(const char* name, unsigned int type, const void* values, size_t elementSize, int& inOutCount, int& outLocation) {
+    outLocation = -1;
+    const UniformName* found = FindUniform(name);
+    if (!found)
+        return false;
+    Uniform& uniform = uniforms[found->uniform];
+    if (!uniform_type_matches(type, uniform.type))
+        return false;
+    int element = found->element;
+    inOutCount = std::min(inOutCount, (int)uniform.locations.size() - element);
+    if (uniform.elementSize != elementSize) {
+        uniform.elementSize = elementSize;
+        uniform.shadow.assign(uniform.locations.size() * elementSize, 0);
+        uniform.shadowed.assign(uniform.locations.size(), 0);
+    }
+    unsigned char* shadow = &uniform.shadow[element * elementSize];
+    size_t size = inOutCount * elementSize;
+    bool shadowed = std::find(uniform.shadowed.begin() + element, uniform.shadowed.begin() + element + inOutCount, 0) == uniform.shadowed.begin() + element + inOutCount;
+    if (shadowed && std::memcmp(shadow, values, size) == 0)
+        return true;
+    std::memcpy(shadow, values, size);
+    std::fill(uniform.shadowed.begin() + element, uniform.shadowed.begin() + element + inOutCount, 1);
+    outLocation = uniform.locations[element];
+    return true;
+}
+
+bool ShaderProgram::SetInt(const char* name, int value) {
+    int count = 1, location;
+    if (!Lookup(name, GL_INT, &value, sizeof(value), count, location))
+        return false;
+    if (location != -1)
+        glUniform1i(location, value);
+    return true;
+}
+
+bool ShaderProgram::SetUInt(const char* name, unsigned int value) {
+    int count = 1, location;
+    if (!Lookup(name, GL_UNSIGNED_INT, &value, sizeof(value), count, location))
+        return false;
+    if (location != -1)
+        glUniform1ui(location, value);
+    return true;
+}
+
+bool ShaderProgram::SetFloat(const char* name, float value) {
+    int count = 1, location;
+    if (!Lookup(name, GL_FLOAT, &value, sizeof(value), count, location))
+        return false;
+    if (location != -1)
+        glUniform1f(location, value);
+    return true;
+}
+
+bool ShaderProgram::SetIVec2(const char* name, const glm::ivec2& value) {
+    int count = 1, location;
+    if (!Lookup(name, GL_INT_VEC2, glm::value_ptr(value), sizeof(value), count, location))
+        return false;
+    if (location != -1)
+        glUniform2iv(location, 1, glm::value_ptr(value));
+    return true;
+}
+
+bool ShaderProgram::SetVec3(const char* name, const glm::vec3& value) {
+    int count = 1, location;
+    if (!Lookup(name, GL_FLOAT_VEC3, glm::value_ptr(value), sizeof(value), count, location))
+        return false;
+    if (location != -1)
+        glUniform3fv(location, 1, glm::value_ptr(value));
+    return true;
+}
+
+bool ShaderProgram::SetVec4(const char* name, const glm::vec4& value) {
+    int count = 1, location;
+    if (!Lookup(name, GL_FLOAT_VEC4, glm::value_ptr(value), sizeof(value), count, location))
+        return false;
+    if (location != -1)
+        glUniform4fv(location, 1, glm::value_ptr(value));
+    return true;
+}
+
+bool ShaderProgram::SetMat4(const char* name, const glm::mat4& value) {
+    int count = 1, location;
+    if (!Lookup(name, GL_FLOAT_MAT4, glm::value_ptr(value), sizeof(value), count, location))
+        return false;
+    if (location != -1)
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+    return true;
+}
+
+bool ShaderProgram::SetVec4Array(const char* name, const glm::vec4* values, int count) {
+    int location;
+    if (!Lookup(name, GL_FLOAT_VEC4, values, sizeof(glm::vec4), count, location))
+        return false;
+    if (location != -1 && count > 0)
+        glUniform4fv(location, count, glm::value_ptr(values[0]));
+    return true;
+}
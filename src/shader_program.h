@@ -0,0 +1,76 @@
+#ifndef SHADER_PROGRAM
+#define SHADER_PROGRAM
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <glm.hpp>
+
+// A linked program's active uniforms, uniform blocks and attributes, reflected once when it is wrapped
+// The typed setters look the uniform up in the table and skip the upload when the value matches what was last set
+// through this object, so they assume nothing else sets uniforms on the program. An array shares one shadow between its
+// base name and its element names, so "planes" and "planes[0]" are the same value. Setters need the program in use,
+// setting a uniform the program doesn't have (or the optimizer removed) does nothing and returns false, as does a setter
+// whose type doesn't match the GLSL declaration (SetInt also sets bools, samplers and images). Names are looked up
+// without building a std::string, so passing a literal every frame doesn't allocate.
+class ShaderProgram {
+public:
+	ShaderProgram();
+	ShaderProgram(unsigned int program);
+
+	unsigned int GetID() const { return program; }
+	void Use() const;
+
+	int GetUniformLocation(const char* name) const; // -1 if not active
+	int GetUniformLocation(const std::string& name) const { return GetUniformLocation(name.c_str()); }
+	int GetAttributeLocation(const std::string& name) const; // -1 if not active
+	unsigned int GetUniformBlockIndex(const std::string& name) const; // GL_INVALID_INDEX if not active
+	bool HasUniform(const char* name) const { return GetUniformLocation(name) != -1; }
+	bool HasUniform(const std::string& name) const { return GetUniformLocation(name) != -1; }
+
+	bool SetInt(const char* name, int value);
+	bool SetUInt(const char* name, unsigned int value);
+	bool SetFloat(const char* name, float value);
+	bool SetIVec2(const char* name, const glm::ivec2& value);
+	bool SetVec3(const char* name, const glm::vec3& value);
+	bool SetVec4(const char* name, const glm::vec4& value);
+	bool SetMat4(const char* name, const glm::mat4& value);
+	bool SetVec4Array(const char* name, const glm::vec4* values, int count); // from the named element on
+	bool SetInt(const std::string& name, int value) { return SetInt(name.c_str(), value); }
+	bool SetUInt(const std::string& name, unsigned int value) { return SetUInt(name.c_str(), value); }
+	bool SetFloat(const std::string& name, float value) { return SetFloat(name.c_str(), value); }
+	bool SetIVec2(const std::string& name, const glm::ivec2& value) { return SetIVec2(name.c_str(), value); }
+	bool SetVec3(const std::string& name, const glm::vec3& value) { return SetVec3(name.c_str(), value); }
+	bool SetVec4(const std::string& name, const glm::vec4& value) { return SetVec4(name.c_str(), value); }
+	bool SetMat4(const std::string& name, const glm::mat4& value) { return SetMat4(name.c_str(), value); }
+	bool SetVec4Array(const std::string& name, const glm::vec4* values, int count) { return SetVec4Array(name.c_str(), values, count); }
+
+private:
+	typedef struct Uniform {
+	    std::vector<int> locations; // per element
+	    unsigned int type; // GLenum of the element type
+	    size_t elementSize; // bytes per element in the shadow, from the first set
+	    std::vector<unsigned char> shadow; // last value of every element uploaded through this object
+	    std::vector<char> shadowed; // per element, whether shadow holds anything yet
+	}Uniform;
+
+	// a name the uniform can be set by, "name", "name[0]" and "name[1]" of one array all point at the same Uniform
+	typedef struct UniformName {
+	    std::string name;
+	    unsigned int uniform;
+	    int element;
+	}UniformName;
+
+	const UniformName* FindUniform(const char* name) const; // NULL if not active
+	// false if the program has no such uniform or it isn't declared as type, inOutCount is clipped to the elements left
+	// in the array and outLocation is -1 when every one of them already matches the shadow
+	bool Lookup(const char* name, unsigned int type, const void* values, size_t elementSize, int& inOutCount, int& outLocation);
+
+	unsigned int program;
+	std::vector<Uniform> uniforms;
+	std::vector<UniformName> uniformNames; // sorted by name
+	std::unordered_map<std::string, int> attributes;
+	std::unordered_map<std::string, unsigned int> uniformBlocks;
+};
+
+#endif // !SHADER_PROGRAM
@@ -0,0 +1,125 @@
+#include "simulation.h"
+
+#include <cmath>
+
+FixedTimestep create_fixed_timestep(double stepsPerSecond, unsigned int maxStepsPerFrame) {
+    FixedTimestep timestep;
+    timestep.step = 1.0 / stepsPerSecond;
+    timestep.accumulator = 0.0;
+    timestep.maxStepsPerFrame = maxStepsPerFrame;
+    return timestep;
+}
+
+unsigned int advance_fixed_timestep(FixedTimestep& timestep, double frameTime) {
+    timestep.accumulator += frameTime;
+
+    unsigned int steps = 0;
+    while (timestep.accumulator >= timestep.step && steps < timestep.maxStepsPerFrame) {
+        timestep.accumulator -= timestep.step;
+        ++steps;
+    }
+    // hit the cap, drop the backlog instead of trying to catch up next frame as well
+    if (steps == timestep.maxStepsPerFrame && timestep.accumulator >= timestep.step)
+        timestep.accumulator = 0.0;
+
+    return steps;
+}
+
+float fixed_timestep_alpha(const FixedTimestep& timestep) {
+    return static_cast<float>(timestep.accumulator / timestep.step);
+}
+
+int scene_object_parent(int object) {
+    return object == OBJECT_SPHERE ? OBJECT_CUBE : -1;
+}
+
+// the sphere circles the cube while bouncing on the sine wave, in the cube's space (which is scaled by half, so these
+// are twice the world distances). Taken from the phase every time since blending two positions would cut the corners
+// of the circle and the |sin|
+static glm::vec3 sphere_orbit_position(float wavePhase) {
+    const float waveAmplitude = 1.0f; // Height of the wave
+    const float waveFrequency = 1.0f; // How often the wave repeats
+    const float orbitRadius = 1.2f;
+    const float orbitFrequency = 0.5f; // orbits per wave
+    const float orbitHeight = 1.1f; // resting on top of the cube
+    float angle = orbitFrequency * wavePhase;
+    return glm::vec3(orbitRadius * std::cos(angle), orbitHeight + waveAmplitude * std::fabs(std::sin(waveFrequency * wavePhase)), orbitRadius * std::sin(angle));
+}
+
+SceneState initial_scene_state() {
+    SceneState state;
+    //cube
+    state.positions[OBJECT_CUBE] = glm::vec3(0.0f, -0.55f, 0.0f);
+    state.rotations[OBJECT_CUBE] = glm::vec3(0.5f, 0.5f, 0.0f);
+    state.scales[OBJECT_CUBE] = glm::vec3(0.5f, 0.5f, 0.5f);
+    //diamond
+    state.positions[OBJECT_DIAMOND] = glm::vec3(-1.0f, 0.0f, 0.5f);
+    state.rotations[OBJECT_DIAMOND] = glm::vec3(0.0f, 0.0f, 0.0f);
+    state.scales[OBJECT_DIAMOND] = glm::vec3(0.5f, 0.5f, 0.5f);
+    //star
+    state.positions[OBJECT_STAR] = glm::vec3(1.0f, 0.0f, 0.5f);
+    state.rotations[OBJECT_STAR] = glm::vec3(0.0f, 0.1f, 0.0f);
+    state.scales[OBJECT_STAR] = glm::vec3(0.5f, 0.5f, 0.5f);
+    //sphere
+    state.wavePhase = 0.0f;
+    state.positions[OBJECT_SPHERE] = sphere_orbit_position(state.wavePhase);
+    state.rotations[OBJECT_SPHERE] = glm::vec3(0.1f, 0.1f, 0.0f);
+    state.scales[OBJECT_SPHERE] = glm::vec3(0.7f, 0.7f, 0.7f); // 0.35 in world space at the cube's starting scale
+    return state;
+}
+
+// returns 1 if only the positive key is held, -1 if only the negative one is, otherwise 0
+static float key_axis(const InputFrame& frame, int positiveKey, int negativeKey) {
+    float axis = 0.0f;
+    if (input_key_down(frame, positiveKey))
+        axis += 1.0f;
+    if (input_key_down(frame, negativeKey))
+        axis -= 1.0f;
+    return axis;
+}
+
+SceneInput sample_scene_input(const InputFrame& frame) {
+    SceneInput input;
+    // CUBE
+    input.cubeRotateX = key_axis(frame, GLFW_KEY_KP_8, GLFW_KEY_KP_5);
+    input.cubeRotateY = key_axis(frame, GLFW_KEY_KP_6, GLFW_KEY_KP_4);
+    input.cubeScale = key_axis(frame, GLFW_KEY_KP_ADD, GLFW_KEY_KP_SUBTRACT);
+    //DIAMOND
+    input.diamondRotateX = key_axis(frame, GLFW_KEY_UP, GLFW_KEY_DOWN);
+    input.diamondRotateY = key_axis(frame, GLFW_KEY_RIGHT, GLFW_KEY_LEFT);
+    //SPHERE
+    input.sphereRotateX = key_axis(frame, GLFW_KEY_I, GLFW_KEY_K);
+    input.sphereRotateY = key_axis(frame, GLFW_KEY_L, GLFW_KEY_J);
+    return input;
+}
+
+void simulate_scene(SceneState& state, const SceneInput& input, float step) {
+    const float waveSpeed = 1.5f; // How fast the sphere's wave moves
+
+    // player controlled rotations and scale
+    state.rotations[OBJECT_CUBE] += glm::vec3(1.0f * input.cubeRotateX, 1.0f * input.cubeRotateY, 0.0f);
+    state.scales[OBJECT_CUBE] += glm::vec3(0.01f * input.cubeScale);
+    state.rotations[OBJECT_DIAMOND] += glm::vec3(1.0f * input.diamondRotateX, 1.0f * input.diamondRotateY, 0.0f);
+    state.rotations[OBJECT_SPHERE] += glm::vec3(3.0f * input.sphereRotateX, 3.0f * input.sphereRotateY, 0.0f);
+
+    // constant spins, one increment per step no matter the frame rate
+    state.rotations[OBJECT_DIAMOND].y -= 0.75f;
+    state.rotations[OBJECT_STAR].y += 0.75f;
+    state.rotations[OBJECT_SPHERE] += glm::vec3(0.75f, 0.75f, 0.0f);
+
+    //animate
+    state.wavePhase += waveSpeed * step; // Update the wave phase over time
+    state.positions[OBJECT_SPHERE] = sphere_orbit_position(state.wavePhase);
+}
+
+SceneState interpolate_scene(const SceneState& previous, const SceneState& current, float alpha) {
+    SceneState state;
+    for (int object = 0; object < OBJECT_COUNT; ++object) {
+        state.positions[object] = glm::mix(previous.positions[object], current.positions[object], alpha);
+        state.rotations[object] = glm::mix(previous.rotations[object], current.rotations[object], alpha);
+        state.scales[object] = glm::mix(previous.scales[object], current.scales[object], alpha);
+    }
+    state.wavePhase = glm::mix(previous.wavePhase, current.wavePhase, alpha);
+    state.positions[OBJECT_SPHERE] = sphere_orbit_position(state.wavePhase);
+    return state;
+}
@@ -0,0 +1,46 @@
+#ifndef SIMULATION
+#define SIMULATION
+
+#include <glm.hpp>
+#include "input_recording.h"
+
+#define SIMULATION_RATE 60.0 // fixed simulation steps per second, the per step amounts below were tuned at 60
+
+// The simulated scene objects
+enum SceneObject { OBJECT_CUBE, OBJECT_DIAMOND, OBJECT_STAR, OBJECT_SPHERE, OBJECT_COUNT };
+
+// Object controls held down this frame, taken from the frame's (live or replayed) input and consumed by every simulation step
+typedef struct SceneInput {
+    float cubeRotateX, cubeRotateY, cubeScale; // -1, 0 or 1
+    float diamondRotateX, diamondRotateY;
+    float sphereRotateX, sphereRotateY;
+}SceneInput;
+
+// Everything the simulation advances, rendering only ever sees an interpolation of two of these
+// Transforms are per SceneObject, in the same form as the entity store's components (rotations in degrees) and relative
+// to the object's scene_object_parent
+typedef struct SceneState {
+    glm::vec3 positions[OBJECT_COUNT];
+    glm::vec3 rotations[OBJECT_COUNT];
+    glm::vec3 scales[OBJECT_COUNT];
+    float wavePhase; // Phase shift of the sphere's bounce
+}SceneState;
+
+// Accumulates frame time and hands it out in whole fixed steps
+typedef struct FixedTimestep {
+    double step; // seconds per simulation step
+    double accumulator; // time not yet simulated
+    unsigned int maxStepsPerFrame; // stops a slow frame from snowballing into ever more catch up steps
+}FixedTimestep;
+
+FixedTimestep create_fixed_timestep(double stepsPerSecond, unsigned int maxStepsPerFrame);
+unsigned int advance_fixed_timestep(FixedTimestep& timestep, double frameTime); // returns how many steps to simulate this frame
+float fixed_timestep_alpha(const FixedTimestep& timestep); // how far between the previous and current state rendering is
+
+int scene_object_parent(int object); // the SceneObject the object's transform is relative to, -1 for world space
+SceneState initial_scene_state();
+SceneInput sample_scene_input(const InputFrame& frame);
+void simulate_scene(SceneState& state, const SceneInput& input, float step);
+SceneState interpolate_scene(const SceneState& previous, const SceneState& current, float alpha);
+
+#endif // !SIMULATION
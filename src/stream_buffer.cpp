@@ -0,0 +1,96 @@
+#include <GL/glew.h>
+#include <iostream>
+#include <cstring>
+#include "stream_buffer.h"
+#include "gl_state.h"
+
+StreamBuffer::StreamBuffer(unsigned int frameSize)
+    : frameSize(frameSize), frame(0), head(0), flushed(0), mapped(NULL) {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniformAlignment = (unsigned int)alignment;
+    for (unsigned int i = 0; i < STREAM_BUFFER_FRAMES; ++i)
+        fences[i] = NULL;
+
+    // the buffer is bound as whatever the allocations are used for, the target here only matters for creation
+    glGenBuffers(1, &buffer);
+    gl_bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+    persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, (GLsizeiptr)frameSize * STREAM_BUFFER_FRAMES, NULL, flags);
+        mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)frameSize * STREAM_BUFFER_FRAMES, flags);
+        if (!mapped) {
+            std::cout << "Failed to map the stream buffer, falling back to buffer updates" << std::endl;
+            gl_delete_buffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            gl_bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+            persistent = false;
+        }
+    }
+    if (!persistent) {
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)frameSize * STREAM_BUFFER_FRAMES, NULL, GL_STREAM_DRAW);
+        staging.resize(frameSize);
+    }
+    gl_bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (unsigned int i = 0; i < STREAM_BUFFER_FRAMES; ++i) {
+        if (fences[i])
+            glDeleteSync((GLsync)fences[i]);
+    }
+    if (persistent) {
+        gl_bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        gl_bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    gl_delete_buffers(1, &buffer);
+}
+
+void StreamBuffer::BeginFrame() {
+    head = 0;
+    flushed = 0;
+    // wait for the GPU to finish with this region the last time around, normally it long has
+    GLsync fence = (GLsync)fences[frame];
+    if (fence) {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        glDeleteSync(fence);
+        fences[frame] = NULL;
+    }
+}
+
+void* StreamBuffer::Allocate(unsigned int size, unsigned int alignment, unsigned int& outOffset) {
+    unsigned int start = (head + alignment - 1) / alignment * alignment;
+    if (start + size > frameSize)
+        return NULL;
+    head = start + size;
+    outOffset = frame * frameSize + start;
+    return persistent ? mapped + outOffset : staging.data() + start;
+}
+
+bool StreamBuffer::Write(const void* data, unsigned int size, unsigned int alignment, unsigned int& outOffset) {
+    void* destination = Allocate(size, alignment, outOffset);
+    if (!destination)
+        return false;
+    std::memcpy(destination, data, size);
+    return true;
+}
+
+void StreamBuffer::Flush() {
+    // coherent mappings are visible to the GPU as they are written
+    if (!persistent && head > flushed) {
+        gl_bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, frame * frameSize + flushed, head - flushed, staging.data() + flushed);
+        gl_bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    flushed = head;
+}
+
+void StreamBuffer::EndFrame() {
+    Flush();
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame = (frame + 1) % STREAM_BUFFER_FRAMES;
+}
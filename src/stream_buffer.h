@@ -0,0 +1,41 @@
+#ifndef STREAM_BUFFER
+#define STREAM_BUFFER
+
+#include <vector>
+
+#define STREAM_BUFFER_FRAMES 3 // the CPU can be this many frames ahead of the GPU before it has to wait
+
+// Ring allocator for data that is rewritten every frame (per object constants, dynamic vertices)
+// The buffer is split into one region per frame in flight and fenced at the end of each frame, so BeginFrame only
+// waits if the GPU is still reading the region about to be reused. With GL 4.4 / ARB_buffer_storage the buffer is
+// persistently and coherently mapped and allocations are written with a plain memcpy, otherwise writes go to a CPU
+// copy that Flush hands over with one glBufferSubData.
+class StreamBuffer {
+public:
+	StreamBuffer(unsigned int frameSize);
+	~StreamBuffer();
+
+	void BeginFrame();
+	// reserves size bytes at the given alignment in this frame's region, NULL if the region is full
+	void* Allocate(unsigned int size, unsigned int alignment, unsigned int& outOffset);
+	bool Write(const void* data, unsigned int size, unsigned int alignment, unsigned int& outOffset);
+	void Flush(); // call before drawing from anything allocated since the last flush
+	void EndFrame();
+
+	unsigned int GetBuffer() const { return buffer; }
+	bool IsPersistent() const { return persistent; }
+	unsigned int GetUniformAlignment() const { return uniformAlignment; } // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+
+private:
+	unsigned int buffer;
+	unsigned int frameSize;
+	unsigned int frame; // region being written
+	unsigned int head, flushed; // bytes allocated and bytes handed to GL in this frame's region
+	unsigned int uniformAlignment;
+	bool persistent;
+	unsigned char* mapped; // whole buffer, persistent only
+	std::vector<unsigned char> staging; // one region, fallback only
+	void* fences[STREAM_BUFFER_FRAMES]; // GLsync
+};
+
+#endif // !STREAM_BUFFER
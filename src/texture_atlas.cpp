@@ -0,0 +1,347 @@
+#include "texture_atlas.h"
+
+#include <stb_image.h>
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+#include <sys/stat.h>
+
+#define ATLAS_FILE_MAGIC 0x324C5441 // "ATL2"
+#define ATLAS_MAX_SIZE 16384
+
+typedef struct AtlasRect {
+    int x, y, width, height;
+}AtlasRect;
+
+bool load_atlas_images(const std::vector<std::string>& filenames, std::vector<AtlasImage>& outImages, unsigned int threadCount) {
+    outImages.assign(filenames.size(), AtlasImage());
+    std::vector<char> loaded(filenames.size(), 0);
+    threadCount = std::max(1u, std::min(threadCount, (unsigned int)filenames.size()));
+
+    // each thread decodes every threadCount'th file, stb_image keeps no shared state while loading
+    auto decode = [&](unsigned int first) {
+        for (size_t i = first; i < filenames.size(); i += threadCount) {
+            int width, height, channels;
+            unsigned char* data = stbi_load(filenames[i].c_str(), &width, &height, &channels, 4);
+            if (!data)
+                continue;
+            outImages[i].name = filenames[i];
+            atlas_source_stamp(filenames[i], outImages[i].source);
+            outImages[i].width = width;
+            outImages[i].height = height;
+            outImages[i].pixels.assign(data, data + static_cast<size_t>(width) * height * 4);
+            stbi_image_free(data);
+            loaded[i] = 1;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int thread = 1; thread < threadCount; ++thread)
+        workers.push_back(std::thread(decode, thread));
+    decode(0);
+    for (std::thread& worker : workers)
+        worker.join();
+
+    bool allLoaded = true;
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        if (!loaded[i]) {
+            std::cout << "Failed to load texture: " << filenames[i] << std::endl;
+            allLoaded = false;
+        }
+    }
+    return allLoaded;
+}
+
+// MaxRects with the best short side fit heuristic, sizes must already include gutter and alignment
+static bool maxrects_pack(int binWidth, int binHeight, const std::vector<AtlasRect>& sizes, const std::vector<size_t>& order, std::vector<AtlasRect>& outPlaced) {
+    std::vector<AtlasRect> freeRects(1, AtlasRect{ 0, 0, binWidth, binHeight });
+    outPlaced.assign(sizes.size(), AtlasRect{ 0, 0, 0, 0 });
+
+    for (size_t index : order) {
+        int width = sizes[index].width, height = sizes[index].height;
+        int bestShort = INT_MAX, bestLong = INT_MAX;
+        AtlasRect best = { 0, 0, 0, 0 };
+        for (const AtlasRect& freeRect : freeRects) {
+            if (width > freeRect.width || height > freeRect.height)
+                continue;
+            int leftoverX = freeRect.width - width, leftoverY = freeRect.height - height;
+            int shortSide = std::min(leftoverX, leftoverY), longSide = std::max(leftoverX, leftoverY);
+            if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong)) {
+                bestShort = shortSide;
+                bestLong = longSide;
+                best = AtlasRect{ freeRect.x, freeRect.y, width, height };
+            }
+        }
+        if (bestShort == INT_MAX)
+            return false;
+        outPlaced[index] = best;
+
+        // split every free rect the new one overlaps into the (up to four) maximal rects around it
+        std::vector<AtlasRect> split;
+        for (const AtlasRect& freeRect : freeRects) {
+            if (best.x >= freeRect.x + freeRect.width || best.x + best.width <= freeRect.x ||
+                best.y >= freeRect.y + freeRect.height || best.y + best.height <= freeRect.y) {
+                split.push_back(freeRect);
+                continue;
+            }
+            if (best.x > freeRect.x)
+                split.push_back(AtlasRect{ freeRect.x, freeRect.y, best.x - freeRect.x, freeRect.height });
+            if (best.x + best.width < freeRect.x + freeRect.width)
+                split.push_back(AtlasRect{ best.x + best.width, freeRect.y, freeRect.x + freeRect.width - best.x - best.width, freeRect.height });
+            if (best.y > freeRect.y)
+                split.push_back(AtlasRect{ freeRect.x, freeRect.y, freeRect.width, best.y - freeRect.y });
+            if (best.y + best.height < freeRect.y + freeRect.height)
+                split.push_back(AtlasRect{ freeRect.x, best.y + best.height, freeRect.width, freeRect.y + freeRect.height - best.y - best.height });
+        }
+
+        // drop free rects that sit entirely inside another one
+        freeRects.clear();
+        for (size_t i = 0; i < split.size(); ++i) {
+            bool contained = false;
+            for (size_t j = 0; j < split.size() && !contained; ++j) {
+                if (i == j)
+                    continue;
+                const AtlasRect& a = split[i];
+                const AtlasRect& b = split[j];
+                bool inside = a.x >= b.x && a.y >= b.y && a.x + a.width <= b.x + b.width && a.y + a.height <= b.y + b.height;
+                // of two identical rects keep the first
+                bool identical = a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+                contained = inside && (!identical || j < i);
+            }
+            if (!contained)
+                freeRects.push_back(split[i]);
+        }
+    }
+    return true;
+}
+
+bool pack_texture_atlas(const std::vector<AtlasImage>& images, int padding, int maxSize, unsigned int threadCount, TextureAtlas& outAtlas) {
+    // gutters stay intact down to the mip where the padding shrinks to a single texel
+    unsigned int mipLevels = 1;
+    while ((padding >> mipLevels) > 0)
+        ++mipLevels;
+    int alignment = 1 << (mipLevels - 1);
+
+    std::vector<AtlasRect> sizes;
+    long long totalArea = 0;
+    for (const AtlasImage& image : images) {
+        if (image.width <= 0 || image.height <= 0 || image.pixels.size() < static_cast<size_t>(image.width) * image.height * 4) {
+            std::cout << "ERROR::TEXTURE_ATLAS::EMPTY_IMAGE " << image.name << std::endl;
+            return false;
+        }
+        int width = (image.width + 2 * padding + alignment - 1) / alignment * alignment;
+        int height = (image.height + 2 * padding + alignment - 1) / alignment * alignment;
+        sizes.push_back(AtlasRect{ 0, 0, width, height });
+        totalArea += (long long)width * height;
+    }
+    // biggest first, small images fill the gaps the big ones leave
+    std::vector<size_t> order(images.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return std::max(sizes[a].width, sizes[a].height) > std::max(sizes[b].width, sizes[b].height);
+    });
+
+    // every power of two size that could hold the total area, each packed independently
+    std::vector<AtlasRect> candidates;
+    for (int width = 1; width <= maxSize; width *= 2) {
+        for (int height = 1; height <= maxSize; height *= 2) {
+            if ((long long)width * height >= totalArea && height <= width * 2 && width <= height * 2)
+                candidates.push_back(AtlasRect{ 0, 0, width, height });
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const AtlasRect& a, const AtlasRect& b) {
+        return (long long)a.width * a.height < (long long)b.width * b.height;
+    });
+
+    std::vector<std::vector<AtlasRect>> placements(candidates.size());
+    std::vector<char> fits(candidates.size(), 0);
+    threadCount = std::max(1u, std::min(threadCount, (unsigned int)candidates.size()));
+    auto packCandidates = [&](unsigned int first) {
+        for (size_t i = first; i < candidates.size(); i += threadCount)
+            fits[i] = maxrects_pack(candidates[i].width, candidates[i].height, sizes, order, placements[i]) ? 1 : 0;
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int thread = 1; thread < threadCount; ++thread)
+        workers.push_back(std::thread(packCandidates, thread));
+    packCandidates(0);
+    for (std::thread& worker : workers)
+        worker.join();
+
+    size_t chosen = 0;
+    while (chosen < candidates.size() && !fits[chosen])
+        ++chosen;
+    if (chosen == candidates.size()) {
+        std::cout << "ERROR::TEXTURE_ATLAS::IMAGES_DONT_FIT " << maxSize << "x" << maxSize << std::endl;
+        return false;
+    }
+
+    TextureAtlas& atlas = outAtlas;
+    atlas.width = candidates[chosen].width;
+    atlas.height = candidates[chosen].height;
+    atlas.padding = padding;
+    atlas.mipLevels = mipLevels;
+    atlas.pixels.assign(static_cast<size_t>(atlas.width) * atlas.height * 4, 0);
+    atlas.regions.resize(images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        const AtlasRect& placed = placements[chosen][i];
+        AtlasRegion& region = atlas.regions[i];
+        region.name = images[i].name;
+        region.source = images[i].source;
+        region.x = placed.x + padding;
+        region.y = placed.y + padding;
+        region.width = images[i].width;
+        region.height = images[i].height;
+        region.uvOffset = glm::vec2((float)region.x / atlas.width, (float)region.y / atlas.height);
+        region.uvScale = glm::vec2((float)region.width / atlas.width, (float)region.height / atlas.height);
+    }
+
+    // copy each image with its gutter (edge texels extended outwards), regions never overlap so threads don't either
+    auto blit = [&](unsigned int first) {
+        for (size_t i = first; i < images.size(); i += threadCount) {
+            const AtlasImage& image = images[i];
+            const AtlasRegion& region = atlas.regions[i];
+            for (int y = -padding; y < image.height + padding; ++y) {
+                int sourceY = std::min(std::max(y, 0), image.height - 1);
+                for (int x = -padding; x < image.width + padding; ++x) {
+                    int sourceX = std::min(std::max(x, 0), image.width - 1);
+                    const unsigned char* source = &image.pixels[(static_cast<size_t>(sourceY) * image.width + sourceX) * 4];
+                    unsigned char* destination = &atlas.pixels[(static_cast<size_t>(region.y + y) * atlas.width + region.x + x) * 4];
+                    std::memcpy(destination, source, 4);
+                }
+            }
+        }
+    };
+    threadCount = std::max(1u, std::min(threadCount, (unsigned int)images.size()));
+    workers.clear();
+    for (unsigned int thread = 1; thread < threadCount; ++thread)
+        workers.push_back(std::thread(blit, thread));
+    blit(0);
+    for (std::thread& worker : workers)
+        worker.join();
+    return true;
+}
+
+const AtlasRegion* find_atlas_region(const TextureAtlas& atlas, const std::string& name) {
+    for (const AtlasRegion& region : atlas.regions) {
+        if (region.name == name)
+            return &region;
+    }
+    return NULL;
+}
+
+void remap_mesh_uvs(Mesh& mesh, const AtlasRegion& region) {
+    for (size_t i = 0; i + 4 < mesh.vertices.size(); i += 5) {
+        mesh.vertices[i + 3] = region.uvOffset.x + mesh.vertices[i + 3] * region.uvScale.x;
+        mesh.vertices[i + 4] = region.uvOffset.y + mesh.vertices[i + 4] * region.uvScale.y;
+    }
+}
+
+bool save_texture_atlas(const TextureAtlas& atlas, const char* filename) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to save texture atlas: " << filename << std::endl;
+        return false;
+    }
+
+    int header[6] = { ATLAS_FILE_MAGIC, atlas.width, atlas.height, atlas.padding, (int)atlas.mipLevels, (int)atlas.regions.size() };
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const AtlasRegion& region : atlas.regions) {
+        int fields[5] = { (int)region.name.size(), region.x, region.y, region.width, region.height };
+        long long source[2] = { region.source.size, region.source.modified };
+        file.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+        file.write(reinterpret_cast<const char*>(source), sizeof(source));
+        file.write(region.name.data(), region.name.size());
+    }
+    file.write(reinterpret_cast<const char*>(atlas.pixels.data()), atlas.pixels.size());
+    return file.good();
+}
+
+bool load_texture_atlas(TextureAtlas& atlas, const char* filename) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+    // every count and size in the file is checked against what is left of it before anything gets allocated
+    long long remaining = (long long)file.tellg();
+    file.seekg(0);
+
+    int header[6] = {};
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    remaining -= sizeof(header);
+    if (!file.good() || header[0] != ATLAS_FILE_MAGIC)
+        return false;
+    if (header[1] <= 0 || header[1] > ATLAS_MAX_SIZE || header[2] <= 0 || header[2] > ATLAS_MAX_SIZE ||
+        header[3] < 0 || header[4] < 1 || header[4] > 32 || header[5] < 0) {
+        std::cout << "ERROR::TEXTURE_ATLAS::CORRUPT_FILE " << filename << std::endl;
+        return false;
+    }
+    const long long regionSize = sizeof(int) * 5 + sizeof(long long) * 2;
+    const long long pixelSize = (long long)header[1] * header[2] * 4;
+    if ((long long)header[5] * regionSize + pixelSize > remaining) {
+        std::cout << "ERROR::TEXTURE_ATLAS::TRUNCATED_FILE " << filename << std::endl;
+        return false;
+    }
+    remaining -= (long long)header[5] * regionSize + pixelSize; // what the names may take up
+
+    atlas.width = header[1];
+    atlas.height = header[2];
+    atlas.padding = header[3];
+    atlas.mipLevels = (unsigned int)header[4];
+    atlas.regions.resize(header[5]);
+    for (AtlasRegion& region : atlas.regions) {
+        int fields[5] = {};
+        long long source[2] = {};
+        file.read(reinterpret_cast<char*>(fields), sizeof(fields));
+        file.read(reinterpret_cast<char*>(source), sizeof(source));
+        if (!file.good() || fields[0] < 0 || fields[0] > remaining ||
+            fields[1] < 0 || fields[2] < 0 || fields[3] < 0 || fields[4] < 0 ||
+            fields[1] + fields[3] > atlas.width || fields[2] + fields[4] > atlas.height) {
+            std::cout << "ERROR::TEXTURE_ATLAS::CORRUPT_FILE " << filename << std::endl;
+            atlas.regions.clear();
+            return false;
+        }
+        remaining -= fields[0];
+        region.name.resize(fields[0]);
+        file.read(&region.name[0], fields[0]);
+        region.source.size = source[0];
+        region.source.modified = source[1];
+        region.x = fields[1];
+        region.y = fields[2];
+        region.width = fields[3];
+        region.height = fields[4];
+        region.uvOffset = glm::vec2((float)region.x / atlas.width, (float)region.y / atlas.height);
+        region.uvScale = glm::vec2((float)region.width / atlas.width, (float)region.height / atlas.height);
+    }
+    atlas.pixels.resize(static_cast<size_t>(pixelSize));
+    file.read(reinterpret_cast<char*>(atlas.pixels.data()), atlas.pixels.size());
+    return file.good();
+}
+
+bool atlas_source_stamp(const std::string& filename, AtlasSourceStamp& outStamp) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        outStamp.size = outStamp.modified = -1;
+        return false;
+    }
+    outStamp.size = (long long)info.st_size;
+    outStamp.modified = (long long)info.st_mtime;
+    return true;
+}
+
+bool texture_atlas_up_to_date(const TextureAtlas& atlas, const std::vector<std::string>& filenames) {
+    for (const std::string& filename : filenames) {
+        const AtlasRegion* region = find_atlas_region(atlas, filename);
+        AtlasSourceStamp stamp;
+        // a file that is still missing was left out when packing, one that showed up needs a repack
+        if (!atlas_source_stamp(filename, stamp)) {
+            if (region)
+                return false;
+            continue;
+        }
+        if (!region || stamp.size != region->source.size || stamp.modified != region->source.modified)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef TEXTURE_ATLAS
+#define TEXTURE_ATLAS
+
+#include <vector>
+#include <string>
+#include <glm.hpp>
+#include "mesh.h"
+
+// Size and modification time of an image file, a cached atlas is only reused while every source still matches
+typedef struct AtlasSourceStamp {
+    long long size, modified;
+}AtlasSourceStamp;
+
+// A decoded RGBA8 image waiting to be packed
+typedef struct AtlasImage {
+    std::string name;
+    AtlasSourceStamp source;
+    int width, height;
+    std::vector<unsigned char> pixels;
+}AtlasImage;
+
+// Where an image ended up, x/y/width/height cover the image itself without its gutter
+typedef struct AtlasRegion {
+    std::string name;
+    AtlasSourceStamp source;
+    int x, y, width, height;
+    glm::vec2 uvOffset, uvScale; // atlas uv = uvOffset + image uv * uvScale
+}AtlasRegion;
+
+// Images packed into one RGBA8 texture with MaxRects (best short side fit)
+// Every image is surrounded by a gutter of its own edge texels padding texels wide and starts on a multiple of
+// 2^(mipLevels - 1), so the first mipLevels mip levels still have at least one texel of gutter and never blend in a
+// neighbour. Nothing clamps to the region though, the texture keeps its library's repeat wrapping, so only uvs inside
+// 0..1 stay in the image and meshes mapped into an atlas can't rely on repeating uvs.
+typedef struct TextureAtlas {
+    int width, height;
+    int padding;
+    unsigned int mipLevels; // levels that keep a gutter, the texture shouldn't use more
+    std::vector<unsigned char> pixels;
+    std::vector<AtlasRegion> regions;
+}TextureAtlas;
+
+// Decodes the files on threadCount threads, false if any of them couldn't be read
+bool load_atlas_images(const std::vector<std::string>& filenames, std::vector<AtlasImage>& outImages, unsigned int threadCount);
+// Tries every power of two atlas size up to maxSize on threadCount threads and keeps the smallest one everything fits in
+bool pack_texture_atlas(const std::vector<AtlasImage>& images, int padding, int maxSize, unsigned int threadCount, TextureAtlas& outAtlas);
+const AtlasRegion* find_atlas_region(const TextureAtlas& atlas, const std::string& name); // NULL if it isn't in the atlas
+
+// Moves the mesh's texture coordinates (position + texture coordinate layout) into the region
+void remap_mesh_uvs(Mesh& mesh, const AtlasRegion& region);
+
+// Binary cache so the packing only has to run when the image set changes
+bool save_texture_atlas(const TextureAtlas& atlas, const char* filename);
+bool load_texture_atlas(TextureAtlas& atlas, const char* filename); // false for a missing, truncated or corrupt file
+bool atlas_source_stamp(const std::string& filename, AtlasSourceStamp& outStamp); // false if the file can't be found
+// True when every file has a region whose stamp still matches the file on disk
+bool texture_atlas_up_to_date(const TextureAtlas& atlas, const std::vector<std::string>& filenames);
+
+#endif // !TEXTURE_ATLAS
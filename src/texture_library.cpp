@@ -0,0 +1,147 @@
+#include <GL/glew.h>
+#include <stb_image.h>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <glm.hpp>
+#include "texture_library.h"
+#include "gl_state.h"
+
+TextureLibrary::TextureLibrary() : materialBuffer(0), bindless(false) {
+}
+
+TextureLibrary::~TextureLibrary() {
+    for (TextureArray& array : arrays) {
+        if (bindless)
+            glMakeTextureHandleNonResidentARB(array.handle);
+        gl_delete_textures(1, &array.texture);
+    }
+    if (materialBuffer)
+        gl_delete_buffers(1, &materialBuffer);
+}
+
+unsigned int TextureLibrary::AddTexture(const char* filename) {
+    TextureSource source = { filename, 0, 0, std::vector<unsigned char>(), 0 };
+    sources.push_back(source);
+    return (unsigned int)(sources.size() - 1);
+}
+
+unsigned int TextureLibrary::AddImage(const char* name, int width, int height, const std::vector<unsigned char>& pixels, unsigned int mipLevels) {
+    TextureSource source = { name, width, height, pixels, mipLevels };
+    sources.push_back(source);
+    return (unsigned int)(sources.size() - 1);
+}
+
+bool TextureLibrary::Build(bool allowBindless) {
+    if (sources.size() > TEXTURE_LIBRARY_MAX_MATERIALS) {
+        std::cout << "ERROR::TEXTURE_LIBRARY::TOO_MANY_MATERIALS" << std::endl;
+        return false;
+    }
+
+    // load everything first so each array knows its layer count before it is allocated
+    typedef struct Image {
+        unsigned char* pixels;
+        int width, height;
+        bool owned; // allocated here rather than borrowed from the source
+    }Image;
+    std::vector<Image> images(sources.size());
+    std::vector<glm::uvec4> materials(TEXTURE_LIBRARY_MAX_MATERIALS + TEXTURE_LIBRARY_MAX_ARRAYS, glm::uvec4(0));
+    std::vector<unsigned int> layerCounts;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (!sources[i].pixels.empty()) {
+            images[i].pixels = sources[i].pixels.data();
+            images[i].width = sources[i].width;
+            images[i].height = sources[i].height;
+            images[i].owned = false;
+        } else {
+            int channels;
+            images[i].pixels = stbi_load(sources[i].filename.c_str(), &images[i].width, &images[i].height, &channels, 4);
+            images[i].owned = true;
+        }
+        if (!images[i].pixels) {
+            // keep the material valid with a single white texel, matching what a missing texture looked like before
+            std::cout << "Failed to load texture: " << sources[i].filename << std::endl;
+            images[i].pixels = (unsigned char*)std::malloc(4);
+            std::memset(images[i].pixels, 255, 4);
+            images[i].width = images[i].height = 1;
+        }
+
+        size_t array = 0;
+        while (array < arrays.size() && (arrays[array].width != images[i].width || arrays[array].height != images[i].height))
+            ++array;
+        if (array == arrays.size()) {
+            if (arrays.size() == TEXTURE_LIBRARY_MAX_ARRAYS) {
+                std::cout << "ERROR::TEXTURE_LIBRARY::TOO_MANY_SIZES" << std::endl;
+                for (size_t loaded = 0; loaded <= i; ++loaded) {
+                    if (images[loaded].owned)
+                        stbi_image_free(images[loaded].pixels);
+                }
+                return false;
+            }
+            TextureArray newArray = { 0, images[i].width, images[i].height, 0, 0 };
+            arrays.push_back(newArray);
+            layerCounts.push_back(0);
+        }
+        unsigned int& mipLevels = arrays[array].mipLevels;
+        if (sources[i].mipLevels && (!mipLevels || sources[i].mipLevels < mipLevels))
+            mipLevels = sources[i].mipLevels;
+        materials[i] = glm::uvec4((unsigned int)array, layerCounts[array]++, 0, 0);
+    }
+
+    for (size_t array = 0; array < arrays.size(); ++array) {
+        TextureArray& textureArray = arrays[array];
+        glGenTextures(1, &textureArray.texture);
+        gl_bind_texture(GL_TEXTURE_2D_ARRAY, textureArray.texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, textureArray.width, textureArray.height, layerCounts[array], 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        for (size_t i = 0; i < images.size(); ++i) {
+            if (materials[i].x == array)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, materials[i].y, textureArray.width, textureArray.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, images[i].pixels);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (textureArray.mipLevels)
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)textureArray.mipLevels - 1);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+    gl_bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+    for (Image& image : images) {
+        if (image.owned)
+            stbi_image_free(image.pixels);
+    }
+
+    // bindless handles are fixed once taken, so every parameter has to be set before this
+    bindless = allowBindless && GLEW_ARB_bindless_texture;
+    for (size_t array = 0; bindless && array < arrays.size(); ++array) {
+        arrays[array].handle = glGetTextureHandleARB(arrays[array].texture);
+        glMakeTextureHandleResidentARB(arrays[array].handle);
+        materials[TEXTURE_LIBRARY_MAX_MATERIALS + array] = glm::uvec4((unsigned int)(arrays[array].handle & 0xFFFFFFFFu), (unsigned int)(arrays[array].handle >> 32), 0, 0);
+    }
+
+    glGenBuffers(1, &materialBuffer);
+    gl_bind_buffer(GL_UNIFORM_BUFFER, materialBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, materials.size() * sizeof(glm::uvec4), materials.data(), GL_STATIC_DRAW);
+    gl_bind_buffer(GL_UNIFORM_BUFFER, 0);
+    return true;
+}
+
+void TextureLibrary::Bind() {
+    gl_bind_buffer_base(GL_UNIFORM_BUFFER, MATERIAL_UNIFORM_BINDING, materialBuffer);
+    if (!bindless)
+        BindArrays();
+}
+
+void TextureLibrary::BindArrays() {
+    for (size_t array = 0; array < arrays.size(); ++array) {
+        gl_active_texture(GL_TEXTURE0 + (GLenum)array);
+        gl_bind_texture(GL_TEXTURE_2D_ARRAY, arrays[array].texture);
+    }
+    gl_active_texture(GL_TEXTURE0);
+}
+
+void bind_material_uniform_block(unsigned int shaderProgram) {
+    unsigned int blockIndex = glGetUniformBlockIndex(shaderProgram, "MaterialTable");
+    if (blockIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(shaderProgram, blockIndex, MATERIAL_UNIFORM_BINDING);
+}
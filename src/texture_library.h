@@ -0,0 +1,97 @@
+#ifndef TEXTURE_LIBRARY
+#define TEXTURE_LIBRARY
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#define TEXTURE_LIBRARY_MAX_ARRAYS 8
+#define TEXTURE_LIBRARY_MAX_MATERIALS 64
+#define MATERIAL_UNIFORM_BINDING 2 // uniform buffer binding point of the material table
+
+// GLSL declaration of the material table, material i samples layer materials[i].y of texture array materials[i].x,
+// arrayHandles[a].xy is array a's bindless handle (unused without bindless textures)
+#define MATERIAL_TABLE_GLSL \
+"layout (std140) uniform MaterialTable\n" \
+"{\n" \
+"   uvec4 materials[64];\n" \
+"   uvec4 arrayHandles[8];\n" \
+"};\n"
+
+// GLSL sampleMaterial(material, uv) for texture arrays bound to units 0-7 (GLSL 3.30+)
+// the array can change between neighbouring fragments of different draws, so each array is indexed with a constant
+// and sampled with derivatives taken outside the branch
+#define MATERIAL_SAMPLE_GLSL \
+MATERIAL_TABLE_GLSL \
+"uniform sampler2DArray textureArrays[8];\n" \
+"vec4 sampleMaterial(uint material, vec2 uv)\n" \
+"{\n" \
+"   uvec4 entry = materials[material];\n" \
+"   vec3 coord = vec3(uv, float(entry.y));\n" \
+"   vec2 dx = dFdx(uv);\n" \
+"   vec2 dy = dFdy(uv);\n" \
+"   switch (entry.x) {\n" \
+"   case 0u: return textureGrad(textureArrays[0], coord, dx, dy);\n" \
+"   case 1u: return textureGrad(textureArrays[1], coord, dx, dy);\n" \
+"   case 2u: return textureGrad(textureArrays[2], coord, dx, dy);\n" \
+"   case 3u: return textureGrad(textureArrays[3], coord, dx, dy);\n" \
+"   case 4u: return textureGrad(textureArrays[4], coord, dx, dy);\n" \
+"   case 5u: return textureGrad(textureArrays[5], coord, dx, dy);\n" \
+"   case 6u: return textureGrad(textureArrays[6], coord, dx, dy);\n" \
+"   default: return textureGrad(textureArrays[7], coord, dx, dy);\n" \
+"   }\n" \
+"}\n"
+
+// GLSL sampleMaterial(material, uv) through bindless handles, needs #extension GL_ARB_bindless_texture : require
+// The material has to be dynamically uniform (the same for the whole draw) unless GL_NV_gpu_shader5 is enabled too
+#define MATERIAL_SAMPLE_BINDLESS_GLSL \
+MATERIAL_TABLE_GLSL \
+"vec4 sampleMaterial(uint material, vec2 uv)\n" \
+"{\n" \
+"   uvec4 entry = materials[material];\n" \
+"   return texture(sampler2DArray(arrayHandles[entry.x].xy), vec3(uv, float(entry.y)));\n" \
+"}\n"
+
+// Textures grouped into GL_TEXTURE_2D_ARRAYs by size (everything is loaded as RGBA8), one layer per material
+// With ARB_bindless_texture each array is made resident once and shaders reach it through its handle, otherwise
+// the arrays are bound to units 0-7 once per frame, either way drawing a different material binds nothing.
+class TextureLibrary {
+public:
+	TextureLibrary();
+	~TextureLibrary();
+
+	unsigned int AddTexture(const char* filename); // returns the material index, loaded by Build
+	// RGBA8 pixels already in memory (e.g. a texture atlas), mipLevels limits the mip chain of the array it lands in
+	unsigned int AddImage(const char* name, int width, int height, const std::vector<unsigned char>& pixels, unsigned int mipLevels);
+	bool Build(bool allowBindless); // loads every texture, uploads the arrays and the material table
+	void Bind(); // binds the material table, and the arrays when they aren't bindless
+	void BindArrays(); // binds the arrays to units 0-7 even when they are bindless, for shaders that can't use the handles
+
+	bool IsBindless() const { return bindless; }
+	unsigned int GetMaterialCount() const { return (unsigned int)sources.size(); }
+	unsigned int GetArrayCount() const { return (unsigned int)arrays.size(); }
+
+private:
+	typedef struct TextureSource {
+	    std::string filename; // loaded by Build when pixels is empty
+	    int width, height;
+	    std::vector<unsigned char> pixels;
+	    unsigned int mipLevels; // 0 for a full chain
+	}TextureSource;
+
+	typedef struct TextureArray {
+	    unsigned int texture;
+	    int width, height;
+	    unsigned int mipLevels; // the fewest any of its layers allows, 0 for a full chain
+	    uint64_t handle; // bindless only
+	}TextureArray;
+
+	std::vector<TextureSource> sources;
+	std::vector<TextureArray> arrays;
+	unsigned int materialBuffer;
+	bool bindless;
+};
+
+void bind_material_uniform_block(unsigned int shaderProgram); // points a program's MaterialTable block at its binding
+
+#endif // !TEXTURE_LIBRARY
@@ -0,0 +1,131 @@
+#include "transform_batch.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORM_BATCH_SSE
+#endif
+
+void resize_trs_batch(TRSBatch& batch, unsigned int count) {
+    batch.count = count;
+    batch.positionX.resize(count, 0.0f);
+    batch.positionY.resize(count, 0.0f);
+    batch.positionZ.resize(count, 0.0f);
+    batch.rotationX.resize(count, 0.0f);
+    batch.rotationY.resize(count, 0.0f);
+    batch.rotationZ.resize(count, 0.0f);
+    batch.rotationW.resize(count, 1.0f);
+    batch.scaleX.resize(count, 1.0f);
+    batch.scaleY.resize(count, 1.0f);
+    batch.scaleZ.resize(count, 1.0f);
+}
+
+void set_trs(TRSBatch& batch, unsigned int index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    batch.positionX[index] = position.x;
+    batch.positionY[index] = position.y;
+    batch.positionZ[index] = position.z;
+    batch.rotationX[index] = rotation.x;
+    batch.rotationY[index] = rotation.y;
+    batch.rotationZ[index] = rotation.z;
+    batch.rotationW[index] = rotation.w;
+    batch.scaleX[index] = scale.x;
+    batch.scaleY[index] = scale.y;
+    batch.scaleZ[index] = scale.z;
+}
+
+glm::quat euler_degrees_to_quat(const glm::vec3& rotation) {
+    return glm::angleAxis(glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f))
+        * glm::angleAxis(glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f))
+        * glm::angleAxis(glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+// the rotation matrix's columns from the quaternion (same as glm::mat3_cast), each scaled by its axis' scale, and the
+// position as the last column
+static void compose_trs_matrix(const TRSBatch& batch, unsigned int i, float* out) {
+    float x = batch.rotationX[i], y = batch.rotationY[i], z = batch.rotationZ[i], w = batch.rotationW[i];
+    float xx = x * x * 2.0f, yy = y * y * 2.0f, zz = z * z * 2.0f;
+    float xy = x * y * 2.0f, xz = x * z * 2.0f, yz = y * z * 2.0f;
+    float wx = w * x * 2.0f, wy = w * y * 2.0f, wz = w * z * 2.0f;
+    float sx = batch.scaleX[i], sy = batch.scaleY[i], sz = batch.scaleZ[i];
+    out[0] = (1.0f - yy - zz) * sx; out[1] = (xy + wz) * sx; out[2] = (xz - wy) * sx; out[3] = 0.0f;
+    out[4] = (xy - wz) * sy; out[5] = (1.0f - xx - zz) * sy; out[6] = (yz + wx) * sy; out[7] = 0.0f;
+    out[8] = (xz + wy) * sz; out[9] = (yz - wx) * sz; out[10] = (1.0f - xx - yy) * sz; out[11] = 0.0f;
+    out[12] = batch.positionX[i]; out[13] = batch.positionY[i]; out[14] = batch.positionZ[i]; out[15] = 1.0f;
+}
+
+#if defined(__AVX__)
+// a, b, c and d hold one matrix element each for 8 objects, transposes them into one 4 float column per object
+static inline void store_columns(__m256 a, __m256 b, __m256 c, __m256 d, float* out, unsigned int stride) {
+    __m256 ab0 = _mm256_unpacklo_ps(a, b), ab1 = _mm256_unpackhi_ps(a, b);
+    __m256 cd0 = _mm256_unpacklo_ps(c, d), cd1 = _mm256_unpackhi_ps(c, d);
+    __m256 columns[4] = {
+        _mm256_shuffle_ps(ab0, cd0, _MM_SHUFFLE(1, 0, 1, 0)), // objects 0 and 4
+        _mm256_shuffle_ps(ab0, cd0, _MM_SHUFFLE(3, 2, 3, 2)), // 1 and 5
+        _mm256_shuffle_ps(ab1, cd1, _MM_SHUFFLE(1, 0, 1, 0)), // 2 and 6
+        _mm256_shuffle_ps(ab1, cd1, _MM_SHUFFLE(3, 2, 3, 2)), // 3 and 7
+    };
+    for (unsigned int object = 0; object < 4; ++object) {
+        _mm_storeu_ps(out + object * stride, _mm256_castps256_ps128(columns[object]));
+        _mm_storeu_ps(out + (object + 4) * stride, _mm256_extractf128_ps(columns[object], 1));
+    }
+}
+#elif defined(TRANSFORM_BATCH_SSE)
+// same for 4 objects
+static inline void store_columns(__m128 a, __m128 b, __m128 c, __m128 d, float* out, unsigned int stride) {
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    _mm_storeu_ps(out, a);
+    _mm_storeu_ps(out + stride, b);
+    _mm_storeu_ps(out + 2 * stride, c);
+    _mm_storeu_ps(out + 3 * stride, d);
+}
+#endif
+
+void compose_trs_matrices(const TRSBatch& batch, unsigned int begin, unsigned int end, float* out, unsigned int stride) {
+    unsigned int i = begin;
+#if defined(__AVX__)
+    const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(&batch.rotationX[i]), y = _mm256_loadu_ps(&batch.rotationY[i]);
+        __m256 z = _mm256_loadu_ps(&batch.rotationZ[i]), w = _mm256_loadu_ps(&batch.rotationW[i]);
+        __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+        __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+        __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+        __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+        __m256 sx = _mm256_loadu_ps(&batch.scaleX[i]), sy = _mm256_loadu_ps(&batch.scaleY[i]), sz = _mm256_loadu_ps(&batch.scaleZ[i]);
+
+        float* matrices = out + (i - begin) * stride;
+        store_columns(_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx), _mm256_mul_ps(_mm256_add_ps(xy, wz), sx),
+            _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx), zero, matrices, stride);
+        store_columns(_mm256_mul_ps(_mm256_sub_ps(xy, wz), sy), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy),
+            _mm256_mul_ps(_mm256_add_ps(yz, wx), sy), zero, matrices + 4, stride);
+        store_columns(_mm256_mul_ps(_mm256_add_ps(xz, wy), sz), _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz),
+            _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz), zero, matrices + 8, stride);
+        store_columns(_mm256_loadu_ps(&batch.positionX[i]), _mm256_loadu_ps(&batch.positionY[i]), _mm256_loadu_ps(&batch.positionZ[i]), one,
+            matrices + 12, stride);
+    }
+#elif defined(TRANSFORM_BATCH_SSE)
+    const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(&batch.rotationX[i]), y = _mm_loadu_ps(&batch.rotationY[i]);
+        __m128 z = _mm_loadu_ps(&batch.rotationZ[i]), w = _mm_loadu_ps(&batch.rotationW[i]);
+        __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+        __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+        __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+        __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+        __m128 sx = _mm_loadu_ps(&batch.scaleX[i]), sy = _mm_loadu_ps(&batch.scaleY[i]), sz = _mm_loadu_ps(&batch.scaleZ[i]);
+
+        float* matrices = out + (i - begin) * stride;
+        store_columns(_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx), _mm_mul_ps(_mm_add_ps(xy, wz), sx),
+            _mm_mul_ps(_mm_sub_ps(xz, wy), sx), zero, matrices, stride);
+        store_columns(_mm_mul_ps(_mm_sub_ps(xy, wz), sy), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy),
+            _mm_mul_ps(_mm_add_ps(yz, wx), sy), zero, matrices + 4, stride);
+        store_columns(_mm_mul_ps(_mm_add_ps(xz, wy), sz), _mm_mul_ps(_mm_sub_ps(yz, wx), sz),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz), zero, matrices + 8, stride);
+        store_columns(_mm_loadu_ps(&batch.positionX[i]), _mm_loadu_ps(&batch.positionY[i]), _mm_loadu_ps(&batch.positionZ[i]), one,
+            matrices + 12, stride);
+    }
+#endif
+    for (; i < end; ++i)
+        compose_trs_matrix(batch, i, out + (i - begin) * stride);
+}
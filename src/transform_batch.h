@@ -0,0 +1,26 @@
+#ifndef TRANSFORM_BATCH
+#define TRANSFORM_BATCH
+
+#include <vector>
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+// Position, rotation and scale of many objects as structure of arrays, laid out so a batch of them can be turned into
+// model matrices 8 (AVX) or 4 (SSE) objects at a time
+typedef struct TRSBatch {
+    unsigned int count;
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW; // unit quaternion
+    std::vector<float> scaleX, scaleY, scaleZ;
+}TRSBatch;
+
+void resize_trs_batch(TRSBatch& batch, unsigned int count);
+void set_trs(TRSBatch& batch, unsigned int index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+glm::quat euler_degrees_to_quat(const glm::vec3& rotation); // the rotation of rotateX * rotateY * rotateZ
+
+// Writes translate * rotate * scale of the objects in [begin, end) as column major 4x4 floats, object i's matrix at
+// out + (i - begin) * stride floats. Builds the matrix straight from the quaternion instead of multiplying a chain of
+// 4x4s, and out can be anything holding mat4s, an array of glm::mat4 (stride 16) or a mapped instance or uniform buffer
+void compose_trs_matrices(const TRSBatch& batch, unsigned int begin, unsigned int end, float* out, unsigned int stride);
+
+#endif // !TRANSFORM_BATCH
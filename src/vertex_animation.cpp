@@ -0,0 +1,204 @@
+#include "vertex_animation.h"
+
+#include <GL/glew.h>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+#include <gtc/matrix_transform.hpp>
+#include "camera_uniforms.h"
+#include "gl_state.h"
+
+//VAT VERTEX SHADER
+const char* vatVertexShaderSource = "#version 330 core\n"
+"layout (location = 2) in vec2 aTexCord;\n"
+"layout (location = 3) in vec4 aInstance; // xyz = world offset, w = time offset\n"
+"out vec2 TexCoord;\n"
+"out vec3 Normal;\n"
+CAMERA_UNIFORM_BLOCK_GLSL
+"uniform sampler2D vatPositions;\n"
+"uniform sampler2D vatNormals;\n"
+"uniform float time;\n"
+"uniform float duration;\n"
+"uniform float scale;\n"
+"uniform int frameCount;\n"
+"uniform int textureWidth;\n"
+"uniform int rowsPerFrame;\n"
+"ivec2 vatTexel(int frame)\n"
+"{\n"
+"   return ivec2(gl_VertexID % textureWidth, frame * rowsPerFrame + gl_VertexID / textureWidth);\n"
+"}\n"
+"void main()\n"
+"{\n"
+"   float loopTime = mod(time + aInstance.w, duration) / duration * float(frameCount);\n"
+"   int frameA = int(floor(loopTime)) % frameCount;\n"
+"   int frameB = (frameA + 1) % frameCount;\n"
+"   float blend = fract(loopTime);\n"
+"   vec3 position = mix(texelFetch(vatPositions, vatTexel(frameA), 0).xyz, texelFetch(vatPositions, vatTexel(frameB), 0).xyz, blend);\n"
+"   Normal = normalize(mix(texelFetch(vatNormals, vatTexel(frameA), 0).xyz, texelFetch(vatNormals, vatTexel(frameB), 0).xyz, blend));\n"
+"   gl_Position = viewProjection * vec4(position * scale + aInstance.xyz, 1.0);\n"
+"   TexCoord = aTexCord;\n"
+"}\0";
+
+//VAT FRAGMENT SHADER
+const char* vatFragmentShaderSource = "#version 330 core\n"
+"out vec4 FragColor;\n"
+"in vec2 TexCoord;\n"
+"in vec3 Normal;\n"
+"uniform sampler2D texture1;\n"
+"void main()\n"
+"{\n"
+"   float light = 0.35 + 0.65 * max(dot(normalize(Normal), normalize(vec3(0.4, 1.0, 0.6))), 0.0);\n"
+"   FragColor = vec4(texture(texture1, TexCoord).rgb * light, 1.0);\n"
+"}\n\0";
+
+static const unsigned int VAT_MAX_TEXTURE_WIDTH = 1024; // keeps large meshes well inside GL_MAX_TEXTURE_SIZE
+static const unsigned int VAT_FILE_MAGIC = 0x31544156; // "VAT1"
+
+VertexAnimation bake_vertex_animation(const Mesh& mesh, unsigned int frameCount, float duration, const DeformFunction& deform) {
+    VertexAnimation animation;
+    animation.vertexCount = static_cast<unsigned int>(mesh.vertices.size() / 5);
+    animation.frameCount = frameCount;
+    animation.textureWidth = animation.vertexCount < VAT_MAX_TEXTURE_WIDTH ? animation.vertexCount : VAT_MAX_TEXTURE_WIDTH;
+    if (animation.textureWidth == 0)
+        animation.textureWidth = 1;
+    animation.rowsPerFrame = (animation.vertexCount + animation.textureWidth - 1) / animation.textureWidth;
+    animation.duration = duration;
+
+    size_t texelCount = static_cast<size_t>(animation.textureWidth) * animation.rowsPerFrame * frameCount;
+    animation.positions.assign(texelCount * 4, 0.0f);
+    animation.normals.assign(texelCount * 4, 0.0f);
+
+    std::vector<glm::vec3> framePositions(animation.vertexCount);
+    std::vector<glm::vec3> frameNormals(animation.vertexCount);
+
+    for (unsigned int frame = 0; frame < frameCount; ++frame) {
+        float time = duration * frame / frameCount; // the last frame blends back into frame 0 so the loop is seamless
+        deform(mesh, time, framePositions);
+
+        // area weighted vertex normals from the deformed triangles
+        std::fill(frameNormals.begin(), frameNormals.end(), glm::vec3(0.0f));
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            unsigned int a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+            glm::vec3 faceNormal = glm::cross(framePositions[b] - framePositions[a], framePositions[c] - framePositions[a]);
+            frameNormals[a] += faceNormal;
+            frameNormals[b] += faceNormal;
+            frameNormals[c] += faceNormal;
+        }
+
+        size_t frameStart = static_cast<size_t>(frame) * animation.rowsPerFrame * animation.textureWidth;
+        for (unsigned int v = 0; v < animation.vertexCount; ++v) {
+            glm::vec3 normal = glm::length(frameNormals[v]) > 0.0f ? glm::normalize(frameNormals[v]) : glm::vec3(0.0f, 1.0f, 0.0f);
+            size_t texel = (frameStart + v) * 4;
+            animation.positions[texel + 0] = framePositions[v].x;
+            animation.positions[texel + 1] = framePositions[v].y;
+            animation.positions[texel + 2] = framePositions[v].z;
+            animation.positions[texel + 3] = 1.0f;
+            animation.normals[texel + 0] = normal.x;
+            animation.normals[texel + 1] = normal.y;
+            animation.normals[texel + 2] = normal.z;
+        }
+    }
+
+    return animation;
+}
+
+DeformFunction make_sway_skinning(const Mesh& mesh, float swayDegrees, float duration) {
+    // find the vertical extent of the mesh to place the hip bone
+    float minY = 0.0f, maxY = 0.0f;
+    for (size_t i = 1; i < mesh.vertices.size(); i += 5) {
+        if (i == 1 || mesh.vertices[i] < minY) minY = mesh.vertices[i];
+        if (i == 1 || mesh.vertices[i] > maxY) maxY = mesh.vertices[i];
+    }
+    float hipY = minY + (maxY - minY) * 0.45f;
+    float blendHeight = (maxY - minY) * 0.15f; // weights fade between the bones over this band
+
+    return [=](const Mesh& skinned, float time, std::vector<glm::vec3>& outPositions) {
+        const float PI = 3.14159265359f;
+        float phase = 2.0f * PI * time / duration;
+        glm::vec3 hip(0.0f, hipY, 0.0f);
+
+        // bone 0 is the planted root (identity), bone 1 swings the upper body about the hip
+        glm::mat4 upperBone = glm::translate(glm::mat4(1.0f), hip);
+        upperBone = glm::rotate(upperBone, glm::radians(swayDegrees * std::sin(phase)), glm::vec3(0.0f, 0.0f, 1.0f));
+        upperBone = glm::rotate(upperBone, glm::radians(swayDegrees * 0.5f * std::sin(phase * 2.0f)), glm::vec3(1.0f, 0.0f, 0.0f));
+        upperBone = glm::translate(upperBone, -hip);
+
+        for (size_t v = 0; v < outPositions.size(); ++v) {
+            glm::vec3 rest(skinned.vertices[v * 5 + 0], skinned.vertices[v * 5 + 1], skinned.vertices[v * 5 + 2]);
+            float weight = glm::clamp((rest.y - hipY) / blendHeight + 0.5f, 0.0f, 1.0f);
+            glm::vec3 swayed = glm::vec3(upperBone * glm::vec4(rest, 1.0f));
+            outPositions[v] = glm::mix(rest, swayed, weight);
+        }
+    };
+}
+
+bool save_vertex_animation(const VertexAnimation& animation, const char* filename) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to save vertex animation: " << filename << std::endl;
+        return false;
+    }
+
+    unsigned int header[5] = { VAT_FILE_MAGIC, animation.vertexCount, animation.frameCount, animation.textureWidth, animation.rowsPerFrame };
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(&animation.duration), sizeof(float));
+    file.write(reinterpret_cast<const char*>(animation.positions.data()), animation.positions.size() * sizeof(float));
+    file.write(reinterpret_cast<const char*>(animation.normals.data()), animation.normals.size() * sizeof(float));
+    return file.good();
+}
+
+bool load_vertex_animation(VertexAnimation& animation, const char* filename) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+    unsigned long long fileSize = (unsigned long long)file.tellg();
+    file.seekg(0);
+
+    unsigned int header[5] = {};
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file.good() || header[0] != VAT_FILE_MAGIC)
+        return false;
+
+    // the layout has to hold every vertex and the payload (positions and normals, one RGBA32F texel per vertex and
+    // frame) has to be exactly what is left of the file, all checked before anything is allocated
+    const unsigned long long texelBytes = 2 * 4 * sizeof(float);
+    unsigned long long payloadSize = fileSize >= sizeof(header) + sizeof(float) ? fileSize - sizeof(header) - sizeof(float) : 0;
+    unsigned long long texelsPerFrame = (unsigned long long)header[3] * header[4];
+    if (header[1] == 0 || header[2] == 0 || texelsPerFrame < header[1] ||
+        texelsPerFrame > payloadSize / texelBytes / header[2] || texelsPerFrame * header[2] * texelBytes != payloadSize) {
+        std::cout << "ERROR::VERTEX_ANIMATION::CORRUPT_FILE " << filename << std::endl;
+        return false;
+    }
+
+    animation.vertexCount = header[1];
+    animation.frameCount = header[2];
+    animation.textureWidth = header[3];
+    animation.rowsPerFrame = header[4];
+    file.read(reinterpret_cast<char*>(&animation.duration), sizeof(float));
+
+    size_t floatCount = static_cast<size_t>(texelsPerFrame * header[2] * 4);
+    animation.positions.resize(floatCount);
+    animation.normals.resize(floatCount);
+    file.read(reinterpret_cast<char*>(animation.positions.data()), floatCount * sizeof(float));
+    file.read(reinterpret_cast<char*>(animation.normals.data()), floatCount * sizeof(float));
+    return file.good();
+}
+
+// create one RGBA32F texture with nearest filtering, the shader does its own frame blending
+static unsigned int create_vat_texture(const VertexAnimation& animation, const std::vector<float>& data) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    gl_bind_texture(GL_TEXTURE_2D, textureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, animation.textureWidth, animation.rowsPerFrame * animation.frameCount, 0, GL_RGBA, GL_FLOAT, data.data());
+    return textureID;
+}
+
+void upload_vertex_animation(const VertexAnimation& animation, unsigned int& positionTexture, unsigned int& normalTexture) {
+    positionTexture = create_vat_texture(animation, animation.positions);
+    normalTexture = create_vat_texture(animation, animation.normals);
+    gl_bind_texture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,41 @@
+#ifndef VERTEX_ANIMATION
+#define VERTEX_ANIMATION
+
+#include <vector>
+#include <functional>
+#include <glm.hpp>
+#include "mesh.h"
+
+// Vertex animation texture (VAT) data: every vertex position and normal sampled for every frame of an animation
+// Frame f of vertex v lives at texel (v % textureWidth, f * rowsPerFrame + v / textureWidth)
+typedef struct VertexAnimation {
+    unsigned int vertexCount;
+    unsigned int frameCount;
+    unsigned int textureWidth; // texels per row
+    unsigned int rowsPerFrame; // rows needed to hold one frame
+    float duration; // length of one loop of the animation in seconds
+    std::vector<float> positions; // RGBA32F texels, w unused
+    std::vector<float> normals; // RGBA32F texels, w unused
+}VertexAnimation;
+
+// Writes the deformed positions of every mesh vertex at the given time into outPositions (one vec3 per vertex)
+typedef std::function<void(const Mesh& mesh, float time, std::vector<glm::vec3>& outPositions)> DeformFunction;
+
+// Samples the animation frameCount times over its duration and stores the results as texture ready data
+VertexAnimation bake_vertex_animation(const Mesh& mesh, unsigned int frameCount, float duration, const DeformFunction& deform);
+
+// Two bone linear blend skin: the upper half of the mesh sways about a hip pivot, lower half stays planted
+DeformFunction make_sway_skinning(const Mesh& mesh, float swayDegrees, float duration);
+
+// Binary cache so the bake only has to run once per mesh/animation
+bool save_vertex_animation(const VertexAnimation& animation, const char* filename);
+bool load_vertex_animation(VertexAnimation& animation, const char* filename);
+
+// Creates the position and normal textures the playback shader samples from
+void upload_vertex_animation(const VertexAnimation& animation, unsigned int& positionTexture, unsigned int& normalTexture);
+
+// Playback shader, vertices are fetched by gl_VertexID and offset by a per instance position + time offset (location 3)
+extern const char* vatVertexShaderSource;
+extern const char* vatFragmentShaderSource;
+
+#endif // !VERTEX_ANIMATION